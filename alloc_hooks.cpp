@@ -0,0 +1,107 @@
+#include "alloc_hooks.h"
+#include "imgui.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+/*──────────────────── LuaPool ───────────────────*/
+LuaPool::~LuaPool(){
+    while (slabs_) { Node* n = slabs_->next; std::free(slabs_); slabs_ = n; }
+}
+
+void* LuaPool::take(size_t cls){
+    if (Node* n = free_[cls]) { free_[cls] = n->next; return n; }
+    const size_t sz = (cls + 1) * kGranule;
+    if (carveLeft_ < sz) {
+        // retire the tail of the old slab into the free lists, then grab a new one
+        while (carveLeft_ >= kGranule) {
+            const size_t c = std::min(carveLeft_ / kGranule, kClasses) - 1;
+            give(carve_, c);
+            carve_ += (c + 1) * kGranule; carveLeft_ -= (c + 1) * kGranule;
+        }
+        Node* slab = static_cast<Node*>(std::malloc(kSlab));
+        if (!slab) return nullptr;
+        bump(heap_);
+        slab->next = slabs_; slabs_ = slab;
+        carve_ = reinterpret_cast<char*>(slab) + kGranule;
+        carveLeft_ = kSlab - kGranule;
+    }
+    void* p = carve_;
+    carve_ += sz; carveLeft_ -= sz;
+    return p;
+}
+
+void LuaPool::give(void* p, size_t cls){
+    Node* n = static_cast<Node*>(p);
+    n->next = free_[cls]; free_[cls] = n;
+}
+
+void* LuaPool::alloc(void* ud, void* ptr, size_t osize, size_t nsize){
+    LuaPool* self = static_cast<LuaPool*>(ud);
+    if (!ptr) osize = 0;                       // osize may carry a type tag for new blocks
+    auto cls = [](size_t n){ return (n + kGranule - 1) / kGranule - 1; };
+
+    if (nsize == 0) {                          // free
+        if (!ptr) return nullptr;
+        if (osize <= kMaxSmall) self->give(ptr, cls(osize));
+        else                    std::free(ptr);
+        bump(self->bytes_, -(int64_t)osize);
+        return nullptr;
+    }
+
+    if (!ptr) bump(self->allocs_);
+    const bool oldSmall = ptr && osize <= kMaxSmall, newSmall = nsize <= kMaxSmall;
+    void* out;
+    if (ptr && oldSmall && newSmall && cls(osize) == cls(nsize)) {
+        out = ptr;                             // same size class: nothing to do
+    } else if (ptr && !oldSmall && !newSmall) {
+        out = std::realloc(ptr, nsize);
+        if (!out) return nullptr;
+        bump(self->heap_);
+    } else {
+        if (newSmall) out = self->take(cls(nsize));
+        else { out = std::malloc(nsize); if (out) bump(self->heap_); }
+        if (!out) return nullptr;              // Lua keeps the old block on failure
+        if (ptr) {
+            std::memcpy(out, ptr, std::min(osize, nsize));
+            if (oldSmall) self->give(ptr, cls(osize)); else std::free(ptr);
+        }
+    }
+    bump(self->bytes_, (int64_t)nsize - (int64_t)osize);
+    return out;
+}
+
+/*──────────────────── ImGui hooks ───────────────────*/
+static std::atomic<uint64_t> gImGuiAllocs{0};
+
+static void* imgui_alloc(size_t sz, void*){
+    gImGuiAllocs.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(sz);
+}
+static void imgui_free(void* p, void*){ std::free(p); }
+
+void installImGuiAllocHooks(){ ImGui::SetAllocatorFunctions(imgui_alloc, imgui_free, nullptr); }
+uint64_t imguiAllocCount(){ return gImGuiAllocs.load(std::memory_order_relaxed); }
+
+/*──────────────────── Per-frame accounting ───────────────────*/
+static AllocCounters gFrameStart, gLastFrame;
+
+static AllocCounters now(const LuaPool* lua){
+    AllocCounters c;
+    c.imguiAllocs = imguiAllocCount();
+    if (lua) { c.luaAllocs = lua->allocs(); c.luaHeap = lua->heap(); c.luaBytes = lua->bytes(); }
+    return c;
+}
+
+void allocFrameBegin(const LuaPool* lua){ gFrameStart = now(lua); }
+
+void allocFrameEnd(const LuaPool* lua){
+    const AllocCounters e = now(lua);
+    gLastFrame.luaAllocs   = e.luaAllocs   - gFrameStart.luaAllocs;
+    gLastFrame.luaHeap     = e.luaHeap     - gFrameStart.luaHeap;
+    gLastFrame.imguiAllocs = e.imguiAllocs - gFrameStart.imguiAllocs;
+    gLastFrame.luaBytes    = e.luaBytes;
+}
+
+AllocCounters allocLastFrame(){ return gLastFrame; }
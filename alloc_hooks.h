@@ -0,0 +1,70 @@
+#pragma once
+// Allocation hooks for the UI thread's two heaps: the Lua state and ImGui.
+//
+// LuaPool is a lua_Alloc with size-class free lists carved out of 64 KB
+// slabs. Small Lua objects (<= 512 bytes) never touch malloc once the pool
+// has warmed up; larger blocks go straight to malloc/realloc. Both paths are
+// counted, as are ImGui's allocations (installed with
+// ImGui::SetAllocatorFunctions), so a frame's allocation count can be checked
+// for zero.
+//
+// Counters are single-writer (the owning thread) relaxed atomics so other
+// threads may read them.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+struct AllocCounters {
+    uint64_t luaAllocs = 0;     // new blocks requested by Lua (garbage being created)
+    uint64_t luaHeap   = 0;     // malloc/realloc calls made on Lua's behalf (slabs + large)
+    uint64_t imguiAllocs = 0;   // ImGui MemAlloc calls
+    uint64_t luaBytes  = 0;     // bytes currently owned by the Lua state
+};
+
+class LuaPool {
+public:
+    static constexpr size_t kGranule  = 16;
+    static constexpr size_t kMaxSmall = 512;
+    static constexpr size_t kClasses  = kMaxSmall / kGranule;
+    static constexpr size_t kSlab     = 64 * 1024;
+
+    LuaPool() = default;
+    ~LuaPool();
+    LuaPool(const LuaPool&) = delete;
+    LuaPool& operator=(const LuaPool&) = delete;
+
+    // lua_Alloc entry point; ud must be a LuaPool*
+    static void* alloc(void* ud, void* ptr, size_t osize, size_t nsize);
+
+    uint64_t allocs() const { return allocs_.load(std::memory_order_relaxed); }
+    uint64_t heap()   const { return heap_.load(std::memory_order_relaxed); }
+    uint64_t bytes()  const { return bytes_.load(std::memory_order_relaxed); }
+
+private:
+    struct Node { Node* next; };
+
+    void* take(size_t cls);
+    void  give(void* p, size_t cls);
+    static void bump(std::atomic<uint64_t>& c, int64_t d = 1){
+        c.store(c.load(std::memory_order_relaxed) + (uint64_t)d, std::memory_order_relaxed);
+    }
+
+    Node*  free_[kClasses] = {};
+    Node*  slabs_   = nullptr;      // intrusive list of slabs (first granule = link)
+    char*  carve_   = nullptr;      // unused tail of the newest slab
+    size_t carveLeft_ = 0;
+
+    std::atomic<uint64_t> allocs_{0}, heap_{0}, bytes_{0};
+};
+
+// Installs counting allocators into ImGui. Call before ImGui::CreateContext().
+void     installImGuiAllocHooks();
+uint64_t imguiAllocCount();
+
+// Per-frame accounting on the UI thread: bracket each frame with
+// allocFrameBegin/allocFrameEnd; allocLastFrame() returns the deltas of the
+// last completed frame (luaBytes is the absolute value at frame end).
+void          allocFrameBegin(const LuaPool* lua);
+void          allocFrameEnd(const LuaPool* lua);
+AllocCounters allocLastFrame();
@@ -0,0 +1,8 @@
+#include "app_state.h"
+
+AudioEngine gAudio(48000.0);
+AudioStats  gAudioStats;
+ScopeRing   gScope;
+DspGraph    gDspGraph(gAudio);
+MidiInput   gMidi(gAudio);
+LlmWorker   gLlm;
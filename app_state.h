@@ -0,0 +1,17 @@
+#pragma once
+// Process-wide singletons shared by the audio callback, the Lua bindings
+// and the C ABI in demo_api.cpp.
+
+#include "audio_engine.h"
+#include "audio_stats.h"
+#include "dsp_graph.h"
+#include "llm_worker.h"
+#include "midi_input.h"
+#include "scope.h"
+
+extern AudioEngine gAudio;        // UI thread produces, audio thread renders
+extern AudioStats  gAudioStats;   // written by the audio callback only
+extern ScopeRing   gScope;        // written by the audio callback only
+extern DspGraph    gDspGraph;     // edited from Lua and the editor, compiled into gAudio
+extern MidiInput   gMidi;         // the open MIDI source; sole producer of gAudio's MIDI queue
+extern LlmWorker   gLlm;         // model and context live on its own thread; polled from Lua
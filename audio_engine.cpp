@@ -0,0 +1,195 @@
+#include "audio_engine.h"
+#include "audio_stats.h"
+#include "dsp_graph.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const float kParamDefaults[AudioParam_COUNT] = { 440.0f, 0.2f };
+static const float kParamMin     [AudioParam_COUNT] = {   1.0f, 0.0f };
+static const float kParamMax     [AudioParam_COUNT] = { 20000.0f, 1.0f };
+
+// MIDI notes play OscBank voices outside the range Lua uses for its own ids
+static constexpr int32_t kMidiVoiceBase = 1 << 24;
+
+AudioEngine::AudioEngine(double sampleRate, double rampMs)
+    : sr_(sampleRate), rampLen_(std::max(1, (int)std::lround(sampleRate * rampMs * 0.001))),
+      bank_(sampleRate), sine_(bank_.table(OscWave_Sine, 0.0f)),
+      incScale_((float)(4294967296.0 / sampleRate)) {
+    for (int p=0;p<AudioParam_COUNT;++p) {
+        sent_[p].store(kParamDefaults[p], std::memory_order_relaxed);
+        ramp_[p].reset(kParamDefaults[p]);
+    }
+    for (CcTarget& c : ccMap_) c = CcTarget{ kNoTarget, 0, 0.0f, 0.0f };
+}
+
+AudioEngine::~AudioEngine(){
+    collectGraphs();
+    delete nextGraph_.exchange(nullptr);
+    delete graph_;
+}
+
+void AudioEngine::setParam(AudioParam p, float v){
+    if (p >= AudioParam_COUNT || !std::isfinite(v)) return;
+    v = std::clamp(v, kParamMin[p], kParamMax[p]);
+    float prev = sent_[p].load(std::memory_order_relaxed);
+    if (v == prev) return;
+    // a full queue only drops this update; the UI re-posts on the next change.
+    // If a MIDI CC moved the parameter meanwhile, its value stays in the
+    // shadow, so the next call re-sends v instead of being deduped.
+    if (queue_.push(AudioMsg{ AudioMsg_Param, (uint8_t)p, 0, v, 0.0f }))
+        sent_[p].compare_exchange_strong(prev, v, std::memory_order_relaxed);
+}
+
+bool AudioEngine::voiceOn(int32_t id, float freq, float amp, OscWave wave){
+    if (!std::isfinite(freq) || !std::isfinite(amp)) return false;
+    return queue_.push(AudioMsg{ AudioMsg_VoiceOn, (uint8_t)wave, id, freq, amp });
+}
+
+bool AudioEngine::voiceOff(int32_t id){ return queue_.push(AudioMsg{ AudioMsg_VoiceOff, 0, id, 0.0f, 0.0f }); }
+bool AudioEngine::allVoicesOff()     { return queue_.push(AudioMsg{ AudioMsg_AllOff,   0, 0,  0.0f, 0.0f }); }
+
+/*──────────────────── MIDI ───────────────────*/
+bool AudioEngine::mapCC(int cc, AudioParam p, float lo, float hi){
+    if (cc < 0 || cc > 127 || p >= AudioParam_COUNT || !std::isfinite(lo) || !std::isfinite(hi)) return false;
+    return queue_.push(AudioMsg{ AudioMsg_CcMap, (uint8_t)cc, -1 - (int32_t)p, lo, hi, 0 });
+}
+
+bool AudioEngine::mapCCGraph(int cc, int32_t node, int param, float lo, float hi){
+    if (cc < 0 || cc > 127 || node < 0 || param < 0 || param > 255 || !std::isfinite(lo) || !std::isfinite(hi)) return false;
+    return queue_.push(AudioMsg{ AudioMsg_CcMap, (uint8_t)cc, node, lo, hi, (uint8_t)param });
+}
+
+bool AudioEngine::unmapCC(int cc){
+    if (cc < -1 || cc > 127) return false;
+    return queue_.push(AudioMsg{ AudioMsg_CcMap, (uint8_t)(cc < 0 ? 255 : cc), kNoTarget, 0.0f, 0.0f, 0 });
+}
+
+bool AudioEngine::setMidiVoice(OscWave wave, float amp){
+    if (wave >= OscWave_COUNT || !std::isfinite(amp)) return false;
+    return queue_.push(AudioMsg{ AudioMsg_MidiVoice, (uint8_t)wave, 0, std::clamp(amp, 0.0f, 1.0f), 0.0f, 0 });
+}
+
+AudioMidiStats AudioEngine::midiStats() const {
+    constexpr auto r = std::memory_order_relaxed;
+    return AudioMidiStats{ midiEvents_.load(r), midiLate_.load(r), midiSplits_.load(r) };
+}
+
+static float midiToHz(int note){ return 440.0f * std::exp2((float)(note - 69) / 12.0f); }
+
+void AudioEngine::applyMidi(const MidiEvent& e){
+    const int ch = e.status & 0x0F;
+    switch (e.status & 0xF0) {
+    case 0x90:
+        if (e.data2) { bank_.noteOn(kMidiVoiceBase + ch*128 + e.data1, midiToHz(e.data1), midiAmp_ * (float)e.data2 / 127.0f, midiWave_); break; }
+        [[fallthrough]];                                   // velocity 0 is a note off
+    case 0x80: bank_.noteOff(kMidiVoiceBase + ch*128 + e.data1); break;
+    case 0xB0: {
+        if (e.data1 == 120 || e.data1 == 123) { bank_.allOff(); break; }   // all sound / all notes off
+        const CcTarget& c = ccMap_[e.data1 & 127];
+        if (c.target == kNoTarget) break;
+        const float v = c.lo + (c.hi - c.lo) * (float)e.data2 / 127.0f;
+        if (c.target >= 0) { if (graph_) graph_->setParam(c.target, c.param, v); }
+        else {
+            const int p = -1 - c.target;
+            const float cv = std::clamp(v, kParamMin[p], kParamMax[p]);
+            ramp_[p].setTarget(cv, rampLen_);
+            sent_[p].store(cv, std::memory_order_relaxed);   // setParam dedups against what is playing
+        }
+        break;
+    }
+    default: break;
+    }
+}
+
+/*──────────────────── DSP graph handoff ───────────────────*/
+void AudioEngine::publishGraph(DspProgram* p){
+    collectGraphs();
+    delete nextGraph_.exchange(p, std::memory_order_acq_rel);   // the audio thread never saw it
+}
+
+bool AudioEngine::graphParam(int32_t node, int param, float v){
+    if (!std::isfinite(v)) return false;
+    return graphQueue_.push(AudioMsg{ AudioMsg_GraphParam, (uint8_t)param, node, v, 0.0f });
+}
+
+void AudioEngine::collectGraphs(){
+    DspProgram* p;
+    while (retired_.pop(p)) delete p;
+}
+
+void AudioEngine::swapGraph(){
+    DspProgram* p = nextGraph_.exchange(nullptr, std::memory_order_acq_rel);
+    if (!p) return;
+    if (graph_) {
+        p->inherit(*graph_);
+        retired_.push(graph_);   // freed by the UI side, never here
+    }
+    graph_ = p;
+}
+
+void AudioEngine::drain(){
+    AudioMsg m;
+    while (queue_.pop(m)) {
+        switch (m.kind) {
+        case AudioMsg_Param:    ramp_[m.param].setTarget(m.value, rampLen_); break;
+        case AudioMsg_VoiceOn:  bank_.noteOn(m.id, m.value, m.amp, (OscWave)m.param); break;
+        case AudioMsg_VoiceOff: bank_.noteOff(m.id); break;
+        case AudioMsg_AllOff:   bank_.allOff(); break;
+        case AudioMsg_CcMap:
+            if (m.param == 255) for (CcTarget& c : ccMap_) c.target = kNoTarget;
+            else ccMap_[m.param & 127] = CcTarget{ m.id, m.sub, m.value, m.amp };
+            break;
+        case AudioMsg_MidiVoice: midiWave_ = (OscWave)m.param; midiAmp_ = m.value; break;
+        }
+    }
+    // after the swap, so edits posted after a commit reach the new program
+    while (graphQueue_.pop(m)) if (graph_) graph_->setParam(m.id, m.param, m.value);
+}
+
+void AudioEngine::renderSpan(float* out, int frames){
+    // main tone: per-sample frequency/amplitude ramps, sine table lookup
+    constexpr int kShift = 32 - OscBank::kTableBits;
+    constexpr float kFrac = 1.0f / (float)(1u << kShift);
+    ParamRamp& freq = ramp_[AudioParam_Freq];
+    ParamRamp& amp  = ramp_[AudioParam_Amp];
+    for (int i=0;i<frames;++i) {
+        const uint32_t idx = phase_ >> kShift;
+        const float    f   = (float)(phase_ & ((1u << kShift) - 1u)) * kFrac;
+        out[i] = amp.next() * (sine_[idx] + f * (sine_[idx+1] - sine_[idx]));
+        phase_ += (uint32_t)(freq.next() * incScale_);
+    }
+    bank_.render(out, frames);
+    if (graph_) graph_->process(out, frames, bank_);
+}
+
+void AudioEngine::render(float* out, unsigned long frames, uint64_t nowNs){
+    swapGraph();
+    drain();
+    if (!nowNs) nowNs = AudioStats::nowNs();
+    // an event stamped t lands at (t + one block) - now; later ones wait for a later block
+    const double nsPerSample = 1e9 / sr_;
+    const double latencyNs   = (double)frames * nsPerSample;
+    const int    n = (int)frames;
+    int pos = 0, spans = 0;
+    uint64_t applied = 0, late = 0;
+    while (const MidiEvent* e = midi_.peek()) {
+        int off = 0;
+        if (e->timeNs) {
+            const double at = std::floor(((double)(int64_t)(e->timeNs - nowNs) + latencyNs) / nsPerSample);
+            if (at >= (double)n) break;
+            if (at < 0.0) ++late; else off = (int)at;
+        }
+        if (off > pos) { renderSpan(out + pos, off - pos); pos = off; ++spans; }
+        applyMidi(*e);
+        MidiEvent done; midi_.pop(done);
+        ++applied;
+    }
+    if (pos < n) { renderSpan(out + pos, n - pos); ++spans; }
+    active_.store(bank_.activeVoices(), std::memory_order_relaxed);
+    if (applied) {
+        constexpr auto r = std::memory_order_relaxed;
+        midiEvents_.fetch_add(applied, r); midiLate_.fetch_add(late, r);
+        midiSplits_.fetch_add((uint64_t)(spans - 1), r);
+    }
+}
@@ -0,0 +1,153 @@
+#pragma once
+// Device-independent audio engine.
+// The UI thread posts parameter changes and voice on/off commands through a
+// lock-free SPSC queue; render() drains it once per block and ramps every
+// parameter per sample, so knob drags never produce zipper noise and the
+// callback never locks or allocates.
+//
+// Output = the knob-driven main tone + a polyphonic OscBank + an optional
+// compiled DSP graph (dsp_graph.h).
+//
+// MIDI arrives on a second SPSC queue as timestamped events (midi_input.h).
+// render() places each one at its sample offset inside the block and renders
+// the block in spans between events. Events are delayed by exactly one block:
+// an event stamped t plays at t + frames/sr relative to the block start, so
+// the callback's own scheduling jitter does not smear note timing.
+
+#include "osc_bank.h"
+#include "spsc_queue.h"
+#include <atomic>
+#include <cstdint>
+
+enum AudioParam : uint8_t {
+    AudioParam_Freq,    // Hz
+    AudioParam_Amp,     // linear gain, 0..1
+    AudioParam_COUNT
+};
+
+// Linear ramp towards a target, advanced once per sample.
+struct ParamRamp {
+    float cur=0.0f, target=0.0f, step=0.0f; int left=0;
+
+    void reset(float v){ cur=target=v; step=0.0f; left=0; }
+    void setTarget(float v, int n){
+        target = v;
+        if (n <= 0) { cur=v; left=0; return; }
+        step = (v - cur) / (float)n; left = n;
+    }
+    float next(){
+        if (left > 0) { cur += step; if (--left == 0) cur = target; }
+        return cur;
+    }
+    // advance n samples at once (block-rate consumers)
+    float skip(int n){
+        if (left > 0) { const int k = n < left ? n : left; cur += step * (float)k; left -= k; if (left == 0) cur = target; }
+        return cur;
+    }
+};
+
+enum AudioMsgKind : uint8_t {
+    AudioMsg_Param, AudioMsg_VoiceOn, AudioMsg_VoiceOff, AudioMsg_AllOff, AudioMsg_GraphParam,
+    AudioMsg_CcMap, AudioMsg_MidiVoice
+};
+
+struct AudioMsg {
+    uint8_t kind;
+    uint8_t param;      // AudioParam (Param), OscWave (VoiceOn, MidiVoice), node parameter (GraphParam) or CC (CcMap)
+    int32_t id;         // voice id, graph node id or CC target (see mapCC)
+    float   value;      // parameter value, voice frequency or CC range low
+    float   amp;        // voice amplitude or CC range high
+    uint8_t sub = 0;    // CcMap: node parameter
+};
+
+// Raw channel message. timeNs is on the AudioStats::nowNs() clock; 0 means
+// "as soon as possible" (start of the next block).
+struct MidiEvent {
+    uint64_t timeNs;
+    uint8_t  status, data1, data2;
+};
+
+struct AudioMidiStats { uint64_t events = 0, late = 0, splits = 0; };   // splits: blocks cut at an event
+
+struct DspProgram;
+
+class AudioEngine {
+public:
+    explicit AudioEngine(double sampleRate = 48000.0, double rampMs = 10.0);
+    ~AudioEngine();
+
+    // UI thread (single producer). Unchanged values are not re-sent.
+    // param() is the last value sent or applied from a mapped MIDI CC, and
+    // may be read from any thread.
+    void  setParam(AudioParam p, float v);
+    float param(AudioParam p) const { return sent_[p].load(std::memory_order_relaxed); }
+
+    // UI thread: polyphonic voices. Return false if the queue was full.
+    bool voiceOn (int32_t id, float freq, float amp, OscWave wave);
+    bool voiceOff(int32_t id);
+    bool allVoicesOff();
+    int  activeVoices() const { return active_.load(std::memory_order_relaxed); }
+
+    // DSP graph. These producer calls have their own queue and are
+    // serialized by DspGraph's lock, so Lua and the graph editor may both edit.
+    void publishGraph(DspProgram* p);                   // takes ownership; replaces any unswapped one
+    bool graphParam(int32_t node, int param, float v);
+    void collectGraphs();                               // frees programs the audio thread retired
+
+    // MIDI source thread (single producer: one MidiInput source at a time).
+    // Note on/off play OscBank voices; CCs go through the map below.
+    bool midiEvent(const MidiEvent& e){ return midi_.push(e); }
+
+    // UI thread: route CC `cc` (0..127 -> lo..hi) to an engine parameter or to
+    // a graph node parameter; unmapCC(-1) clears every mapping. Returns false
+    // if the queue was full.
+    bool mapCC(int cc, AudioParam p, float lo, float hi);
+    bool mapCCGraph(int cc, int32_t node, int param, float lo, float hi);
+    bool unmapCC(int cc);
+    bool setMidiVoice(OscWave wave, float amp);           // waveform and full-velocity amplitude of MIDI notes
+    AudioMidiStats midiStats() const;
+
+    // audio thread (single consumer). nowNs: AudioStats::nowNs() at the
+    // start of the callback, 0 to read the clock here.
+    void render(float* out, unsigned long frames, uint64_t nowNs = 0);
+
+    double sampleRate() const { return sr_; }
+    int    rampLength() const { return rampLen_; }
+    // audio thread (or once it has stopped): where each ramp is heading and where it is
+    float  rampTarget(AudioParam p) const { return ramp_[p].target; }
+    float  rampValue (AudioParam p) const { return ramp_[p].cur; }
+    const OscBank& bank() const { return bank_; }      // wavetables are immutable after construction
+
+private:
+    void drain();
+    void swapGraph();
+    void renderSpan(float* out, int frames);
+    void applyMidi(const MidiEvent& e);
+
+    SpscQueue<AudioMsg, 1024> queue_;
+    std::atomic<float> sent_[AudioParam_COUNT];   // last posted values; CCs mapped to a parameter write here too
+    ParamRamp ramp_[AudioParam_COUNT];   // audio-side smoothed values
+    double    sr_;
+    int       rampLen_;
+
+    OscBank          bank_;
+    const float*     sine_;              // band-limited sine table for the main tone
+    uint32_t         phase_ = 0;
+    float            incScale_;          // Hz -> phase increment
+    std::atomic<int> active_{0};
+
+    SpscQueue<AudioMsg, 256>   graphQueue_;
+    std::atomic<DspProgram*>   nextGraph_{nullptr};
+    DspProgram*                graph_ = nullptr;   // audio thread
+    // collectGraphs() runs before every publish and the audio thread retires
+    // at most one program per publish, so this never fills
+    SpscQueue<DspProgram*, 16> retired_;
+
+    struct CcTarget { int32_t target; uint8_t param; float lo, hi; };   // target: node id, -1-AudioParam, or kNoTarget
+    static constexpr int32_t kNoTarget = INT32_MIN;
+    SpscQueue<MidiEvent, 1024> midi_;
+    CcTarget ccMap_[128];                // audio thread
+    OscWave  midiWave_ = OscWave_Saw;
+    float    midiAmp_  = 0.25f;
+    std::atomic<uint64_t> midiEvents_{0}, midiLate_{0}, midiSplits_{0};
+};
@@ -0,0 +1,74 @@
+#include "audio_stats.h"
+
+#include <algorithm>
+#include <chrono>
+
+uint64_t AudioStats::nowNs(){
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static float percentile(const uint64_t* h, uint64_t total, double q){
+    if (!total) return 0.0f;
+    const uint64_t rank = (uint64_t)(q * (double)(total - 1)) + 1;
+    uint64_t acc = 0;
+    for (int b=0;b<AudioStats::kBuckets;++b) {
+        acc += h[b];
+        if (acc >= rank) return AudioStats::bucketTop(b);
+    }
+    return AudioStats::bucketTop(AudioStats::kBuckets-1);
+}
+
+void AudioStats::snapshot(AudioStatsSnapshot& s) const {
+    const auto r = std::memory_order_relaxed;
+    s.callbacks    = callbacks_.load(std::memory_order_acquire) - baseCallbacks_;
+    s.late         = late_.load(r)     - baseLate_;
+    s.inUnderflow  = inUnder_.load(r)  - baseXrun_[0];
+    s.inOverflow   = inOver_.load(r)   - baseXrun_[1];
+    s.outUnderflow = outUnder_.load(r) - baseXrun_[2];
+    s.outOverflow  = outOver_.load(r)  - baseXrun_[3];
+    s.priming      = priming_.load(r)  - baseXrun_[4];
+    s.load         = load_.load(r);
+    s.loadAvg      = loadAvg_.load(r);
+    s.deadlineUs   = (float)deadlineNs_.load(r) * 1e-3f;
+    s.lastUs       = (float)lastNs_.load(r) * 1e-3f;
+    s.latencyMs    = latencyMs_.load(r);
+
+    const uint64_t lastEnd = lastEndNs_.load(r), now = nowNs();
+    s.sinceLastCallbackMs = (lastEnd && now > lastEnd) ? (double)(now - lastEnd) * 1e-6 : 0.0;
+
+    float peak = 0.0f;
+    for (int i=0;i<kHistory;++i) peak = std::max(peak, history_[i].load(r));
+    s.loadPeak = peak;
+
+    uint64_t h[kBuckets], total = 0;
+    int top = -1;
+    for (int b=0;b<kBuckets;++b) {
+        const uint64_t c = hist_[b].load(r);
+        h[b] = c >= base_[b] ? c - base_[b] : 0;
+        total += h[b];
+        if (h[b]) top = b;
+    }
+    s.p50Us  = percentile(h, total, 0.50);
+    s.p99Us  = percentile(h, total, 0.99);
+    s.p999Us = percentile(h, total, 0.999);
+    s.maxUs  = top >= 0 ? bucketTop(top) : 0.0f;
+}
+
+int AudioStats::history(float* out, int n) const {
+    const uint64_t cb = callbacks_.load(std::memory_order_acquire);
+    const int count = (int)std::min<uint64_t>({ (uint64_t)n, (uint64_t)kHistory, cb });
+    for (int i=0;i<count;++i)
+        out[i] = history_[(cb - (uint64_t)count + (uint64_t)i) % kHistory].load(std::memory_order_relaxed);
+    return count;
+}
+
+void AudioStats::resetView(){
+    const auto r = std::memory_order_relaxed;
+    baseCallbacks_ = callbacks_.load(std::memory_order_acquire);
+    baseLate_      = late_.load(r);
+    baseXrun_[0]   = inUnder_.load(r);  baseXrun_[1] = inOver_.load(r);
+    baseXrun_[2]   = outUnder_.load(r); baseXrun_[3] = outOver_.load(r);
+    baseXrun_[4]   = priming_.load(r);
+    for (int b=0;b<kBuckets;++b) base_[b] = hist_[b].load(r);
+}
@@ -0,0 +1,104 @@
+#pragma once
+// Wait-free audio callback instrumentation.
+// The audio thread is the only writer: every field is a relaxed atomic
+// updated with plain load/store (no RMW, no locks), so record() costs a few
+// stores. Any other thread may read at any time; readers never block the
+// writer and at worst see a snapshot that is a callback or so out of date.
+
+#include <atomic>
+#include <cstdint>
+
+// Callback status bits, mirroring PortAudio's paInputUnderflow.. paPrimingOutput
+// so this header does not depend on portaudio.h.
+enum AudioXrun : unsigned {
+    AudioXrun_InputUnderflow  = 1u << 0,
+    AudioXrun_InputOverflow   = 1u << 1,
+    AudioXrun_OutputUnderflow = 1u << 2,
+    AudioXrun_OutputOverflow  = 1u << 3,
+    AudioXrun_PrimingOutput   = 1u << 4,
+};
+
+struct AudioStatsSnapshot {
+    uint64_t callbacks = 0;
+    uint64_t late = 0;                     // callbacks that exceeded their deadline
+    uint64_t inUnderflow = 0, inOverflow = 0, outUnderflow = 0, outOverflow = 0, priming = 0;
+    float    load = 0, loadAvg = 0;        // elapsed / deadline
+    float    loadPeak = 0;                 // max over the recent history window
+    float    deadlineUs = 0, lastUs = 0;
+    float    p50Us = 0, p99Us = 0, p999Us = 0, maxUs = 0;
+    float    latencyMs = 0;                // DAC time - callback time, as reported by the host
+    double   sinceLastCallbackMs = 0;      // stall detector
+};
+
+class AudioStats {
+public:
+    // Callback duration histogram in microseconds: exact below 4 us, then
+    // 4 sub-buckets per power of two (<= 25% relative error) up to ~1 s.
+    static constexpr int kBuckets = 80;
+    static constexpr int kHistory = 256;   // recent per-callback loads
+
+    static uint64_t nowNs();
+
+    // audio thread
+    void record(uint64_t startNs, uint64_t endNs, uint64_t deadlineNs, unsigned xrunFlags, float latencyMs){
+        const uint64_t el = endNs > startNs ? endNs - startNs : 0;
+        const float load  = deadlineNs ? (float)el / (float)deadlineNs : 0.0f;
+        const uint64_t n  = callbacks_.load(std::memory_order_relaxed);
+
+        bump(hist_[bucket(el / 1000)]);
+        if (el > deadlineNs) bump(late_);
+        if (xrunFlags & AudioXrun_InputUnderflow)  bump(inUnder_);
+        if (xrunFlags & AudioXrun_InputOverflow)   bump(inOver_);
+        if (xrunFlags & AudioXrun_OutputUnderflow) bump(outUnder_);
+        if (xrunFlags & AudioXrun_OutputOverflow)  bump(outOver_);
+        if (xrunFlags & AudioXrun_PrimingOutput)   bump(priming_);
+
+        history_[n % kHistory].store(load, std::memory_order_relaxed);
+        load_.store(load, std::memory_order_relaxed);
+        const float avg = loadAvg_.load(std::memory_order_relaxed);
+        loadAvg_.store(n ? avg + 0.05f * (load - avg) : load, std::memory_order_relaxed);
+        lastNs_.store(el, std::memory_order_relaxed);
+        deadlineNs_.store(deadlineNs, std::memory_order_relaxed);
+        latencyMs_.store(latencyMs, std::memory_order_relaxed);
+        lastEndNs_.store(endNs, std::memory_order_relaxed);
+        callbacks_.store(n + 1, std::memory_order_release);
+    }
+
+    // reader threads
+    void snapshot(AudioStatsSnapshot& s) const;
+    // copies up to n recent loads, oldest first; returns the count written
+    int  history(float* out, int n) const;
+    // Reader-side reset: later snapshots report counts and percentiles
+    // relative to now. The writer is untouched. Not safe against concurrent
+    // snapshot() from another reader thread.
+    void resetView();
+
+    static int bucket(uint64_t us){
+        if (us < 4) return (int)us;
+        int e = 63 - __builtin_clzll(us);
+        const int b = 4*(e-1) + (int)((us >> (e-2)) & 3);
+        return b < kBuckets ? b : kBuckets-1;
+    }
+    // upper edge of bucket b in microseconds
+    static float bucketTop(int b){
+        if (b < 4) return (float)(b + 1);
+        const int e = b/4 + 1, sub = b & 3;
+        return (float)((uint64_t)(5 + sub) << (e-2));
+    }
+
+private:
+    using Counter = std::atomic<uint64_t>;
+    static void bump(Counter& c){ c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+
+    Counter               hist_[kBuckets] = {};
+    Counter               callbacks_{0}, late_{0};
+    Counter               inUnder_{0}, inOver_{0}, outUnder_{0}, outOver_{0}, priming_{0};
+    Counter               lastNs_{0}, deadlineNs_{0}, lastEndNs_{0};
+    std::atomic<float>    load_{0}, loadAvg_{0}, latencyMs_{0};
+    std::atomic<float>    history_[kHistory] = {};
+
+    // reader-side baseline (resetView)
+    uint64_t base_[kBuckets] = {};
+    uint64_t baseCallbacks_ = 0, baseLate_ = 0;
+    uint64_t baseXrun_[5] = {};
+};
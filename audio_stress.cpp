@@ -0,0 +1,84 @@
+// audio_stress.cpp — AudioEngine's UI -> audio handoff under ThreadSanitizer.
+// One thread plays the UI and hammers setParam/voiceOn/voiceOff as fast as
+// it can, another calls render() in a loop like the PortAudio callback.
+// When the producer stops, the render thread drains the queue. Every ramp
+// must then target, and settle on, the last value the producer got into the
+// queue (param()). CMake builds this target with -fsanitize=thread, so TSan
+// reports any data race in the queue or the engine along the way.
+//
+// Usage:
+//   ./audio_stress [--seconds 2] [--block 64] [--rate 48000]
+
+#include "audio_engine.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+int main(int argc, char** argv){
+    double seconds = 2.0;
+    int    block = 64, rate = 48000;
+    for (int i=1;i<argc;++i) {
+        const char* a = argv[i];
+        auto next = [&]{ if (i+1>=argc) { std::fprintf(stderr,"%s needs a value\n",a); std::exit(2); } return argv[++i]; };
+        if      (!std::strcmp(a,"--seconds")) seconds = std::atof(next());
+        else if (!std::strcmp(a,"--block"))   block   = std::atoi(next());
+        else if (!std::strcmp(a,"--rate"))    rate    = std::atoi(next());
+        else { std::fprintf(stderr,"unknown option %s\n",a); return 2; }
+    }
+    if (seconds <= 0 || block <= 0 || rate <= 0) { std::fprintf(stderr,"nothing to run\n"); return 2; }
+
+    AudioEngine eng((double)rate);
+    std::atomic<bool> stop{false};
+    uint64_t blocks = 0, nonFinite = 0;               // render thread until joined
+
+    std::thread audio([&]{
+        std::vector<float> buf((size_t)block);
+        auto render = [&]{
+            eng.render(buf.data(), (unsigned long)block);
+            for (float x : buf) if (!std::isfinite(x)) ++nonFinite;
+            ++blocks;
+        };
+        while (!stop.load(std::memory_order_acquire)) render();
+        // everything pushed before `stop` is visible now: drain it, then let the ramps settle
+        for (int n=0; n <= eng.rampLength() / block + 1; ++n) render();
+    });
+
+    uint64_t iters = 0, rejected = 0;
+    uint32_t rng = 0x9E3779B9u;
+    const auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(seconds);
+    for (;;) {
+        if ((iters & 1023) == 0 && std::chrono::steady_clock::now() >= end) break;
+        rng = rng * 1664525u + 1013904223u;
+        eng.setParam(AudioParam_Freq, 20.0f + (float)((rng >> 8) % 4000));
+        eng.setParam(AudioParam_Amp, (float)((rng >> 20) & 1023) / 1023.0f);
+        const int32_t id = (int32_t)(iters % 64);
+        const bool ok = (rng & 0x10000) ? eng.voiceOn(id, 110.0f + 5.0f * (float)id, 0.01f, (OscWave)(id % OscWave_COUNT))
+                                        : eng.voiceOff(id);
+        if (!ok) ++rejected;
+        ++iters;
+    }
+    stop.store(true, std::memory_order_release);
+    audio.join();
+
+    int failures = 0;
+    static const char* const kNames[AudioParam_COUNT] = { "freq", "amp" };
+    for (int p=0; p<AudioParam_COUNT; ++p) {
+        const float sent = eng.param((AudioParam)p), target = eng.rampTarget((AudioParam)p), cur = eng.rampValue((AudioParam)p);
+        const bool ok = target == sent && cur == sent;
+        if (!ok) ++failures;
+        std::printf("stress: %-4s last sent %10.4f  ramp target %10.4f  value %10.4f%s\n",
+                    kNames[p], sent, target, cur, ok ? "" : "  FAIL");
+    }
+    if (nonFinite) { std::fprintf(stderr, "stress: %llu non-finite samples\n", (unsigned long long)nonFinite); ++failures; }
+    std::printf("stress: %llu producer iterations (%llu voice commands rejected: queue full), %llu blocks of %d\n",
+                (unsigned long long)iters, (unsigned long long)rejected, (unsigned long long)blocks, block);
+    std::printf("audio stress %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,119 @@
+#ifndef IMGUI_DEFINE_MATH_OPERATORS
+#define IMGUI_DEFINE_MATH_OPERATORS
+#endif
+#include "demo_api.h"
+#include "app_state.h"
+#include "frame_replay.h"
+#include "frame_sched.h"
+#include "torus.h"
+#include "ui_thread.h"
+
+#include "imgui.h"
+#include "imgui-knobs.h"
+
+#include <algorithm>
+#include <cmath>
+
+#define DEMO_API_CDEF(ret, name, args) #ret " " #name " " #args ";\n"
+const char* const kDemoFfiCdef = DEMO_API_FUNCS(DEMO_API_CDEF);
+#undef DEMO_API_CDEF
+
+extern "C" {
+
+// window/layout. Each ImGui-facing call is recorded instead of executed when
+// draw_ui runs on the Lua worker thread (ui_thread.h).
+#define RECORDING(call) if (UiRecorder* rec = UiRecorder::current()) return rec->call
+
+int  demo_begin(const char* name){ RECORDING(begin(name)); return ImGui::Begin(name) ? 1 : 0; }
+void demo_end(void){ RECORDING(end()); ImGui::End(); }
+void demo_set_next_window_size(float w, float h, int cond){
+    RECORDING(setNextWindowSize(w, h, cond)); ImGui::SetNextWindowSize(ImVec2(w,h), cond);
+}
+void demo_separator(void){ RECORDING(simple(UiOp_Separator)); ImGui::Separator(); }
+void demo_spacing(void){ RECORDING(simple(UiOp_Spacing)); ImGui::Spacing(); }
+void demo_same_line(void){ RECORDING(simple(UiOp_SameLine)); ImGui::SameLine(); }
+void demo_text(const char* text){ RECORDING(text(text ? text : "")); ImGui::TextUnformatted(text ? text : ""); }
+int  demo_begin_table(const char* id, int columns){
+    RECORDING(beginTable(id, columns));
+    return ImGui::BeginTable(id, std::max(1, columns), ImGuiTableFlags_SizingStretchSame) ? 1 : 0;
+}
+void demo_table_next_column(void){ RECORDING(simple(UiOp_TableNextColumn)); ImGui::TableNextColumn(); }
+void demo_end_table(void){ RECORDING(endTable()); ImGui::EndTable(); }
+int  demo_button(const char* label){
+    RECORDING(button(label));
+    return (ImGui::Button(label) || (gReplay && gReplay->click(label))) ? 1 : 0;
+}
+
+float demo_knob_float(const char* label, float v, float vmin, float vmax, float speed,
+                      const char* format, int variant, float size, int flags, int steps,
+                      float angle_min, float angle_max){
+    RECORDING(knob(label, v, vmin, vmax, speed, format, variant, size, flags, steps, angle_min, angle_max));
+    if (gReplay) gReplay->knob(label, v);   // a trace "knob" event stands in for the drag
+    ImGuiKnobs::Knob(label, &v, vmin, vmax, speed, format ? format : "%.3f",
+                     (ImGuiKnobVariant)variant, size, (ImGuiKnobFlags)flags, steps, angle_min, angle_max);
+    return v;
+}
+
+// A visible scope keeps frames coming while its picture changes: voices are
+// sounding, or the main tone moved and the window still shows the old one.
+// A steady tone draws the same triggered trace every frame, so it is left to
+// the idle rate (--idle-fps). Call right after drawing the scope item.
+static void scopeKeepAlive(double windowSec){
+    if (!ImGui::IsItemVisible()) return;
+    static float lastFreq = -1.0f, lastAmp = -1.0f;
+    const float f = gAudio.param(AudioParam_Freq), a = gAudio.param(AudioParam_Amp);
+    if (f != lastFreq || a != lastAmp) {
+        lastFreq = f; lastAmp = a;
+        // the ramp, then one full window of the new signal, at ~60 fps
+        const double sec = (double)gAudio.rampLength() / gAudio.sampleRate() + windowSec;
+        gFrameSched.request(std::min(600, 2 + (int)std::ceil(sec * 60.0)));
+    }
+    if (gAudio.activeVoices() > 0) gFrameSched.request(1);
+}
+
+// plots
+void demo_plot_sine(float, float, int samples){
+    RECORDING(plotSine(samples));
+    ScopeView v;
+    v.window = std::clamp(samples, 2, 4096);
+    drawScope("##sine", gScope, v);
+    scopeKeepAlive((double)v.window / gAudio.sampleRate());
+}
+
+int demo_scope(float window_ms, float height, int trigger, float yrange){
+    RECORDING(scope(window_ms, height, trigger, yrange));
+    ScopeView v;
+    v.window  = (int)std::clamp((double)window_ms * 0.001 * gAudio.sampleRate(), 2.0, (double)ScopeRing::kSize);
+    v.height  = height;
+    v.trigger = trigger != 0;
+    v.yMin = -yrange; v.yMax = yrange;
+    const int shown = drawScope("##scope", gScope, v);
+    scopeKeepAlive(window_ms * 0.001);
+    return shown;
+}
+
+void demo_plot_audio_load(float height){
+    RECORDING(plotAudioLoad(height));
+    float buf[AudioStats::kHistory];
+    int n = gAudioStats.history(buf, AudioStats::kHistory);
+    if (n < 2) { ImGui::TextUnformatted("(no callbacks yet)"); return; }
+    ImGui::PlotLines("##audio_load", buf, n, 0, nullptr, 0.0f, 1.0f, ImVec2(-1,height));
+}
+
+// torus
+void demo_gl_torus(int side, float yaw, float pitch, float R, float r, const char* id){
+    RECORDING(torus(side, yaw, pitch, R, r, id)); torusWidget(side, yaw, pitch, R, r, id);
+}
+void demo_gl_torus_rainbow_speed(float speed){ RECORDING(value(UiOp_TorusRainbow, speed)); torusSetRainbowSpeed(speed); }
+
+#undef RECORDING
+
+// audio
+void demo_audio_set_freq(float hz){ gAudio.setParam(AudioParam_Freq, hz); }
+void demo_audio_set_amp(float gain){ gAudio.setParam(AudioParam_Amp, gain); }
+int  demo_voice_on(int id, float freq, float amp, int wave){
+    return gAudio.voiceOn(id, freq, amp, (OscWave)std::clamp(wave, 0, OscWave_COUNT-1)) ? 1 : 0;
+}
+int  demo_voice_off(int id){ return gAudio.voiceOff(id) ? 1 : 0; }
+
+} // extern "C"
@@ -0,0 +1,55 @@
+#pragma once
+/* demo_api.h — plain C ABI for the hot `demo.*` widgets.
+ *
+ * These are the same operations the lua_CFunction bindings perform, minus
+ * the Lua stack protocol, so sine_ui.lua can call them through LuaJIT's
+ * ffi.C and keep draw_ui on trace. The list below is the single source of
+ * truth: it declares the functions here and is stringified into
+ * demo.ffi_cdef for ffi.cdef(), so the two can never drift apart.
+ *
+ * Strings are borrowed for the duration of the call. Booleans are ints.
+ */
+
+#if defined(_WIN32)
+  #define DEMO_API __declspec(dllexport)
+#else
+  #define DEMO_API __attribute__((visibility("default")))
+#endif
+
+#define DEMO_API_FUNCS(X) \
+    X(int,   demo_begin,                 (const char* name)) \
+    X(void,  demo_end,                   (void)) \
+    X(void,  demo_set_next_window_size,  (float w, float h, int cond)) \
+    X(void,  demo_separator,             (void)) \
+    X(void,  demo_spacing,               (void)) \
+    X(void,  demo_same_line,             (void)) \
+    X(void,  demo_text,                  (const char* text)) \
+    X(int,   demo_begin_table,           (const char* id, int columns)) \
+    X(void,  demo_table_next_column,     (void)) \
+    X(void,  demo_end_table,             (void)) \
+    X(int,   demo_button,                (const char* label)) \
+    X(float, demo_knob_float,            (const char* label, float v, float vmin, float vmax, float speed, \
+                                          const char* format, int variant, float size, int flags, int steps, \
+                                          float angle_min, float angle_max)) \
+    X(void,  demo_plot_sine,             (float amp, float freq, int samples)) \
+    X(int,   demo_scope,                 (float window_ms, float height, int trigger, float yrange)) \
+    X(void,  demo_plot_audio_load,       (float height)) \
+    X(void,  demo_gl_torus,              (int side, float yaw, float pitch, float R, float r, const char* id)) \
+    X(void,  demo_gl_torus_rainbow_speed,(float speed)) \
+    X(void,  demo_audio_set_freq,        (float hz)) \
+    X(void,  demo_audio_set_amp,         (float gain)) \
+    X(int,   demo_voice_on,              (int id, float freq, float amp, int wave)) \
+    X(int,   demo_voice_off,             (int id))
+
+#define DEMO_API_DECLARE(ret, name, args) DEMO_API ret name args;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+DEMO_API_FUNCS(DEMO_API_DECLARE)
+#ifdef __cplusplus
+}
+
+// ffi.cdef text for the functions above
+extern const char* const kDemoFfiCdef;
+#endif
@@ -0,0 +1,97 @@
+#include "dsp_editor.h"
+#include "dsp_graph.h"
+
+#include "imgui.h"
+
+#include <cstdio>
+#include <vector>
+
+static const char* const kWaveLabels[]   = { "sine", "saw", "square", "triangle" };
+static const char* const kFilterLabels[] = { "lowpass", "bandpass", "highpass" };
+
+static const DspGraph::Node* byId(const std::vector<DspGraph::Node>& nodes, int32_t id){
+    for (const DspGraph::Node& n : nodes) if (n.id == id) return &n;
+    return nullptr;
+}
+
+static void nodeLabel(char* out, size_t n, const DspGraph::Node* node){
+    if (node) std::snprintf(out, n, "#%d %s", node->id, dspNodeInfo(node->type).name);
+    else      std::snprintf(out, n, "(none)");
+}
+
+void dspGraphEditor(DspGraph& g){
+    ImGui::SetNextWindowSize(ImVec2(440, 520), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("DSP Graph")) { ImGui::End(); return; }
+
+    static std::vector<DspGraph::Node> nodes;   // refilled in place: no allocation once warm
+    g.snapshot(nodes);
+    bool structural = false;
+
+    for (int t=0;t<DspNode_COUNT;++t) {
+        char label[24]; std::snprintf(label, sizeof(label), "+ %s", dspNodeInfo((DspNodeType)t).name);
+        if (t) ImGui::SameLine();
+        if (ImGui::SmallButton(label)) { g.add((DspNodeType)t); structural = true; }
+    }
+    const DspStats st = g.stats();
+    ImGui::Text("%d nodes -> %d ops, %d buffers   commits %llu", st.nodes, st.ops, st.buffers, (unsigned long long)st.commits);
+    const std::string err = g.lastError();
+    if (!err.empty()) ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.3f, 1.0f), "not applied: %s", err.c_str());
+    ImGui::Separator();
+
+    char label[48];
+    for (const DspGraph::Node& n : nodes) {
+        const DspNodeInfo& info = dspNodeInfo(n.type);
+        ImGui::PushID(n.id);
+        nodeLabel(label, sizeof(label), &n);
+        if (ImGui::CollapsingHeader(label, ImGuiTreeNodeFlags_DefaultOpen)) {
+            // parameters
+            for (int i=0;i<info.params;++i) {
+                float v = n.param[i];
+                bool changed = false;
+                ImGui::SetNextItemWidth(200);
+                if ((n.type == DspNode_Osc && i == 2) || (n.type == DspNode_Filter && i == 2)) {
+                    int k = (int)v;
+                    const char* const* names = n.type == DspNode_Osc ? kWaveLabels : kFilterLabels;
+                    changed = ImGui::SliderInt(info.param[i], &k, (int)info.min[i], (int)info.max[i], names[k]);
+                    v = (float)k;
+                } else if (n.type == DspNode_Env && i == 4) {
+                    bool on = v > 0.5f;
+                    changed = ImGui::Checkbox("gate", &on);
+                    v = on ? 1.0f : 0.0f;
+                } else {
+                    const bool logScale = info.max[i] / (info.min[i] > 0.0f ? info.min[i] : 1.0f) > 100.0f;
+                    changed = ImGui::SliderFloat(info.param[i], &v, info.min[i], info.max[i], "%.3f",
+                                                 logScale ? ImGuiSliderFlags_Logarithmic : 0);
+                }
+                if (changed) g.set(n.id, i, v);
+            }
+            // inputs: connected ports, then one picker for the next free port
+            int used = 0;
+            for (int j=0;j<info.inputs;++j) {
+                if (n.in[j] < 0) continue;
+                ++used;
+                nodeLabel(label, sizeof(label), byId(nodes, n.in[j]));
+                ImGui::Text("in %d <- %s", j, label);
+                ImGui::SameLine();
+                ImGui::PushID(j);
+                if (ImGui::SmallButton("x")) { g.disconnect(n.in[j], n.id); structural = true; }
+                ImGui::PopID();
+            }
+            if (used < info.inputs) {
+                ImGui::SetNextItemWidth(200);
+                if (ImGui::BeginCombo("connect", "add input...")) {
+                    for (const DspGraph::Node& s : nodes) {
+                        if (s.id == n.id || s.type == DspNode_Output) continue;
+                        nodeLabel(label, sizeof(label), &s);
+                        if (ImGui::Selectable(label)) { g.connect(s.id, n.id); structural = true; }
+                    }
+                    ImGui::EndCombo();
+                }
+            }
+            if (ImGui::SmallButton("remove")) { g.remove(n.id); structural = true; }
+        }
+        ImGui::PopID();
+    }
+    if (structural) g.commit();   // a failed commit keeps the running program and shows why
+    ImGui::End();
+}
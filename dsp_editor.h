@@ -0,0 +1,8 @@
+#pragma once
+// ImGui editor for the DSP graph: add/remove nodes, wire inputs, edit
+// parameters. Structural edits commit at once; parameter edits are ramped
+// messages (DspGraph::set). Render thread only.
+
+class DspGraph;
+
+void dspGraphEditor(DspGraph& g);
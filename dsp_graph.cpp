@@ -0,0 +1,351 @@
+#include "dsp_graph.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/*──────────────────── Node table ───────────────────*/
+static const DspNodeInfo kNodeInfo[DspNode_COUNT] = {
+    { "osc",    0, 3, { "freq", "amp", "wave" },
+      { 220.0f, 0.2f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 20000.0f, 1.0f, (float)(OscWave_COUNT-1) },
+      { true, true, false } },
+    { "gain",   1, 1, { "gain" },
+      { 1.0f }, { 0.0f }, { 4.0f }, { true } },
+    { "filter", 1, 3, { "cutoff", "q", "mode" },
+      { 1000.0f, 0.707f, 0.0f }, { 20.0f, 0.5f, 0.0f }, { 20000.0f, 20.0f, 2.0f },
+      { true, true, false } },
+    { "mixer",  kDspMaxInputs, 1, { "gain" },
+      { 1.0f }, { 0.0f }, { 4.0f }, { true } },
+    { "env",    1, 5, { "attack", "decay", "sustain", "release", "gate" },
+      { 0.01f, 0.2f, 0.7f, 0.3f, 0.0f }, { 0.001f, 0.001f, 0.0f, 0.001f, 0.0f }, { 10.0f, 10.0f, 1.0f, 10.0f, 1.0f },
+      { false, false, false, false, false } },
+    { "output", kDspMaxInputs, 1, { "gain" },
+      { 1.0f }, { 0.0f }, { 1.0f }, { true } },
+};
+
+const DspNodeInfo& dspNodeInfo(DspNodeType t){ return kNodeInfo[t < DspNode_COUNT ? t : DspNode_Gain]; }
+
+int dspParamIndex(DspNodeType t, const char* name){
+    const DspNodeInfo& info = dspNodeInfo(t);
+    for (int i=0;i<info.params;++i) if (name && !std::strcmp(info.param[i], name)) return i;
+    return -1;
+}
+
+static float clampParam(DspNodeType t, int i, float v){
+    const DspNodeInfo& info = dspNodeInfo(t);
+    return std::clamp(v, info.min[i], info.max[i]);
+}
+
+/*──────────────────── Program (audio thread) ───────────────────*/
+void DspProgram::setParam(int32_t node, int param, float v){
+    if (node < 0 || node >= (int32_t)byNode.size() || byNode[node] < 0) return;
+    DspOp& op = ops[byNode[node]];
+    const DspNodeInfo& info = dspNodeInfo(op.type);
+    if (param < 0 || param >= info.params) return;
+    op.p[param].setTarget(clampParam(op.type, param, v), info.ramp[param] ? rampLen : 0);
+}
+
+void DspProgram::inherit(const DspProgram& prev){
+    if (prev.serial != base) return;            // compiled against another program: start fresh
+    for (size_t i=0;i<ops.size();++i) {
+        const int j = carry[i];
+        if (j < 0) continue;
+        DspOp& op = ops[i];
+        const DspOp& old = prev.ops[j];
+        op.s = old.s;
+        const DspNodeInfo& info = dspNodeInfo(op.type);
+        for (int k=0;k<info.params;++k) {       // glide from the playing value to the new one
+            if (!info.ramp[k]) continue;
+            const float target = op.p[k].target;
+            op.p[k].reset(old.p[k].cur);
+            op.p[k].setTarget(target, rampLen);
+        }
+    }
+}
+
+static void runOsc(DspOp& op, float* out, int n, const OscBank& tables, float incScale){
+    constexpr int kShift = 32 - OscBank::kTableBits;
+    constexpr float kFrac = 1.0f / (float)(1u << kShift);
+    const float* tab = tables.table((OscWave)(int)op.p[2].cur, op.p[0].target);
+    uint32_t phase = op.s.phase;
+    for (int i=0;i<n;++i) {
+        const uint32_t idx = phase >> kShift;
+        const float    f   = (float)(phase & ((1u << kShift) - 1u)) * kFrac;
+        out[i] = op.p[1].next() * (tab[idx] + f * (tab[idx+1] - tab[idx]));
+        phase += (uint32_t)(op.p[0].next() * incScale);
+    }
+    op.s.phase = phase;
+}
+
+// Zavalishin/Simper trapezoidal SVF; coefficients once per block.
+static void runFilter(DspOp& op, const float* in, float* out, int n, float sr){
+    const float fc = std::min(op.p[0].skip(n), 0.49f * sr);
+    const float k  = 1.0f / op.p[1].skip(n);
+    const float g  = std::tan(3.14159265f * fc / sr);
+    const float a1 = 1.0f / (1.0f + g * (g + k)), a2 = g * a1, a3 = g * a2;
+    const int   mode = (int)op.p[2].cur;
+    float ic1 = op.s.z1, ic2 = op.s.z2;
+    for (int i=0;i<n;++i) {
+        const float v0 = in ? in[i] : 0.0f;
+        const float v3 = v0 - ic2;
+        const float v1 = a1 * ic1 + a2 * v3;
+        const float v2 = ic2 + a2 * ic1 + a3 * v3;
+        ic1 = 2.0f * v1 - ic1; ic2 = 2.0f * v2 - ic2;
+        out[i] = mode == 0 ? v2 : mode == 1 ? v1 : v0 - k * v1 - v2;
+    }
+    // flush denormals left by a silent input
+    op.s.z1 = std::fabs(ic1) < 1e-20f ? 0.0f : ic1;
+    op.s.z2 = std::fabs(ic2) < 1e-20f ? 0.0f : ic2;
+}
+
+static void runEnv(DspOp& op, const float* in, float* out, int n, float sr){
+    const float atk = 1.0f / (op.p[0].cur * sr);
+    const float sus = op.p[2].cur;
+    const float dec = (1.0f - sus) / (op.p[1].cur * sr);
+    const bool  gate = op.p[4].cur > 0.5f;
+    DspState& s = op.s;
+    if (gate && (s.stage == 0 || s.stage == 4)) s.stage = 1;
+    if (!gate && s.stage >= 1 && s.stage <= 3) { s.stage = 4; s.z1 = s.env / (op.p[3].cur * sr); }
+    float e = s.env;
+    for (int i=0;i<n;++i) {
+        switch (s.stage) {
+        case 1: e += atk; if (e >= 1.0f) { e = 1.0f; s.stage = 2; } break;
+        case 2: e -= dec; if (e <= sus) { e = sus; s.stage = 3; } break;
+        case 3: e = sus; break;
+        case 4: e -= s.z1; if (e <= 0.0f) { e = 0.0f; s.stage = 0; } break;
+        default: e = 0.0f; break;
+        }
+        out[i] = in ? in[i] * e : e;
+    }
+    s.env = e;
+}
+
+void DspProgram::process(float* out, int frames, const OscBank& tables){
+    const float incScale = (float)(4294967296.0 / sr);
+    for (int off=0; off<frames; off+=kBlock) {
+        const int n = std::min(kBlock, frames - off);
+        for (DspOp& op : ops) {
+            float* dst = op.out >= 0 ? &bufs[(size_t)op.out * kBlock] : nullptr;
+            auto src = [&](int i){ return &bufs[(size_t)op.in[i] * kBlock]; };
+            switch (op.type) {
+            case DspNode_Osc:    runOsc(op, dst, n, tables, incScale); break;
+            case DspNode_Filter: runFilter(op, op.nIn ? src(0) : nullptr, dst, n, sr); break;
+            case DspNode_Env:    runEnv(op, op.nIn ? src(0) : nullptr, dst, n, sr); break;
+            case DspNode_Gain: {
+                const float* a = op.nIn ? src(0) : nullptr;
+                for (int i=0;i<n;++i) { const float g = op.p[0].next(); dst[i] = a ? a[i] * g : 0.0f; }
+                break;
+            }
+            case DspNode_Mixer:
+            case DspNode_Output: {
+                float* acc = dst ? dst : out + off;     // Output adds into the engine buffer
+                for (int i=0;i<n;++i) {
+                    float sum = 0.0f;
+                    for (int k=0;k<op.nIn;++k) sum += bufs[(size_t)op.in[k] * kBlock + i];
+                    const float v = sum * op.p[0].next();
+                    acc[i] = dst ? v : acc[i] + v;
+                }
+                break;
+            }
+            default: break;
+            }
+        }
+    }
+}
+
+/*──────────────────── Graph editing ───────────────────*/
+DspGraph::Node* DspGraph::find(int32_t id){
+    for (Node& n : nodes_) if (n.id == id) return &n;
+    return nullptr;
+}
+
+int DspGraph::add(DspNodeType t){
+    if (t >= DspNode_COUNT) return -1;
+    std::lock_guard<std::mutex> lk(m_);
+    Node n{};
+    n.id = nextId_++; n.type = t;
+    const DspNodeInfo& info = dspNodeInfo(t);
+    for (int i=0;i<kDspMaxParams;++i) n.param[i] = i < info.params ? info.def[i] : 0.0f;
+    for (int32_t& s : n.in) s = -1;
+    nodes_.push_back(n);
+    dirty_ = true;
+    return n.id;
+}
+
+bool DspGraph::remove(int32_t id){
+    std::lock_guard<std::mutex> lk(m_);
+    const auto it = std::find_if(nodes_.begin(), nodes_.end(), [&](const Node& n){ return n.id == id; });
+    if (it == nodes_.end()) return false;
+    nodes_.erase(it);
+    for (Node& n : nodes_) for (int32_t& s : n.in) if (s == id) s = -1;
+    dirty_ = true;
+    return true;
+}
+
+bool DspGraph::connect(int32_t src, int32_t dst, int port){
+    std::lock_guard<std::mutex> lk(m_);
+    Node* d = find(dst);
+    const Node* sn = find(src);
+    if (!d || !sn || src == dst || sn->type == DspNode_Output) return false;
+    const int ports = dspNodeInfo(d->type).inputs;
+    if (port < 0) { port = 0; while (port < ports && d->in[port] >= 0) ++port; }
+    if (port >= ports) return false;
+    d->in[port] = src;
+    dirty_ = true;
+    return true;
+}
+
+bool DspGraph::disconnect(int32_t src, int32_t dst){
+    std::lock_guard<std::mutex> lk(m_);
+    Node* d = find(dst);
+    if (!d) return false;
+    bool hit = false;
+    for (int32_t& s : d->in) if (s == src) { s = -1; hit = true; }
+    dirty_ |= hit;
+    return hit;
+}
+
+bool DspGraph::set(int32_t id, int param, float v){
+    std::lock_guard<std::mutex> lk(m_);
+    Node* n = find(id);
+    if (!n || param < 0 || param >= dspNodeInfo(n->type).params || !std::isfinite(v)) return false;
+    v = clampParam(n->type, param, v);
+    if (n->param[param] == v) return true;
+    n->param[param] = v;
+    eng_.graphParam(id, param, v);   // a full queue only loses the ramp; the next commit carries the value
+    return true;
+}
+
+void DspGraph::clear(){
+    std::lock_guard<std::mutex> lk(m_);
+    nodes_.clear(); nextId_ = 0; dirty_ = true;
+    // ids restart at 0: forget the last program so the next commit carries
+    // no phase, filter or envelope state over to unrelated new nodes
+    lastByNode_.clear(); lastTypes_.clear();
+}
+
+int DspGraph::typeOf(int32_t id) const {
+    std::lock_guard<std::mutex> lk(m_);
+    for (const Node& n : nodes_) if (n.id == id) return n.type;
+    return -1;
+}
+
+bool DspGraph::dirty() const { std::lock_guard<std::mutex> lk(m_); return dirty_; }
+
+void DspGraph::snapshot(std::vector<Node>& out) const {
+    std::lock_guard<std::mutex> lk(m_);
+    out.assign(nodes_.begin(), nodes_.end());
+}
+
+DspStats DspGraph::stats() const { std::lock_guard<std::mutex> lk(m_); return stats_; }
+std::string DspGraph::lastError() const { std::lock_guard<std::mutex> lk(m_); return err_; }
+
+/*──────────────────── Compilation ───────────────────*/
+DspProgram* DspGraph::compile(std::string& err) const {
+    const int N = (int)nodes_.size();
+    int32_t maxId = -1;
+    for (const Node& n : nodes_) maxId = std::max(maxId, n.id);
+    std::vector<int> index((size_t)(maxId + 1), -1);        // node id -> nodes_ index
+    for (int i=0;i<N;++i) index[nodes_[i].id] = i;
+
+    int outNode = -1;
+    for (int i=0;i<N;++i) if (nodes_[i].type == DspNode_Output) {
+        if (outNode >= 0) { err = "more than one output node"; return nullptr; }
+        outNode = i;
+    }
+
+    // live = nodes the output depends on
+    std::vector<char> live((size_t)N, 0);
+    std::vector<int> stack;
+    if (outNode >= 0) { live[outNode] = 1; stack.push_back(outNode); }
+    while (!stack.empty()) {
+        const Node& n = nodes_[stack.back()]; stack.pop_back();
+        for (int32_t s : n.in) {
+            if (s < 0 || s > maxId || index[s] < 0 || live[index[s]]) continue;
+            live[index[s]] = 1; stack.push_back(index[s]);
+        }
+    }
+
+    // Kahn over the live subgraph (edges source -> consumer)
+    std::vector<int> indeg((size_t)N, 0), order;
+    std::vector<std::vector<int>> users((size_t)N);
+    for (int i=0;i<N;++i) {
+        if (!live[i]) continue;
+        for (int32_t s : nodes_[i].in) {
+            if (s < 0 || s > maxId || index[s] < 0) continue;
+            users[index[s]].push_back(i); ++indeg[i];
+        }
+    }
+    for (int i=0;i<N;++i) if (live[i] && indeg[i] == 0) stack.push_back(i);
+    while (!stack.empty()) {
+        const int i = stack.back(); stack.pop_back();
+        order.push_back(i);
+        for (int u : users[i]) if (--indeg[u] == 0) stack.push_back(u);
+    }
+    int nLive = 0;
+    for (char l : live) nLive += l;
+    if ((int)order.size() != nLive) { err = "the graph has a cycle"; return nullptr; }
+
+    auto* p = new DspProgram;
+    p->sr = (float)eng_.sampleRate();
+    p->rampLen = eng_.rampLength();
+    p->byNode.assign((size_t)(maxId + 1), -1);
+    p->ops.reserve(order.size());
+
+    // buffers: an op's output is freed after its last consumer has run
+    std::vector<int> pos((size_t)N, -1), lastUse((size_t)N, -1), bufOf((size_t)N, -1), freeBufs;
+    for (int k=0;k<(int)order.size();++k) pos[order[k]] = k;
+    for (int i : order) for (int u : users[i]) lastUse[i] = std::max(lastUse[i], pos[u]);
+
+    for (int k=0;k<(int)order.size();++k) {
+        const Node& n = nodes_[order[k]];
+        const DspNodeInfo& info = dspNodeInfo(n.type);
+        DspOp op{};
+        op.type = n.type; op.node = n.id; op.out = -1;
+        for (int j=0;j<info.params;++j) op.p[j].reset(clampParam(n.type, j, n.param[j]));
+        for (int j=0;j<kDspMaxInputs && j<info.inputs;++j) {
+            const int32_t s = n.in[j];
+            if (s < 0 || s > maxId || index[s] < 0) continue;
+            op.in[op.nIn++] = (int16_t)bufOf[index[s]];
+        }
+        if (n.type != DspNode_Output) {
+            int b;
+            if (!freeBufs.empty()) { b = freeBufs.back(); freeBufs.pop_back(); }
+            else b = p->nBufs++;
+            op.out = (int16_t)b; bufOf[order[k]] = b;
+        }
+        for (int32_t s : n.in)
+            if (s >= 0 && s <= maxId && index[s] >= 0 && lastUse[index[s]] == k && bufOf[index[s]] >= 0) {
+                freeBufs.push_back(bufOf[index[s]]); bufOf[index[s]] = -1 - bufOf[index[s]];   // freed once
+            }
+        p->byNode[n.id] = (int16_t)p->ops.size();
+        p->ops.push_back(op);
+    }
+    p->bufs.assign((size_t)p->nBufs * DspProgram::kBlock, 0.0f);
+    return p;
+}
+
+bool DspGraph::commit(std::string* err){
+    std::lock_guard<std::mutex> lk(m_);
+    std::string e;
+    DspProgram* p = compile(e);
+    if (!p) { err_ = e; if (err) *err = e; return false; }
+
+    // state carry-over: same id and type as in the last committed program
+    p->serial = ++serial_;
+    p->base = serial_ - 1;
+    p->carry.assign(p->ops.size(), -1);
+    for (size_t i=0;i<p->ops.size();++i) {
+        const int32_t id = p->ops[i].node;
+        if (id < (int32_t)lastByNode_.size() && lastByNode_[id] >= 0 && lastTypes_[lastByNode_[id]] == p->ops[i].type)
+            p->carry[i] = lastByNode_[id];
+    }
+    lastByNode_ = p->byNode;
+    lastTypes_.clear();
+    for (const DspOp& op : p->ops) lastTypes_.push_back(op.type);
+
+    stats_.nodes = (int)nodes_.size(); stats_.ops = (int)p->ops.size(); stats_.buffers = p->nBufs; ++stats_.commits;
+    err_.clear(); dirty_ = false;
+    eng_.publishGraph(p);
+    return true;
+}
@@ -0,0 +1,129 @@
+#pragma once
+// Node-based DSP graph.
+//
+// DspGraph is the editable description (UI/Lua side, guarded by a mutex so
+// Lua and the editor may both touch it). commit() compiles it into a
+// DspProgram:
+//   * only nodes that reach the Output node are kept;
+//   * Kahn's algorithm gives a flat execution order (cycles are rejected);
+//   * block buffers are assigned by liveness, so a long chain reuses a few;
+//   * all memory is allocated here, on the committing thread.
+// The program is handed to AudioEngine, which swaps it in at the start of a
+// block with one atomic exchange and hands the old one back through an SPSC
+// queue to be freed off the audio thread. Nodes that survive a recompile keep
+// their oscillator phase, filter and envelope state.
+//
+// Parameter edits (DspGraph::set) are ramped messages through the engine's
+// graph queue; they never recompile.
+
+#include "audio_engine.h"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum DspNodeType : uint8_t {
+    DspNode_Osc,        // wavetable oscillator: freq, amp, wave
+    DspNode_Gain,       // in * gain
+    DspNode_Filter,     // state-variable filter: cutoff, q, mode (0 LP, 1 BP, 2 HP)
+    DspNode_Mixer,      // sum of up to kMaxInputs inputs * gain
+    DspNode_Env,        // ADSR: attack, decay, sustain, release (s), gate; in * env (or env alone)
+    DspNode_Output,     // sum of inputs * gain, added to the engine output
+    DspNode_COUNT
+};
+
+constexpr int kDspMaxInputs = 8;
+constexpr int kDspMaxParams = 5;
+
+struct DspNodeInfo {
+    const char* name;
+    int         inputs;                    // ports
+    int         params;
+    const char* param[kDspMaxParams];
+    float       def[kDspMaxParams], min[kDspMaxParams], max[kDspMaxParams];
+    bool        ramp[kDspMaxParams];       // false: applied at once (enums, gate)
+};
+const DspNodeInfo& dspNodeInfo(DspNodeType t);
+int dspParamIndex(DspNodeType t, const char* name);   // -1 if unknown
+
+/*──────────────────── Compiled program (audio thread) ───────────────────*/
+struct DspState {
+    uint32_t phase = 0;
+    float    z1 = 0.0f, z2 = 0.0f;         // filter integrators / envelope release step
+    float    env = 0.0f;
+    uint8_t  stage = 0;                    // envelope: 0 idle, 1 A, 2 D, 3 S, 4 R
+};
+
+struct DspOp {
+    DspNodeType type;
+    int32_t     node;
+    int16_t     out;                       // buffer index (-1 for Output)
+    int16_t     nIn;
+    int16_t     in[kDspMaxInputs];
+    ParamRamp   p[kDspMaxParams];
+    DspState    s;
+};
+
+struct DspProgram {
+    static constexpr int kBlock = 256;     // samples per scheduling step
+
+    std::vector<DspOp>   ops;              // execution order
+    std::vector<float>   bufs;             // nBufs * kBlock
+    std::vector<int16_t> byNode;           // node id -> op index (-1)
+    std::vector<int16_t> carry;            // op index -> op in program `base` (-1)
+    uint64_t serial = 0, base = 0;
+    int      nBufs = 0, rampLen = 1;
+    float    sr = 48000.0f;
+
+    // audio thread: adds the graph's output to out[0..frames)
+    void process(float* out, int frames, const OscBank& tables);
+    void inherit(const DspProgram& prev);  // state carry-over at swap time
+    void setParam(int32_t node, int param, float v);
+};
+
+/*──────────────────── Editable graph (UI / Lua) ───────────────────*/
+struct DspStats { int nodes = 0, ops = 0, buffers = 0; uint64_t commits = 0; };
+
+class DspGraph {
+public:
+    struct Node {
+        int32_t     id;
+        DspNodeType type;
+        float       param[kDspMaxParams];
+        int32_t     in[kDspMaxInputs];     // source node ids, -1 = unconnected
+    };
+
+    explicit DspGraph(AudioEngine& engine) : eng_(engine) {}
+
+    int  add(DspNodeType t);                        // -> node id
+    bool remove(int32_t id);
+    bool connect(int32_t src, int32_t dst, int port = -1);   // -1: first free port
+    bool disconnect(int32_t src, int32_t dst);
+    bool set(int32_t id, int param, float v);       // ramped, no recompile
+    void clear();
+    int  typeOf(int32_t id) const;                  // DspNodeType, -1 if no such node
+
+    // Compile and hand to the engine. On failure the running program stays.
+    bool commit(std::string* err = nullptr);
+    bool dirty() const;                             // structure changed since the last commit
+
+    void snapshot(std::vector<Node>& out) const;    // copy for editors (reuses out's capacity)
+    DspStats stats() const;
+    std::string lastError() const;                  // of the last failed commit, "" after a good one
+
+private:
+    Node* find(int32_t id);
+    DspProgram* compile(std::string& err) const;
+
+    AudioEngine&       eng_;
+    mutable std::mutex m_;
+    std::vector<Node>  nodes_;
+    int32_t            nextId_ = 0;
+    bool               dirty_ = false;
+    uint64_t           serial_ = 0;
+    std::vector<int16_t>     lastByNode_;           // of the last committed program
+    std::vector<DspNodeType> lastTypes_;
+    DspStats           stats_;
+    std::string        err_;
+};
@@ -0,0 +1,313 @@
+#include "frame_replay.h"
+#include "alloc_hooks.h"
+#include "app_state.h"
+#include "frame_sched.h"
+
+#include "imgui.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+FrameReplay* gReplay = nullptr;
+
+static double nowMs(){
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t fnv1a(uint64_t h, const void* data, size_t n){
+    const unsigned char* b = static_cast<const unsigned char*>(data);
+    for (size_t i=0; i<n; ++i) { h ^= b[i]; h *= 1099511628211ull; }
+    return h;
+}
+
+/*──────────────────── Trace parsing ───────────────────*/
+// Just enough JSON for one flat object of strings, numbers and booleans.
+struct TraceCursor {
+    const char* p;
+    const char* end;
+
+    void ws(){ while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) ++p; }
+    bool eat(char c){ ws(); if (p < end && *p == c) { ++p; return true; } return false; }
+    bool string(std::string& out){
+        out.clear();
+        if (!eat('"')) return false;
+        while (p < end) {
+            char c = *p++;
+            if (c == '"') return true;
+            if (c != '\\') { out += c; continue; }
+            if (p >= end) return false;
+            switch (c = *p++) {
+                case 'n': out += '\n'; break;
+                case 't': out += '\t'; break;
+                case 'u': {                                        // BMP only: labels are UTF-8 anyway
+                    if (end - p < 4) return false;
+                    const unsigned cp = (unsigned)std::strtoul(std::string(p, 4).c_str(), nullptr, 16);
+                    p += 4;
+                    if      (cp < 0x80)  out += (char)cp;
+                    else if (cp < 0x800) { out += (char)(0xC0 | cp >> 6); out += (char)(0x80 | (cp & 0x3F)); }
+                    else { out += (char)(0xE0 | cp >> 12); out += (char)(0x80 | (cp >> 6 & 0x3F)); out += (char)(0x80 | (cp & 0x3F)); }
+                    break;
+                }
+                default: out += c;                                 // \" \\ \/
+            }
+        }
+        return false;
+    }
+    bool scalar(std::string& out){                                 // number, true, false
+        ws();
+        const char* b = p;
+        while (p < end && *p != ',' && *p != '}' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') ++p;
+        out.assign(b, p);
+        return !out.empty() && out[0] != '{' && out[0] != '[';
+    }
+};
+
+bool FrameReplay::load(const char* path, const ReplayOptions& opt, std::string* err){
+    auto fail = [&](const std::string& msg){ if (err) *err = msg; return false; };
+    FILE* f = std::fopen(path, "rb");
+    if (!f) return fail(std::string("cannot open ") + path);
+    path_ = path;
+    opt_ = opt;
+    events_.clear();
+
+    std::string line;
+    int lineNo = 0, last = 0;
+    for (int c = 0; c != EOF; ) {
+        line.clear();
+        while ((c = std::fgetc(f)) != EOF && c != '\n') line += (char)c;
+        ++lineNo;
+        TraceCursor j{ line.data(), line.data() + line.size() };
+        j.ws();
+        if (j.p == j.end) continue;                                // blank line
+        const std::string where = std::string(path) + ":" + std::to_string(lineNo) + ": ";
+        if (!j.eat('{')) { std::fclose(f); return fail(where + "expected a JSON object"); }
+        Event e;
+        int width = 0, height = 0;
+        if (!j.eat('}')) {
+            do {
+                std::string key, val;
+                if (!j.string(key) || !j.eat(':')) { std::fclose(f); return fail(where + "bad JSON"); }
+                j.ws();
+                const bool str = j.p < j.end && *j.p == '"';
+                if (str ? !j.string(val) : !j.scalar(val)) { std::fclose(f); return fail(where + "bad value for \"" + key + "\""); }
+                const float num = (float)std::atof(val.c_str());
+                if      (key == "frame")  e.frame = std::atoi(val.c_str());
+                else if (key == "width")  width = std::atoi(val.c_str());
+                else if (key == "height") height = std::atoi(val.c_str());
+                else if (key == "x")      { e.x = num; e.hasPos = true; }
+                else if (key == "y")      { e.y = num; e.hasPos = true; }
+                else if (key == "button") { e.button = std::atoi(val.c_str()); e.hasButton = true; }
+                else if (key == "down")   e.down = val == "true";
+                else if (key == "wheel")  { e.wheel = num; e.hasWheel = true; }
+                else if (key == "knob")   e.knob = val;
+                else if (key == "value")  { e.value = num; e.hasValue = true; }
+                else if (key == "click")  e.click = val;
+            } while (j.eat(','));                                  // other keys are ignored
+            if (!j.eat('}')) { std::fclose(f); return fail(where + "bad JSON"); }
+        }
+        if (e.hasButton && (e.button < 0 || e.button >= ImGuiMouseButton_COUNT)) { std::fclose(f); return fail(where + "bad mouse button"); }
+        if (e.hasValue && e.knob.empty()) { std::fclose(f); return fail(where + "\"value\" without \"knob\""); }
+        if (width > 0 && height > 0 && e.frame <= 0) { w_ = width; h_ = height; }
+        last = std::max(last, e.frame);
+        events_.push_back(std::move(e));
+    }
+    std::fclose(f);
+    std::stable_sort(events_.begin(), events_.end(), [](const Event& a, const Event& b){ return a.frame < b.frame; });
+
+    frames_ = opt_.frames > 0 ? opt_.frames : last + 1;
+    opt_.warmup = std::max(0, std::min(opt_.warmup, frames_ - 1));
+    if (opt_.dt <= 0.0) opt_.dt = 1.0 / 60.0;
+    frame_ = 0; ev0_ = ev1_ = 0;
+    samples_.clear(); samples_.reserve((size_t)frames_);
+    audio_.assign(256, 0.0f);
+    drawHash_ = 1469598103934665603ull; pixelHash_ = 0;
+    return true;
+}
+
+/*──────────────────── Offscreen target ───────────────────*/
+bool FrameReplay::createTarget(){
+    glGenTextures(1, &tex_);
+    glBindTexture(GL_TEXTURE_2D, tex_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w_, h_, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glGenFramebuffers(1, &fbo_);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex_, 0);
+    const bool ok = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!ok) destroyTarget();
+    return ok;
+}
+
+void FrameReplay::destroyTarget(){
+    if (fbo_) glDeleteFramebuffers(1, &fbo_);
+    if (tex_) glDeleteTextures(1, &tex_);
+    fbo_ = tex_ = 0;
+}
+
+/*──────────────────── Frames ───────────────────*/
+void FrameReplay::beginFrame(ImGuiIO& io){
+    setFixedFrameClock((double)frame_ * opt_.dt);
+    io.DisplaySize = ImVec2((float)w_, (float)h_);
+    io.DisplayFramebufferScale = ImVec2(1.0f, 1.0f);
+    io.DeltaTime = (float)opt_.dt;
+
+    ev0_ = ev1_;
+    while (ev1_ < events_.size() && events_[ev1_].frame <= frame_) ++ev1_;
+    for (size_t i=ev0_; i<ev1_; ++i) {
+        const Event& e = events_[i];
+        if (e.hasPos)    io.AddMousePosEvent(e.x, e.y);
+        if (e.hasButton) io.AddMouseButtonEvent(e.button, e.down);
+        if (e.hasWheel)  io.AddMouseWheelEvent(0.0f, e.wheel);
+    }
+
+    // this frame's share of audio, rendered here in device-sized blocks
+    // instead of by the PortAudio callback
+    const double sr = gAudio.sampleRate();
+    long long n = std::llround((double)(frame_ + 1) * opt_.dt * sr) - std::llround((double)frame_ * opt_.dt * sr);
+    while (n > 0) {
+        const unsigned long blk = (unsigned long)std::min<long long>(n, (long long)audio_.size());
+        gAudio.render(audio_.data(), blk);
+        gScope.write(audio_.data(), blk);
+        n -= (long long)blk;
+    }
+
+    t0_ = tPhase_ = nowMs();
+    std::fill(std::begin(phaseMs_), std::end(phaseMs_), 0.0);
+}
+
+void FrameReplay::phase(ReplayPhase p){
+    const double t = nowMs();
+    phaseMs_[p] = t - tPhase_;
+    tPhase_ = t;
+}
+
+void FrameReplay::endFrame(){
+    const double tWait = nowMs();
+    glFinish();
+    const double t1 = nowMs();
+
+    // everything below is outside the timed region
+    Sample s{};
+    s.frameMs = t1 - t0_;
+    s.gpuMs = t1 - tWait;
+    std::copy(std::begin(phaseMs_), std::end(phaseMs_), s.phaseMs);
+    if (const ImDrawData* dd = ImGui::GetDrawData()) {
+        s.vtx = dd->TotalVtxCount; s.idx = dd->TotalIdxCount;
+        for (int l=0; l<dd->CmdListsCount; ++l) {
+            const ImDrawList* dl = dd->CmdLists[l];
+            for (const ImDrawCmd& c : dl->CmdBuffer) {
+                if (c.UserCallback) continue;
+                ++s.drawCalls;
+                drawHash_ = fnv1a(drawHash_, &c.ClipRect, sizeof(c.ClipRect));
+                drawHash_ = fnv1a(drawHash_, &c.ElemCount, sizeof(c.ElemCount));
+            }
+            drawHash_ = fnv1a(drawHash_, dl->VtxBuffer.Data, (size_t)dl->VtxBuffer.Size * sizeof(ImDrawVert));
+            drawHash_ = fnv1a(drawHash_, dl->IdxBuffer.Data, (size_t)dl->IdxBuffer.Size * sizeof(ImDrawIdx));
+        }
+    }
+    const AllocCounters a = allocLastFrame();
+    s.luaAllocs = a.luaAllocs; s.luaHeap = a.luaHeap; s.imguiAllocs = a.imguiAllocs;
+    if (frame_ >= opt_.warmup) samples_.push_back(s);
+
+    if (++frame_ < frames_) return;
+    std::vector<unsigned char> px((size_t)w_ * h_ * 4);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo_);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, w_, h_, GL_RGBA, GL_UNSIGNED_BYTE, px.data());
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    pixelHash_ = fnv1a(1469598103934665603ull, px.data(), px.size());
+}
+
+void FrameReplay::knob(const char* label, float& v) const {
+    for (size_t i=ev0_; i<ev1_; ++i)
+        if (events_[i].hasValue && events_[i].knob == label) v = events_[i].value;
+}
+
+bool FrameReplay::click(const char* label) const {
+    for (size_t i=ev0_; i<ev1_; ++i)
+        if (events_[i].click == label) return true;
+    return false;
+}
+
+/*──────────────────── Report ───────────────────*/
+static std::string jsonEscape(const char* s){
+    std::string out;
+    for (; s && *s; ++s) {
+        const unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') { out += '\\'; out += (char)c; }
+        else if (c < 0x20) { char b[8]; std::snprintf(b, sizeof(b), "\\u%04x", c); out += b; }
+        else out += (char)c;
+    }
+    return out;
+}
+
+// {"mean":..,"p50":..,"p90":..,"p99":..,"max":..} of v (nearest rank)
+static void printDist(FILE* f, const char* name, std::vector<double> v){
+    std::sort(v.begin(), v.end());
+    double sum = 0.0;
+    for (double x : v) sum += x;
+    auto pct = [&](double p){ return v.empty() ? 0.0 : v[std::min(v.size() - 1, (size_t)std::ceil(p * (double)v.size()) - (p > 0.0))]; };
+    std::fprintf(f, "\"%s\":{\"mean\":%.4f,\"p50\":%.4f,\"p90\":%.4f,\"p99\":%.4f,\"max\":%.4f}",
+                 name, v.empty() ? 0.0 : sum / (double)v.size(), pct(0.50), pct(0.90), pct(0.99), v.empty() ? 0.0 : v.back());
+}
+
+void FrameReplay::writeJson(FILE* f, const char* renderer, bool torusCpu) const {
+    auto column = [&](auto get){ std::vector<double> v; v.reserve(samples_.size()); for (const Sample& s : samples_) v.push_back((double)get(s)); return v; };
+    std::fprintf(f, "{\"trace\":\"%s\",\"frames\":%d,\"warmup\":%d,\"dt\":%g,\"width\":%d,\"height\":%d,"
+                    "\"renderer\":\"%s\",\"torus\":\"%s\",",
+                 jsonEscape(path_.c_str()).c_str(), frames_, opt_.warmup, opt_.dt, w_, h_,
+                 jsonEscape(renderer).c_str(), torusCpu ? "cpu" : "gpu");
+    printDist(f, "frame_ms",    column([](const Sample& s){ return s.frameMs; }));                         std::fputc(',', f);
+    printDist(f, "draw_ui_ms",  column([](const Sample& s){ return s.phaseMs[ReplayPhase_Lua]; }));        std::fputc(',', f);
+    printDist(f, "render_ms",   column([](const Sample& s){ return s.phaseMs[ReplayPhase_Render]; }));     std::fputc(',', f);
+    printDist(f, "gpu_wait_ms", column([](const Sample& s){ return s.gpuMs; }));                           std::fputc(',', f);
+    printDist(f, "draw_calls",  column([](const Sample& s){ return s.drawCalls; }));                       std::fputc(',', f);
+    printDist(f, "vertices",    column([](const Sample& s){ return s.vtx; }));                             std::fputc(',', f);
+    printDist(f, "indices",     column([](const Sample& s){ return s.idx; }));                             std::fputc(',', f);
+    printDist(f, "lua_allocs",  column([](const Sample& s){ return s.luaAllocs; }));                       std::fputc(',', f);
+    printDist(f, "lua_heap_allocs", column([](const Sample& s){ return s.luaHeap; }));                     std::fputc(',', f);
+    printDist(f, "imgui_allocs", column([](const Sample& s){ return s.imguiAllocs; }));                    std::fputc(',', f);
+    int dirty = 0;
+    for (const Sample& s : samples_) if (s.luaAllocs || s.imguiAllocs) ++dirty;
+    std::fprintf(f, "\"allocating_frames\":%d,\"draw_checksum\":\"%016llx\",\"pixel_checksum\":\"%016llx\"}\n",
+                 dirty, (unsigned long long)drawHash_, (unsigned long long)pixelHash_);
+}
+
+/*──────────────────── Recording ───────────────────*/
+bool TraceWriter::open(const char* path){
+    close();
+    f_ = std::fopen(path, "w");
+    frame_ = 0; x_ = y_ = -1.0f;
+    std::fill(std::begin(down_), std::end(down_), false);
+    return f_ != nullptr;
+}
+
+void TraceWriter::close(){
+    if (f_) std::fclose(f_);
+    f_ = nullptr;
+}
+
+void TraceWriter::frame(const ImGuiIO& io){
+    if (!f_) return;
+    if (frame_ == 0)
+        std::fprintf(f_, "{\"frame\":0,\"width\":%d,\"height\":%d}\n", (int)io.DisplaySize.x, (int)io.DisplaySize.y);
+    if (ImGui::IsMousePosValid(&io.MousePos) && (io.MousePos.x != x_ || io.MousePos.y != y_)) {
+        x_ = io.MousePos.x; y_ = io.MousePos.y;
+        std::fprintf(f_, "{\"frame\":%d,\"x\":%.9g,\"y\":%.9g}\n", frame_, x_, y_);
+    }
+    for (int b=0; b<3; ++b)
+        if (io.MouseDown[b] != down_[b]) {
+            down_[b] = io.MouseDown[b];
+            std::fprintf(f_, "{\"frame\":%d,\"button\":%d,\"down\":%s}\n", frame_, b, down_[b] ? "true" : "false");
+        }
+    if (io.MouseWheel != 0.0f) std::fprintf(f_, "{\"frame\":%d,\"wheel\":%.9g}\n", frame_, io.MouseWheel);
+    ++frame_;
+}
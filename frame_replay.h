@@ -0,0 +1,108 @@
+#pragma once
+// Deterministic headless frame replay: `sine_demo --replay TRACE`.
+//
+// Runs main()'s frame pipeline (Lua draw_ui -> ImGui -> torus targets ->
+// RenderDrawData) for a fixed number of frames without a display or a
+// sound card:
+//   - the animation clock (frameClock, frame_sched.h) is frame * dt;
+//   - ImGui gets its input and a fixed DeltaTime from the trace, not GLFW;
+//   - audio is rendered on the calling thread, dt worth of samples per
+//     frame, into the scope ring;
+//   - ImGui draws into an offscreen FBO instead of the window.
+// Wall-clock readouts the UI can show (loop and audio callback stats, the
+// profiler, CPU raymarch ms) stay at zero, so two runs of one build produce
+// the same draw data and pixels.
+//
+// The trace is JSON lines, one flat object each, applied before `frame`:
+//   {"frame":0,"width":1000,"height":760}      display size (frame 0 only)
+//   {"frame":5,"x":120,"y":80}                  mouse position
+//   {"frame":6,"button":0,"down":true}          mouse button
+//   {"frame":9,"wheel":-1}                      vertical scroll
+//   {"frame":10,"knob":"Yaw","value":1.5}       that knob takes the value, as if dragged
+//   {"frame":12,"click":"Variant ▶"}            that button reports a click
+// TraceWriter (`sine_demo --record-trace PATH`) writes the mouse events of
+// a live session in the same format.
+//
+// The report (JSON) has frame-time percentiles, per-phase times, draw
+// calls/vertices/indices from ImDrawData, allocations per frame, and
+// checksums of the draw data of every frame and of the last frame's pixels.
+//
+// UI/render thread only; GL calls need the current context.
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+struct ImGuiIO;
+
+struct ReplayOptions {
+    int    frames = 0;                // 0 => last trace frame + 1 (at least 1)
+    int    warmup = 10;               // frames left out of the timing stats
+    double dt = 1.0 / 60.0;           // seconds per frame
+};
+
+enum ReplayPhase { ReplayPhase_Lua, ReplayPhase_Render, ReplayPhase_COUNT };
+
+class FrameReplay {
+public:
+    bool load(const char* path, const ReplayOptions& opt, std::string* err);
+    int  width() const  { return w_; }
+    int  height() const { return h_; }
+
+    bool createTarget();              // offscreen RGBA8 FBO, width() x height()
+    void destroyTarget();
+    unsigned fbo() const { return fbo_; }
+
+    bool done() const { return frame_ >= frames_; }
+    void beginFrame(ImGuiIO& io);     // before ImGui::NewFrame
+    void phase(ReplayPhase p);        // end of phase p in the current frame
+    void endFrame();                  // after allocFrameEnd: waits for the GPU, then measures
+
+    // Trace-driven widgets (demo_api.cpp), for the current frame.
+    void knob(const char* label, float& v) const;
+    bool click(const char* label) const;
+
+    uint64_t drawChecksum() const  { return drawHash_; }
+    uint64_t pixelChecksum() const { return pixelHash_; }
+    void writeJson(FILE* f, const char* renderer, bool torusCpu) const;
+
+private:
+    struct Event {
+        int   frame = 0;
+        bool  hasPos = false, hasButton = false, hasWheel = false, hasValue = false;
+        float x = 0, y = 0, wheel = 0, value = 0;
+        int   button = 0; bool down = false;
+        std::string knob, click;
+    };
+    struct Sample { double frameMs, phaseMs[ReplayPhase_COUNT], gpuMs; int drawCalls, vtx, idx;
+                    uint64_t luaAllocs, luaHeap, imguiAllocs; };
+
+    std::string        path_;
+    std::vector<Event> events_;       // sorted by frame
+    size_t             ev0_ = 0, ev1_ = 0;   // current frame's events
+    ReplayOptions      opt_;
+    int      w_ = 1000, h_ = 760, frames_ = 1, frame_ = 0;
+    unsigned fbo_ = 0, tex_ = 0;
+    double   t0_ = 0, tPhase_ = 0, phaseMs_[ReplayPhase_COUNT] = {};
+    std::vector<float>  audio_;
+    std::vector<Sample> samples_;
+    uint64_t drawHash_ = 1469598103934665603ull, pixelHash_ = 0;
+};
+
+extern FrameReplay* gReplay;          // non-null while replaying
+
+// Writes a live session's mouse input as a trace FrameReplay can load.
+class TraceWriter {
+public:
+    ~TraceWriter() { close(); }
+    bool open(const char* path);
+    void close();
+    void frame(const ImGuiIO& io);    // after ImGui::NewFrame
+
+private:
+    FILE* f_ = nullptr;
+    int   frame_ = 0;
+    float x_ = -1.0f, y_ = -1.0f;
+    bool  down_[3] = {};
+};
@@ -0,0 +1,112 @@
+#include "frame_sched.h"
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <thread>
+
+#if defined(_WIN32)
+  #include <windows.h>
+#else
+  #include <sys/resource.h>
+#endif
+
+FrameScheduler gFrameSched;
+
+double processCpuSeconds(){
+#if defined(_WIN32)
+    FILETIME c, e, k, u;
+    if (!GetProcessTimes(GetCurrentProcess(), &c, &e, &k, &u)) return 0.0;
+    auto s = [](const FILETIME& f){ return (double)(((uint64_t)f.dwHighDateTime << 32) | f.dwLowDateTime) * 1e-7; };
+    return s(k) + s(u);
+#else
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    return (double)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) + (double)(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1e-6;
+#endif
+}
+
+static std::atomic<double> gFixedClock{-1.0};
+
+double frameClock(){
+    const double t = gFixedClock.load(std::memory_order_relaxed);
+    return t >= 0.0 ? t : glfwGetTime();
+}
+void setFixedFrameClock(double seconds){ gFixedClock.store(seconds, std::memory_order_relaxed); }
+bool frameClockFixed(){ return gFixedClock.load(std::memory_order_relaxed) >= 0.0; }
+
+void FrameScheduler::request(int n){
+    int cur = pending_.load(std::memory_order_relaxed);
+    while (cur < n && !pending_.compare_exchange_weak(cur, n, std::memory_order_relaxed)) {}
+    if (cur == 0) glfwPostEmptyEvent();           // may be blocked in glfwWaitEvents*
+}
+
+void FrameScheduler::setTargetFps(double fps){ targetFps_.store(std::max(0.0, fps), std::memory_order_relaxed); request(1); }
+void FrameScheduler::setIdleFps(double fps)  { idleFps_.store(std::max(0.0, fps), std::memory_order_relaxed); request(1); }
+
+/*──────────────────── Input callbacks ───────────────────*/
+static void onInput(){ gFrameSched.request(FrameScheduler::kInputFrames); }
+
+void FrameScheduler::installCallbacks(GLFWwindow* win){
+    glfwSetCursorPosCallback      (win, [](GLFWwindow*, double, double){ onInput(); });
+    glfwSetCursorEnterCallback    (win, [](GLFWwindow*, int){ onInput(); });
+    glfwSetMouseButtonCallback    (win, [](GLFWwindow*, int, int, int){ onInput(); });
+    glfwSetScrollCallback         (win, [](GLFWwindow*, double, double){ onInput(); });
+    glfwSetKeyCallback            (win, [](GLFWwindow*, int, int, int, int){ onInput(); });
+    glfwSetCharCallback           (win, [](GLFWwindow*, unsigned int){ onInput(); });
+    glfwSetWindowFocusCallback    (win, [](GLFWwindow*, int){ onInput(); });
+    glfwSetWindowSizeCallback     (win, [](GLFWwindow*, int, int){ onInput(); });
+    glfwSetWindowRefreshCallback  (win, [](GLFWwindow*){ onInput(); });
+    glfwSetWindowIconifyCallback  (win, [](GLFWwindow*, int){ onInput(); });
+}
+
+/*──────────────────── Loop ───────────────────*/
+bool FrameScheduler::waitForFrame(GLFWwindow* win){
+    if (glfwGetWindowAttrib(win, GLFW_ICONIFIED)) {
+        glfwWaitEvents();                         // nothing to show: sleep until restored
+        return false;
+    }
+    if (pending_.load(std::memory_order_relaxed) > 0) {
+        glfwPollEvents();
+    } else {
+        const double idle = idleFps();
+        if (idle > 0.0) glfwWaitEventsTimeout(1.0 / idle);
+        else            glfwWaitEvents();
+    }
+    // consume one requested frame (requests made during the wait are kept)
+    int cur = pending_.load(std::memory_order_relaxed);
+    while (cur > 0 && !pending_.compare_exchange_weak(cur, cur - 1, std::memory_order_relaxed)) {}
+    frameIdle_ = cur <= 0;
+
+    const double fps = targetFps();
+    const int interval = fps > 0.0 ? 0 : 1;
+    if (interval != swapInterval_) { glfwSwapInterval(interval); swapInterval_ = interval; }
+    return true;
+}
+
+void FrameScheduler::endFrame(){
+    const Clock::time_point now = Clock::now();
+    const double fps = targetFps();
+    if (fps > 0.0) {
+        // fixed cadence; after a long stall, restart instead of bursting to catch up
+        const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fps));
+        next_ = (next_ + period < now) ? now + period : next_ + period;
+        std::this_thread::sleep_until(next_);
+    }
+
+    ++frames_; ++winFrames_; if (frameIdle_) ++winIdle_;
+    const Clock::time_point t = Clock::now();
+    if (winStart_ == Clock::time_point{}) { winStart_ = t; winCpu_ = processCpuSeconds(); return; }
+    const double wall = std::chrono::duration<double>(t - winStart_).count();
+    if (wall >= 1.0) {
+        const double cpu = processCpuSeconds();
+        last_.fps = (double)winFrames_ / wall;
+        last_.cpuMsPerSec = (cpu - winCpu_) * 1e3 / wall;
+        last_.idleFraction = (double)winIdle_ / (double)winFrames_;
+        winStart_ = t; winCpu_ = cpu; winFrames_ = winIdle_ = 0;
+    }
+    last_.frames = frames_;
+    last_.idle = frameIdle_;
+}
+
+LoopStats FrameScheduler::stats() const { return last_; }
@@ -0,0 +1,74 @@
+#pragma once
+// Event-driven main loop pacing.
+//
+// The loop only renders continuously while something asked for frames:
+// input (installed GLFW callbacks request a few frames so ImGui can settle),
+// or a widget that is animating (request(n) from any thread). Otherwise it
+// blocks in glfwWaitEventsTimeout and redraws at the idle rate; minimized,
+// it blocks until an event arrives. With a target frame rate the loop paces
+// itself with sleeps instead of vsync.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+struct GLFWwindow;
+
+struct LoopStats {
+    double fps = 0.0;            // frames rendered per second (last 1 s window)
+    double cpuMsPerSec = 0.0;    // process CPU time per wall second (same window)
+    double idleFraction = 0.0;   // share of frames with no pending request
+    uint64_t frames = 0;
+    bool   idle = false;         // last frame had nothing pending
+};
+
+class FrameScheduler {
+public:
+    static constexpr int kInputFrames = 3;
+
+    // Keep rendering for at least the next n frames. Any thread.
+    void request(int n = 1);
+
+    void   setTargetFps(double fps);    // 0 => vsync
+    void   setIdleFps(double fps);      // redraws/s with nothing pending; 0 => only on events
+    double targetFps() const { return targetFps_.load(std::memory_order_relaxed); }
+    double idleFps()   const { return idleFps_.load(std::memory_order_relaxed); }
+
+    // Main thread. Installs input callbacks; call before
+    // ImGui_ImplGlfw_InitForOpenGL(win, true) so the backend chains them.
+    void installCallbacks(GLFWwindow* win);
+
+    // Main thread, once per loop iteration: processes events, blocking when
+    // idle. Returns false if the frame should be skipped (minimized).
+    bool waitForFrame(GLFWwindow* win);
+    void endFrame();                    // after swap: pacing + stats
+
+    LoopStats stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    std::atomic<int>    pending_{kInputFrames};
+    std::atomic<double> targetFps_{0.0}, idleFps_{2.0};
+    int    swapInterval_ = -1;
+    bool   frameIdle_ = false;
+    Clock::time_point next_{};
+
+    // stats window
+    Clock::time_point winStart_{};
+    double   winCpu_ = 0.0;
+    uint64_t winFrames_ = 0, winIdle_ = 0, frames_ = 0;
+    LoopStats last_;
+};
+
+extern FrameScheduler gFrameSched;
+
+// Process CPU time (user + system) in seconds.
+double processCpuSeconds();
+
+// Animation clock in seconds: glfwGetTime(), or a fixed value set once per
+// frame by the replay harness (frame_replay.h) so animated output is
+// reproducible. Any thread.
+double frameClock();
+void   setFixedFrameClock(double seconds);   // < 0 => back to glfwGetTime()
+bool   frameClockFixed();
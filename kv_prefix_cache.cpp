@@ -0,0 +1,167 @@
+#include "kv_prefix_cache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#if defined(_WIN32)
+  #include <direct.h>
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+double msSince(Clock::time_point t0){ return std::chrono::duration<double, std::milli>(Clock::now() - t0).count(); }
+
+uint64_t fnv64(uint64_t h, const void* p, size_t n){
+    const unsigned char* b = static_cast<const unsigned char*>(p);
+    for (size_t i=0;i<n;++i) { h ^= b[i]; h *= 1099511628211ull; }
+    return h;
+}
+constexpr uint64_t kFnvBasis = 14695981039346656037ull;
+
+struct FileHeader { char magic[4]; uint32_t version; uint64_t key, model; uint32_t nTokens; uint32_t pad; uint64_t stateBytes; };
+constexpr char     kMagic[4]     = { 'M', 'L', 'K', 'V' };
+constexpr uint32_t kFileVersion  = 1;
+
+} // namespace
+
+/*──────────────────── Keys ───────────────────*/
+bool KvPrefixCache::setModel(const char* path, const llama_model* model){
+    struct stat st{};
+    FILE* f = std::fopen(path, "rb");
+    if (!f || stat(path, &st) != 0) { if (f) std::fclose(f); return false; }
+    std::vector<unsigned char> head(1u << 20);
+    const size_t n = std::fread(head.data(), 1, head.size(), f);
+    std::fclose(f);
+
+    uint64_t h = fnv64(kFnvBasis, head.data(), n);
+    const int64_t meta[2] = { (int64_t)st.st_size, (int64_t)st.st_mtime };
+    h = fnv64(h, meta, sizeof(meta));
+    char desc[128] = {};
+    llama_model_desc(model, desc, sizeof(desc));
+    h = fnv64(h, desc, std::strlen(desc));
+    if (h != model_) lru_.clear();
+    model_ = h;
+    return true;
+}
+
+uint64_t KvPrefixCache::keyOf(const llama_token* toks, int n) const {
+    return fnv64(fnv64(kFnvBasis, &model_, sizeof(model_)), toks, sizeof(llama_token) * (size_t)n);
+}
+
+std::string KvPrefixCache::pathOf(uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.kv", (unsigned long long)key);
+    return dir_ + "/" + name;
+}
+
+/*──────────────────── Files ───────────────────*/
+bool KvPrefixCache::load(uint64_t key, const llama_token* toks, int n, Entry& out) const {
+    if (dir_.empty()) return false;
+    const std::string path = pathOf(key);
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+    FileHeader h{};
+    bool ok = std::fread(&h, sizeof(h), 1, f) == 1
+           && !std::memcmp(h.magic, kMagic, 4) && h.version == kFileVersion
+           && h.key == key && h.model == model_ && h.nTokens == (uint32_t)n;
+    if (ok) {   // the header's sizes must account for exactly the rest of the file before anything is allocated
+        const long pos = std::ftell(f);
+        ok = pos >= 0 && std::fseek(f, 0, SEEK_END) == 0;
+        const long end = ok ? std::ftell(f) : -1;
+        const uint64_t left = end >= pos ? (uint64_t)(end - pos) : 0, tokBytes = sizeof(llama_token) * (uint64_t)n;
+        ok = ok && std::fseek(f, pos, SEEK_SET) == 0 && left >= tokBytes && h.stateBytes == left - tokBytes;
+    }
+    if (ok) {
+        out.toks.resize((size_t)n);
+        out.state.resize((size_t)h.stateBytes);
+        ok = std::fread(out.toks.data(), sizeof(llama_token), (size_t)n, f) == (size_t)n
+          && std::fread(out.state.data(), 1, out.state.size(), f) == out.state.size()
+          && !std::memcmp(out.toks.data(), toks, sizeof(llama_token) * (size_t)n);
+    }
+    std::fclose(f);
+    if (!ok) { std::remove(path.c_str()); return false; }   // stale or foreign: never try it again
+    out.key = key;
+    return true;
+}
+
+// Write-then-rename, so a crash never leaves a half file under the real name.
+void KvPrefixCache::save(const Entry& e) const {
+    if (dir_.empty()) return;
+#if defined(_WIN32)
+    _mkdir(dir_.c_str());
+#else
+    mkdir(dir_.c_str(), 0755);
+#endif
+    const std::string path = pathOf(e.key), tmp = path + ".tmp";
+    FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) return;
+    const FileHeader h{ { kMagic[0], kMagic[1], kMagic[2], kMagic[3] }, kFileVersion, e.key, model_,
+                        (uint32_t)e.toks.size(), 0, (uint64_t)e.state.size() };
+    bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1
+           && std::fwrite(e.toks.data(), sizeof(llama_token), e.toks.size(), f) == e.toks.size()
+           && std::fwrite(e.state.data(), 1, e.state.size(), f) == e.state.size();
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok) { std::remove(tmp.c_str()); return; }
+#if defined(_WIN32)
+    std::remove(path.c_str());
+#endif
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) std::remove(tmp.c_str());
+}
+
+void KvPrefixCache::remember(Entry e){
+    for (auto it = lru_.begin(); it != lru_.end(); ++it)
+        if (it->key == e.key) { lru_.erase(it); break; }
+    lru_.push_front(std::move(e));
+    while (lru_.size() > cap_) lru_.pop_back();
+}
+
+/*──────────────────── Restore / store ───────────────────*/
+bool KvPrefixCache::restore(llama_context* ctx, llama_seq_id seq, const llama_token* toks, int n){
+    const Clock::time_point t0 = Clock::now();
+    const uint64_t key = keyOf(toks, n);
+    Entry e;
+    bool found = false, fromFile = false;
+    for (auto it = lru_.begin(); it != lru_.end(); ++it)
+        if (it->key == key && it->toks.size() == (size_t)n && !std::memcmp(it->toks.data(), toks, sizeof(llama_token) * (size_t)n)) {
+            lru_.splice(lru_.begin(), lru_, it);
+            found = true;
+            break;
+        }
+    if (!found && load(key, toks, n, e)) found = fromFile = true;
+    if (!found) { ++stats_.misses; return false; }
+
+    const Entry& hit = fromFile ? e : lru_.front();
+    llama_memory_seq_rm(llama_get_memory(ctx), seq, -1, -1);
+    if (llama_state_seq_set_data(ctx, hit.state.data(), hit.state.size(), seq) == 0) {
+        llama_memory_seq_rm(llama_get_memory(ctx), seq, -1, -1);
+        if (fromFile) std::remove(pathOf(key).c_str());
+        else lru_.pop_front();
+        ++stats_.misses;
+        return false;
+    }
+    stats_.lastBytes = hit.state.size();
+    if (fromFile) { ++stats_.fileHits; remember(std::move(e)); }
+    ++stats_.hits;
+    stats_.lastRestoreMs = msSince(t0);
+    return true;
+}
+
+bool KvPrefixCache::store(llama_context* ctx, llama_seq_id seq, const llama_token* toks, int n){
+    const Clock::time_point t0 = Clock::now();
+    Entry e;
+    e.key = keyOf(toks, n);
+    e.toks.assign(toks, toks + n);
+    e.state.resize(llama_state_seq_get_size(ctx, seq));
+    if (e.state.empty()) return false;
+    const size_t got = llama_state_seq_get_data(ctx, e.state.data(), e.state.size(), seq);
+    if (got == 0) return false;
+    e.state.resize(got);
+    save(e);
+    stats_.lastBytes = e.state.size();
+    remember(std::move(e));
+    ++stats_.stores;
+    stats_.lastStoreMs = msSince(t0);
+    return true;
+}
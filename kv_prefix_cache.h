@@ -0,0 +1,61 @@
+#pragma once
+// Prompt-prefix KV cache for llama.cpp.
+//
+// After a prefix (system preamble, ...) has been decoded into a sequence,
+// store() snapshots that sequence with llama_state_seq_get_data into a small
+// in-process LRU and a file under the cache directory. restore() puts it
+// back into a fresh sequence, so only the rest of the prompt is decoded.
+//
+// Entries are keyed by a hash of the model fingerprint and the prefix
+// tokens; the tokens themselves are stored and compared on restore, so a
+// hash collision cannot return the wrong state. The fingerprint covers the
+// model file's size, mtime and a hash of its first MiB (the GGUF header and
+// metadata), so replacing the model invalidates every entry. A state that
+// llama.cpp refuses (other KV type, other version) counts as a miss and the
+// file is deleted.
+
+#include "llama.h"
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <vector>
+
+struct KvPrefixStats {
+    uint64_t hits = 0, misses = 0, fileHits = 0, stores = 0;
+    size_t   lastBytes = 0;
+    double   lastRestoreMs = 0, lastStoreMs = 0;
+};
+
+class KvPrefixCache {
+public:
+    // dir "" keeps entries in memory only
+    explicit KvPrefixCache(std::string dir, size_t memEntries = 4) : dir_(std::move(dir)), cap_(memEntries) {}
+
+    // Must be called once the model is loaded; false if the file can't be read.
+    bool setModel(const char* path, const llama_model* model);
+
+    // true: seq now holds toks[0..n) at positions 0..n-1 (no logits; decode
+    // at least one more token before sampling). false: nothing was restored;
+    // seq is untouched, or emptied if a cached state was tried and rejected.
+    bool restore(llama_context* ctx, llama_seq_id seq, const llama_token* toks, int n);
+    // seq must hold exactly toks[0..n).
+    bool store(llama_context* ctx, llama_seq_id seq, const llama_token* toks, int n);
+
+    const KvPrefixStats& stats() const { return stats_; }
+
+private:
+    struct Entry { uint64_t key; std::vector<llama_token> toks; std::vector<uint8_t> state; };
+
+    uint64_t keyOf(const llama_token* toks, int n) const;
+    std::string pathOf(uint64_t key) const;
+    bool load(uint64_t key, const llama_token* toks, int n, Entry& out) const;
+    void save(const Entry& e) const;
+    void remember(Entry e);
+
+    std::string dir_;
+    size_t cap_;
+    uint64_t model_ = 0;
+    std::list<Entry> lru_;        // front = most recent
+    KvPrefixStats stats_;
+};
@@ -0,0 +1,363 @@
+#include "llm_worker.h"
+
+#include "frame_sched.h"
+#include "util.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#if SINE_LLM
+#include "llama.h"
+#endif
+
+namespace {
+
+enum Reason : uint8_t { Reason_None, Reason_Eos, Reason_Length, Reason_Cancelled, Reason_Error };
+const char* const kReasons[] = { "", "eos", "length", "cancelled", "error" };
+
+#if SINE_LLM
+using Clock = std::chrono::steady_clock;
+
+// Bytes at the end of s that start a UTF-8 sequence not yet complete (a token can end mid-character).
+size_t utf8IncompleteTail(const std::string& s){
+    for (size_t k=1; k<=3 && k<=s.size(); ++k) {
+        const unsigned char c = (unsigned char)s[s.size() - k];
+        if ((c & 0xC0) == 0x80) continue;
+        const size_t need = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+        return need > k ? k : 0;
+    }
+    return 0;
+}
+
+void quietLog(ggml_log_level level, const char* text, void*){
+    if (level == GGML_LOG_LEVEL_ERROR) std::fprintf(stderr, "[llm] %s", text);
+}
+
+bool tokenize(const llama_vocab* vocab, const std::string& text, std::vector<llama_token>& out){
+    out.resize(text.size() + 8);
+    int32_t n = llama_tokenize(vocab, text.c_str(), (int32_t)text.size(), out.data(), (int32_t)out.size(), true, false);
+    if (n < 0) {
+        out.resize((size_t)-n);
+        n = llama_tokenize(vocab, text.c_str(), (int32_t)text.size(), out.data(), (int32_t)out.size(), true, false);
+    }
+    if (n <= 0) return false;
+    out.resize((size_t)n);
+    return true;
+}
+#endif
+
+} // namespace
+
+/*──────────────────── Lua thread ───────────────────*/
+LlmWorker::~LlmWorker(){ unload(); }
+
+bool LlmWorker::load(const std::string& modelPath, const LlmOptions& opt, std::string* err){
+#if !SINE_LLM
+    (void)modelPath; (void)opt;
+    if (err) *err = "built without llama.cpp";
+    return false;
+#else
+    unload();
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        error_.clear();
+        model_ = modelPath;
+    }
+    progress_.store(0.0f);
+    state_.store(LlmState_Loading);
+    thread_ = std::thread(&LlmWorker::run, this, modelPath, opt);
+    (void)err;
+    return true;
+#endif
+}
+
+void LlmWorker::unload(){
+    if (thread_.joinable()) {
+        {
+            // the prompt and token loops only poll cancellation: cancel everything
+            // so a running generation stops at its next token instead of at maxTokens
+            std::lock_guard<std::mutex> lk(m_);
+            quit_ = true;
+            cancels_.push_back(0);
+            cancelPending_.store(true);
+        }
+        cv_.notify_all();
+        thread_.join();
+    }
+    std::lock_guard<std::mutex> lk(m_);
+    quit_ = false;
+    queue_.clear();
+    cancels_.clear();
+    cancelPending_.store(false);
+    queued_.store(0);
+    Chunk c;
+    while (chunks_.pop(c)) {}
+    for (Pending& p : pending_) { p.done = true; p.reason = Reason_Cancelled; }   // reported by the next poll
+    if (state_.load() != LlmState_Error) state_.store(LlmState_Off);
+    active_.store(0);
+}
+
+uint32_t LlmWorker::submit(const std::string& prompt, int maxTokens, float temp){
+    uint32_t id;
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        const int st = state_.load();
+        if (!thread_.joinable() || st == LlmState_Off || st == LlmState_Error) return 0;
+        id = nextId_++;
+        queue_.push_back(Request{ id, prompt, std::max(1, maxTokens), temp });
+        queued_.store((int)queue_.size());
+    }
+    cv_.notify_one();
+    pending_.push_back(Pending{ id, std::string(), false, Reason_None });
+    return id;
+}
+
+void LlmWorker::cancel(uint32_t id){
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        cancels_.push_back(id);
+        cancelPending_.store(true);
+    }
+    cv_.notify_one();
+}
+
+bool LlmWorker::poll(uint32_t id, LlmUpdate& out){
+    Chunk c;
+    while (chunks_.pop(c))
+        for (Pending& p : pending_)
+            if (p.id == c.req) {
+                if (c.kind == Chunk_Text) p.text.append(c.text, c.len);
+                else { p.done = true; p.reason = c.reason; }
+                break;
+            }
+    out.text.clear();
+    out.done = false;
+    out.reason = "";
+    for (size_t i=0;i<pending_.size();++i) {
+        Pending& p = pending_[i];
+        if (p.id != id) continue;
+        out.text.swap(p.text);
+        out.done = p.done;
+        out.reason = kReasons[p.reason];
+        if (p.done) pending_.erase(pending_.begin() + (long)i);
+        return true;
+    }
+    return false;
+}
+
+LlmStats LlmWorker::stats() const {
+    LlmStats s;
+    s.state        = (LlmState)state_.load();
+    s.loadProgress = progress_.load();
+    s.loadMs       = loadMs_.load();
+    s.requests     = requests_.load();
+    s.tokens       = tokens_.load();
+    s.queued       = queued_.load();
+    s.active       = active_.load();
+    s.ttftMs       = ttftMs_.load();
+    s.tokPerSec    = tokPerSec_.load();
+    return s;
+}
+
+std::string LlmWorker::error() const { std::lock_guard<std::mutex> lk(m_); return error_; }
+std::string LlmWorker::model() const { std::lock_guard<std::mutex> lk(m_); return model_; }
+
+/*──────────────────── Worker thread ───────────────────*/
+// A full queue means the UI is not polling: wait for it rather than drop
+// text. Only quitting gives up.
+bool LlmWorker::pushChunk(const Chunk& c){
+    while (!chunks_.push(c)) {
+        std::unique_lock<std::mutex> lk(m_);
+        if (cv_.wait_for(lk, std::chrono::milliseconds(2), [this]{ return quit_; })) return false;
+    }
+    gFrameSched.request(1);                                // an idle loop would not show it otherwise
+    return true;
+}
+
+// Complete characters only, split into chunks on character boundaries.
+void LlmWorker::emitText(uint32_t id, const char* s, size_t n){
+    Chunk c{};
+    c.req = id;
+    c.kind = Chunk_Text;
+    while (n > 0) {
+        size_t k = std::min(n, sizeof(c.text));
+        if (k < n) while (k > 1 && ((unsigned char)s[k] & 0xC0) == 0x80) --k;
+        std::memcpy(c.text, s, k);
+        c.len = (uint8_t)k;
+        if (!pushChunk(c)) return;
+        s += k; n -= k;
+    }
+}
+
+void LlmWorker::emitDone(uint32_t id, uint8_t reason){
+    Chunk c{};
+    c.req = id;
+    c.kind = Chunk_Done;
+    c.reason = reason;
+    pushChunk(c);
+}
+
+bool LlmWorker::cancelled(uint32_t id){
+    if (!cancelPending_.load(std::memory_order_acquire)) return false;   // the per-token fast path
+    std::vector<uint32_t> dropped;
+    bool hit = false;
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        for (uint32_t c : cancels_) {
+            if (c == 0 || (id && c == id)) hit = true;
+            for (auto it = queue_.begin(); it != queue_.end(); )
+                if (c == 0 || it->id == c) { dropped.push_back(it->id); it = queue_.erase(it); }
+                else ++it;
+        }
+        cancels_.clear();
+        cancelPending_.store(false);
+        queued_.store((int)queue_.size());
+    }
+    for (uint32_t d : dropped) emitDone(d, Reason_Cancelled);   // outside m_: may wait for the UI
+    return hit;
+}
+
+bool LlmWorker::takeRequest(Request& r){
+    for (;;) {
+        cancelled(0);
+        std::unique_lock<std::mutex> lk(m_);
+        cv_.wait(lk, [this]{ return quit_ || !queue_.empty() || cancelPending_.load(); });
+        if (quit_) return false;
+        if (cancelPending_.load()) continue;
+        r = std::move(queue_.front());
+        queue_.pop_front();
+        queued_.store((int)queue_.size());
+        return true;
+    }
+}
+
+void LlmWorker::setError(const std::string& e){
+    std::fprintf(stderr, "[llm] %s\n", e.c_str());
+    std::vector<uint32_t> dropped;
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        error_ = e;
+        state_.store(LlmState_Error);
+        for (const Request& r : queue_) dropped.push_back(r.id);
+        queue_.clear();
+        queued_.store(0);
+    }
+    gFrameSched.request(1);
+    for (uint32_t d : dropped) emitDone(d, Reason_Error);
+}
+
+void LlmWorker::run(std::string path, LlmOptions opt){
+#if SINE_LLM
+    static std::once_flag backendOnce;
+    std::call_once(backendOnce, []{ llama_log_set(quietLog, nullptr); llama_backend_init(); });
+
+    const Clock::time_point t0 = Clock::now();
+    llama_model_params mp = llama_model_default_params();
+    mp.n_gpu_layers = opt.gpuLayers;
+    mp.use_mmap     = true;                                // weights are paged in on first use, not read up front
+    mp.progress_callback = [](float p, void* user){
+        auto* self = static_cast<LlmWorker*>(user);
+        self->progress_.store(p);
+        gFrameSched.request(1);
+        std::lock_guard<std::mutex> lk(self->m_);
+        return !self->quit_;                               // false aborts the load
+    };
+    mp.progress_callback_user_data = this;
+    llama_model* model = llama_model_load_from_file(path.c_str(), mp);
+    if (!model) {
+        std::unique_lock<std::mutex> lk(m_);
+        if (quit_) return;
+        lk.unlock();
+        setError("cannot load " + path);
+        return;
+    }
+
+    const int hw = (int)std::thread::hardware_concurrency();
+    llama_context_params cp = llama_context_default_params();
+    cp.n_ctx           = (uint32_t)std::max(256, opt.nCtx);
+    cp.n_batch         = 512;
+    cp.n_threads       = opt.threads > 0 ? opt.threads : std::max(1, hw - 2);   // leave the UI and audio a core each
+    cp.n_threads_batch = cp.n_threads;
+    llama_context* ctx = llama_init_from_model(model, cp);
+    if (!ctx) { llama_model_free(model); setError("cannot create a context for " + path); return; }
+    loadMs_.store(msSince(t0));
+    progress_.store(1.0f);
+    state_.store(LlmState_Ready);
+    gFrameSched.request(1);
+
+    const llama_vocab* vocab = llama_model_get_vocab(model);
+    const int nCtx = (int)llama_n_ctx(ctx), nBatch = (int)cp.n_batch;
+    llama_batch batch = llama_batch_init(nBatch, 0, 1);
+    auto decode = [&](const llama_token* toks, int n, int pos0){
+        for (int i=0;i<n;++i) {
+            batch.token[i] = toks[i]; batch.pos[i] = pos0 + i;
+            batch.seq_id[i][0] = 0; batch.n_seq_id[i] = 1; batch.logits[i] = i == n - 1;
+        }
+        batch.n_tokens = n;
+        return llama_decode(ctx, batch) == 0;
+    };
+
+    std::vector<llama_token> toks;
+    std::string text;
+    Request r;
+    while (takeRequest(r)) {
+        state_.store(LlmState_Busy);
+        active_.store(r.id);
+        requests_.fetch_add(1);
+        const Clock::time_point tr = Clock::now();
+        uint8_t reason = Reason_Error;
+        llama_memory_clear(llama_get_memory(ctx), true);
+        bool ok = tokenize(vocab, r.prompt, toks) && (int)toks.size() < nCtx;
+        int nPast = 0;
+        for (int i=0; ok && i<(int)toks.size(); i += nBatch) {   // prompt, in batches; cancel between them
+            if (cancelled(r.id)) { reason = Reason_Cancelled; ok = false; break; }
+            const int n = std::min(nBatch, (int)toks.size() - i);
+            ok = decode(toks.data() + i, n, nPast);
+            nPast += n;
+        }
+        if (ok) {
+            llama_sampler* smpl = llama_sampler_chain_init(llama_sampler_chain_default_params());
+            if (r.temp <= 0.0f) llama_sampler_chain_add(smpl, llama_sampler_init_greedy());
+            else {
+                llama_sampler_chain_add(smpl, llama_sampler_init_top_p(0.9f, 1));
+                llama_sampler_chain_add(smpl, llama_sampler_init_temp(r.temp));
+                llama_sampler_chain_add(smpl, llama_sampler_init_dist(LLAMA_DEFAULT_SEED));
+            }
+            text.clear();
+            Clock::time_point tFirst = tr;
+            int n = 0;
+            reason = Reason_Length;
+            for (; n < r.maxTokens; ++n) {
+                const llama_token id = llama_sampler_sample(smpl, ctx, -1);
+                if (n == 0) { tFirst = Clock::now(); ttftMs_.store(msSince(tr)); }
+                if (llama_vocab_is_eog(vocab, id)) { reason = Reason_Eos; break; }
+                char piece[256];
+                const int w = llama_token_to_piece(vocab, id, piece, (int)sizeof(piece), 0, false);
+                if (w > 0) text.append(piece, (size_t)w);
+                const size_t ready = text.size() - utf8IncompleteTail(text);
+                if (ready) { emitText(r.id, text.data(), ready); text.erase(0, ready); }
+                tokens_.fetch_add(1);
+                if (cancelled(r.id)) { reason = Reason_Cancelled; break; }
+                if (nPast >= nCtx) break;
+                if (!decode(&id, 1, nPast++)) { reason = Reason_Error; break; }
+            }
+            if (!text.empty()) emitText(r.id, text.data(), text.size());
+            const double s = msSince(tFirst) * 1e-3;
+            tokPerSec_.store(n > 1 && s > 0.0 ? (n - 1) / s : 0.0);
+            llama_sampler_free(smpl);
+        }
+        emitDone(r.id, reason);
+        active_.store(0);
+        state_.store(LlmState_Ready);
+    }
+
+    llama_batch_free(batch);
+    llama_free(ctx);
+    llama_model_free(model);
+#else
+    (void)path; (void)opt;
+    setError("built without llama.cpp");
+#endif
+}
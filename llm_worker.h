@@ -0,0 +1,117 @@
+#pragma once
+// LLM inference for the UI, on its own thread.
+//
+// The worker thread owns the llama.cpp model and context; nothing else ever
+// touches them. load() only hands the path to that thread, so the model
+// (memory-mapped: pages come in as they are first used) loads while frames
+// keep rendering. Prompts go in through a short mutex-guarded queue: submit
+// and cancel are rare. Generated text comes back as fixed-size chunks
+// through an SpscQueue that the Lua thread drains in poll(), without locks.
+// A frame with no new tokens does not allocate.
+//
+// Requests run one at a time, in order. The worker leaves two cores to the
+// render and audio threads unless told otherwise.
+//
+// Built without llama.cpp (SINE_LLM=0, CMake -DSINE_DEMO_LLM=OFF) every call
+// still works: load() fails with "built without llama.cpp".
+
+#include "spsc_queue.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef SINE_LLM
+#define SINE_LLM 0
+#endif
+
+enum LlmState : int { LlmState_Off, LlmState_Loading, LlmState_Ready, LlmState_Busy, LlmState_Error };
+
+struct LlmOptions {
+    int nCtx      = 2048;
+    int threads   = 0;          // 0: hardware threads - 2
+    int gpuLayers = 0;
+};
+
+struct LlmStats {
+    LlmState state = LlmState_Off;
+    float    loadProgress = 0.0f;   // 0..1 while loading
+    double   loadMs = 0.0;
+    uint64_t requests = 0, tokens = 0;
+    int      queued = 0;            // waiting behind the running request
+    uint32_t active = 0;            // id of the running request, 0 = none
+    double   ttftMs = 0.0, tokPerSec = 0.0;   // of the last request
+};
+
+// What poll() hands back for one request.
+struct LlmUpdate {
+    std::string text;               // appended since the last poll
+    bool        done = false;
+    const char* reason = "";        // when done: "eos", "length", "cancelled", "error"
+};
+
+class LlmWorker {
+public:
+    LlmWorker() = default;
+    ~LlmWorker();
+    LlmWorker(const LlmWorker&) = delete;
+    LlmWorker& operator=(const LlmWorker&) = delete;
+
+    // Starts loading in the background (any model already loaded is unloaded first).
+    bool load(const std::string& modelPath, const LlmOptions& opt = LlmOptions(), std::string* err = nullptr);
+    void unload();                                         // cancels everything and joins the thread
+
+    // Lua thread. submit returns the request id (0 if no model is loaded or loading).
+    uint32_t submit(const std::string& prompt, int maxTokens = 256, float temp = 0.8f);
+    void     cancel(uint32_t id = 0);                      // 0: every request
+    // Drains the chunk queue; false if id is unknown or its end was already reported.
+    bool     poll(uint32_t id, LlmUpdate& out);
+
+    LlmStats    stats() const;
+    std::string error() const;
+    std::string model() const;
+
+private:
+    enum ChunkKind : uint8_t { Chunk_Text, Chunk_Done };
+    struct Chunk {
+        uint32_t  req;
+        ChunkKind kind;
+        uint8_t   len;                                     // Chunk_Text: bytes in text
+        uint8_t   reason;                                  // Chunk_Done: index into kReasons
+        char      text[57];
+    };
+    struct Request { uint32_t id; std::string prompt; int maxTokens; float temp; };
+    struct Pending { uint32_t id; std::string text; bool done; uint8_t reason; };
+
+    void run(std::string path, LlmOptions opt);
+    void emitText(uint32_t id, const char* s, size_t n);
+    void emitDone(uint32_t id, uint8_t reason);
+    bool pushChunk(const Chunk& c);
+    bool takeRequest(Request& r);                          // blocks; false when quitting
+    bool cancelled(uint32_t id);                           // also drops cancelled queued requests
+    void setError(const std::string& e);
+
+    std::thread thread_;
+    mutable std::mutex m_;                                 // everything below up to the atomics
+    std::condition_variable cv_;
+    std::deque<Request> queue_;
+    std::vector<uint32_t> cancels_;                        // ids (0 = all) not yet seen by the worker
+    bool quit_ = false;
+    std::string error_, model_;
+    uint32_t nextId_ = 1;
+
+    SpscQueue<Chunk, 1024> chunks_;                        // worker -> Lua thread
+    std::vector<Pending> pending_;                         // Lua thread only: submitted, end not reported
+
+    std::atomic<bool>     cancelPending_{false};           // cancels_ non-empty: lets the worker skip m_ per token
+    std::atomic<int>      state_{LlmState_Off}, queued_{0};
+    std::atomic<float>    progress_{0.0f};
+    std::atomic<uint32_t> active_{0};
+    std::atomic<uint64_t> requests_{0}, tokens_{0};
+    std::atomic<double>   loadMs_{0.0}, ttftMs_{0.0}, tokPerSec_{0.0};
+};
@@ -0,0 +1,649 @@
+#ifndef IMGUI_DEFINE_MATH_OPERATORS
+#define IMGUI_DEFINE_MATH_OPERATORS
+#endif
+#include "lua_bindings.h"
+#include "app_state.h"
+#include "demo_api.h"
+#include "dsp_editor.h"
+#include "alloc_hooks.h"
+#include "frame_sched.h"
+#include "profiler.h"
+#include "render_targets.h"
+#include "torus.h"
+#include "ui_thread.h"
+
+#include "imgui.h"
+#include "imgui-knobs.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <lauxlib.h>
+#include <lualib.h>
+}
+
+/*──────────── Interned enum names ───────────*/
+// String arguments for enum-like parameters ("Tick", "wiper_only", "saw") are
+// resolved through a string-keyed table in the registry. Lua strings are
+// interned, so a hit is a pointer hash with no allocation and no case folding.
+// A new spelling is matched case-insensitively once and then cached.
+struct EnumName { const char* name; int value; };
+
+// only variants present in your imgui-knobs:
+static const EnumName kKnobNames[] = {
+    {"tick", ImGuiKnobVariant_Tick}, {"dot", ImGuiKnobVariant_Dot}, {"wiper", ImGuiKnobVariant_Wiper},
+    {"wiperonly", ImGuiKnobVariant_WiperOnly}, {"wiper_only", ImGuiKnobVariant_WiperOnly},
+    {"wiperdot", ImGuiKnobVariant_WiperDot},   {"wiper_dot", ImGuiKnobVariant_WiperDot},
+    {"stepped", ImGuiKnobVariant_Stepped}, {"space", ImGuiKnobVariant_Space},
+    {nullptr, 0}
+};
+static const EnumName kWaveNames[] = {
+    {"sine", OscWave_Sine}, {"saw", OscWave_Saw}, {"square", OscWave_Square},
+    {"triangle", OscWave_Triangle}, {"tri", OscWave_Triangle},
+    {nullptr, 0}
+};
+
+static const EnumName kNodeNames[] = {
+    {"osc", DspNode_Osc}, {"gain", DspNode_Gain}, {"filter", DspNode_Filter}, {"svf", DspNode_Filter},
+    {"mixer", DspNode_Mixer}, {"mix", DspNode_Mixer}, {"env", DspNode_Env}, {"adsr", DspNode_Env},
+    {"output", DspNode_Output}, {"out", DspNode_Output},
+    {nullptr, 0}
+};
+static const EnumName kFilterModeNames[] = {
+    {"lowpass", 0}, {"lp", 0}, {"bandpass", 1}, {"bp", 1}, {"highpass", 2}, {"hp", 2},
+    {nullptr, 0}
+};
+static const EnumName kAudioParamNames[] = {
+    {"freq", AudioParam_Freq}, {"amp", AudioParam_Amp},
+    {nullptr, 0}
+};
+
+static bool iequals(const char* a, const char* b){
+    for (; *a && *b; ++a, ++b)
+        if (std::tolower((unsigned char)*a) != std::tolower((unsigned char)*b)) return false;
+    return *a == *b;
+}
+
+static void push_enum_cache(lua_State* L, const EnumName* names){
+    lua_pushlightuserdata(L, (void*)names);
+    lua_newtable(L);
+    for (const EnumName* n = names; n->name; ++n) { lua_pushinteger(L, n->value); lua_setfield(L, -2, n->name); }
+    lua_rawset(L, LUA_REGISTRYINDEX);
+}
+
+static int enum_from_lua(lua_State* L, int idx, const EnumName* names, int def){
+    const int t = lua_type(L, idx);
+    if (t == LUA_TNUMBER) return (int)lua_tointeger(L, idx);
+    if (t != LUA_TSTRING) return def;
+    lua_pushlightuserdata(L, (void*)names);
+    lua_rawget(L, LUA_REGISTRYINDEX);
+    lua_pushvalue(L, idx); lua_rawget(L, -2);
+    int v = def;
+    if (lua_type(L, -1) == LUA_TNUMBER) v = (int)lua_tointeger(L, -1);
+    else {
+        const char* s = lua_tostring(L, idx);
+        for (const EnumName* n = names; n->name; ++n)
+            if (iequals(s, n->name)) {
+                v = n->value;
+                lua_pushvalue(L, idx); lua_pushinteger(L, v); lua_rawset(L, -4);
+                break;
+            }
+    }
+    lua_pop(L, 2);
+    return v;
+}
+
+static ImGuiKnobVariant knob_variant_from_lua(lua_State* L, int idx){
+    return (ImGuiKnobVariant)enum_from_lua(L, idx, kKnobNames, ImGuiKnobVariant_Tick);
+}
+static OscWave osc_wave_from_lua(lua_State* L, int idx){
+    return (OscWave)std::clamp(enum_from_lua(L, idx, kWaveNames, OscWave_Sine), 0, OscWave_COUNT-1);
+}
+
+/*──────────── Lua bindings ───────────*/
+// knob_float_full(label, val, min, max [, speed [, format [, variant [, size [, flags [, steps [, angle_min [, angle_max ]]]]]]]])
+static int lua_knob_float_full(lua_State* L){
+    const char* label = luaL_checkstring(L, 1);
+    float v          = (float)luaL_checknumber(L, 2);
+    float vmin       = (float)luaL_checknumber(L, 3);
+    float vmax       = (float)luaL_checknumber(L, 4);
+    float speed      = (float)luaL_optnumber (L, 5, 0.01f);
+    const char* fmt  = luaL_optstring(L, 6, "%.3f");
+    ImGuiKnobVariant variant = knob_variant_from_lua(L, 7);
+    float size       = (float)luaL_optnumber (L, 8, 0.0f);
+    int flags        = (int)  luaL_optinteger(L, 9, 0);
+    int steps        = (int)  luaL_optinteger(L,10, 0);
+    float angle_min  = (float)luaL_optnumber (L,11, 0.0f);
+    float angle_max  = (float)luaL_optnumber (L,12, 6.28318530718f);
+
+    lua_pushnumber(L, demo_knob_float(label, v, vmin, vmax, speed, fmt, (int)variant, size, flags, steps, angle_min, angle_max));
+    return 1;
+}
+
+// window/layout helpers
+static int lua_begin(lua_State* L){ demo_begin(luaL_checkstring(L,1)); return 0; }
+static int lua_end  (lua_State* L){ demo_end(); return 0; }
+static int lua_set_next_window_size(lua_State* L){
+    float w=(float)luaL_checknumber(L,1), h=(float)luaL_checknumber(L,2);
+    int cond=(int)luaL_optinteger(L,3,ImGuiCond_FirstUseEver);
+    demo_set_next_window_size(w, h, cond); return 0;
+}
+static int lua_separator(lua_State* L){ demo_separator(); return 0; }
+static int lua_spacing(lua_State* L){ demo_spacing(); return 0; }
+static int lua_begin_table(lua_State* L){
+    const char* id = luaL_checkstring(L,1); int cols=(int)luaL_checkinteger(L,2);
+    lua_pushboolean(L, demo_begin_table(id, cols)); return 1;
+}
+static int lua_table_next_column(lua_State* L){ demo_table_next_column(); return 0; }
+static int lua_end_table(lua_State* L){ demo_end_table(); return 0; }
+static int lua_text(lua_State* L){ demo_text(luaL_checkstring(L,1)); return 0; }
+
+// Textf(fmt, ...) — string.format into a stack buffer, so no Lua string is
+// created. Supports %d %i %u %x %X %o %f %F %e %E %g %G %s %% with flags,
+// width and precision.
+static int lua_textf(lua_State* L){
+    const char* p = luaL_checkstring(L,1);
+    char out[512]; size_t n = 0; int arg = 2;
+    while (*p && n < sizeof(out)-1) {
+        if (*p != '%') { out[n++] = *p++; continue; }
+        if (p[1] == '%') { out[n++] = '%'; p += 2; continue; }
+        char spec[24]; size_t k = 0;
+        spec[k++] = *p++;
+        while (*p && std::strchr("-+ #0123456789.", *p) && k < sizeof(spec)-4) spec[k++] = *p++;
+        const char conv = *p ? *p++ : 0;
+        const size_t room = sizeof(out) - n;
+        int w = 0;
+        switch (conv) {
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+            spec[k++] = 'l'; spec[k++] = 'l'; spec[k++] = conv; spec[k] = 0;
+            w = std::snprintf(out+n, room, spec, (long long)luaL_checknumber(L, arg++)); break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G':
+            spec[k++] = conv; spec[k] = 0;
+            w = std::snprintf(out+n, room, spec, (double)luaL_checknumber(L, arg++)); break;
+        case 's':
+            spec[k++] = conv; spec[k] = 0;
+            if (lua_type(L, arg) == LUA_TSTRING) w = std::snprintf(out+n, room, spec, lua_tostring(L, arg));
+            else { char num[32]; std::snprintf(num, sizeof(num), "%.14g", (double)luaL_checknumber(L, arg));
+                   w = std::snprintf(out+n, room, spec, num); }
+            ++arg; break;
+        default:
+            return luaL_error(L, "Textf: unsupported conversion '%%%c'", conv ? conv : '?');
+        }
+        if (w > 0) n += std::min((size_t)w, room - 1);
+    }
+    out[n] = 0;
+    demo_text(out);
+    return 0;
+}
+static int lua_same_line(lua_State* L){ demo_same_line(); return 0; }
+static int lua_button(lua_State* L){ lua_pushboolean(L, demo_button(luaL_checkstring(L,1))); return 1; }
+
+// scope(window_ms [, height [, trigger [, yrange]]]) — what the audio callback actually played
+static int lua_scope(lua_State* L){
+    float ms   = (float)luaL_optnumber(L,1,20.0);
+    float h    = (float)luaL_optnumber(L,2,120.0);
+    int   trig = lua_isnoneornil(L,3) ? 1 : lua_toboolean(L,3);
+    float yr   = (float)luaL_optnumber(L,4,1.0);
+    lua_pushinteger(L, demo_scope(ms, h, trig, yr));
+    return 1;
+}
+
+// plot_sine(amp, freq [, samples]) — compatibility wrapper: now a triggered
+// scope of the last `samples` output samples (amp/freq are no longer needed).
+static int lua_plot_sine(lua_State* L){
+    float amp = (float)luaL_checknumber(L,1), f = (float)luaL_checknumber(L,2);
+    demo_plot_sine(amp, f, (int)luaL_optinteger(L,3,512));
+    return 0;
+}
+
+// audio controls
+static int lua_audio_set_freq(lua_State* L){ demo_audio_set_freq((float)luaL_checknumber(L,1)); return 0; }
+static int lua_audio_set_amp (lua_State* L){ demo_audio_set_amp ((float)luaL_checknumber(L,1)); return 0; }
+
+// voice_on(id, freq [, amp [, wave]]) -> queued
+static int lua_voice_on(lua_State* L){
+    int   id   = (int)  luaL_checkinteger(L,1);
+    float freq = (float)luaL_checknumber (L,2);
+    float amp  = (float)luaL_optnumber  (L,3,0.1);
+    lua_pushboolean(L, demo_voice_on(id, freq, amp, (int)osc_wave_from_lua(L,4)));
+    return 1;
+}
+static int lua_voice_off(lua_State* L){ lua_pushboolean(L, demo_voice_off((int)luaL_checkinteger(L,1))); return 1; }
+static int lua_voice_all_off(lua_State* L){ lua_pushboolean(L, gAudio.allVoicesOff()); return 1; }
+static int lua_audio_voices(lua_State* L){ lua_pushinteger(L, gAudio.activeVoices()); return 1; }
+
+// Result tables: fill the caller's table when one is passed so a per-frame
+// poll does not create garbage; otherwise return a fresh one.
+static void push_result_table(lua_State* L, int idx, int fields){
+    if (lua_istable(L, idx)) lua_pushvalue(L, idx);
+    else                     lua_createtable(L, 0, fields);
+}
+
+// audio_stats([t]) -> { callbacks, xruns, late, load, load_avg, load_peak, p50_us, p99_us, ... }
+static int lua_audio_stats(lua_State* L){
+    AudioStatsSnapshot s; gAudioStats.snapshot(s);
+    push_result_table(L, 1, 18);
+    #define SF(name, v) lua_pushnumber(L, (lua_Number)(v)); lua_setfield(L, -2, name)
+    SF("callbacks",         s.callbacks);
+    SF("xruns",             s.inUnderflow + s.inOverflow + s.outUnderflow + s.outOverflow);
+    SF("input_underflows",  s.inUnderflow);  SF("input_overflows",  s.inOverflow);
+    SF("output_underflows", s.outUnderflow); SF("output_overflows", s.outOverflow);
+    SF("priming",           s.priming);
+    SF("late",              s.late);
+    SF("load",              s.load);  SF("load_avg", s.loadAvg); SF("load_peak", s.loadPeak);
+    SF("deadline_us",       s.deadlineUs); SF("last_us", s.lastUs);
+    SF("p50_us",            s.p50Us); SF("p99_us", s.p99Us); SF("p999_us", s.p999Us); SF("max_us", s.maxUs);
+    SF("latency_ms",        s.latencyMs);
+    SF("since_last_ms",     s.sinceLastCallbackMs);
+    #undef SF
+    return 1;
+}
+static int lua_audio_stats_reset(lua_State* L){ gAudioStats.resetView(); return 0; }
+
+// request_frames([n]) — keep rendering for the next n frames (animations driven from Lua)
+static int lua_request_frames(lua_State* L){ gFrameSched.request((int)luaL_optinteger(L,1,1)); return 0; }
+// set_target_fps(fps) — paced rate instead of vsync (0 = vsync); set_idle_fps(fps) — 0 = events only
+static int lua_set_target_fps(lua_State* L){ gFrameSched.setTargetFps(luaL_checknumber(L,1)); return 0; }
+static int lua_set_idle_fps(lua_State* L){ gFrameSched.setIdleFps(luaL_checknumber(L,1)); return 0; }
+// loop_stats([t]) -> { fps, cpu_ms_per_s, idle_fraction, frames, idle }
+static int lua_loop_stats(lua_State* L){
+    const UiRecorder* rec = UiRecorder::current();
+    const LoopStats s = rec ? rec->snapshot().loop : gFrameSched.stats();
+    push_result_table(L, 1, 5);
+    lua_pushnumber(L, s.fps);                  lua_setfield(L, -2, "fps");
+    lua_pushnumber(L, s.cpuMsPerSec);          lua_setfield(L, -2, "cpu_ms_per_s");
+    lua_pushnumber(L, s.idleFraction);         lua_setfield(L, -2, "idle_fraction");
+    lua_pushnumber(L, (lua_Number)s.frames);   lua_setfield(L, -2, "frames");
+    lua_pushboolean(L, s.idle);                lua_setfield(L, -2, "idle");
+    return 1;
+}
+
+// prof_begin(name) / prof_end() — Lua zones nested under draw_ui in the profiler
+// (the profiler belongs to the render thread; ignored on the Lua worker)
+static int lua_prof_begin(lua_State* L){ if (!UiRecorder::current()) profBegin(luaL_checkstring(L,1)); return 0; }
+static int lua_prof_end(lua_State* L){ if (!UiRecorder::current()) profEnd(); return 0; }
+// profiler_window() — frame graph, timeline and zone table (no-op when compiled out)
+static int lua_profiler_window(lua_State* L){
+    if (UiRecorder* rec = UiRecorder::current()) rec->simple(UiOp_ProfilerWindow);
+    else profilerWindow();
+    return 0;
+}
+
+// ui_thread_stats([t]) -> { enabled, lua_ms, replay_ms, cmds, kb }
+static int lua_ui_thread_stats(lua_State* L){
+    const UiThreadStats s = gLuaWorker.stats();
+    push_result_table(L, 1, 5);
+    lua_pushboolean(L, s.enabled);                    lua_setfield(L, -2, "enabled");
+    lua_pushnumber(L, s.luaMs);                       lua_setfield(L, -2, "lua_ms");
+    lua_pushnumber(L, s.replayMs);                    lua_setfield(L, -2, "replay_ms");
+    lua_pushnumber(L, s.cmds);                        lua_setfield(L, -2, "cmds");
+    lua_pushnumber(L, (lua_Number)s.bytes / 1024.0);  lua_setfield(L, -2, "kb");
+    return 1;
+}
+
+// alloc_stats([t]) -> allocations made during the last completed frame
+static int lua_alloc_stats(lua_State* L){
+    const UiRecorder* rec = UiRecorder::current();
+    const AllocCounters c = rec ? rec->snapshot().allocs : allocLastFrame();
+    push_result_table(L, 1, 4);
+    lua_pushnumber(L, (lua_Number)c.luaAllocs);   lua_setfield(L, -2, "lua_allocs");
+    lua_pushnumber(L, (lua_Number)c.luaHeap);     lua_setfield(L, -2, "lua_heap");
+    lua_pushnumber(L, (lua_Number)c.imguiAllocs); lua_setfield(L, -2, "imgui_allocs");
+    lua_pushnumber(L, (lua_Number)c.luaBytes / 1024.0); lua_setfield(L, -2, "lua_kb");
+    return 1;
+}
+
+// plot_audio_load([height]) — recent per-callback load (1.0 = deadline)
+static int lua_plot_audio_load(lua_State* L){ demo_plot_audio_load((float)luaL_optnumber(L,1,80.0)); return 0; }
+
+/*──────────── DSP graph ───────────*/
+// graph_add(type) -> id | nil   ("osc", "gain", "filter", "mixer", "env", "output")
+static int lua_graph_add(lua_State* L){
+    const int t = enum_from_lua(L, 1, kNodeNames, -1);
+    const int id = (t >= 0 && t < DspNode_COUNT) ? gDspGraph.add((DspNodeType)t) : -1;
+    if (id < 0) lua_pushnil(L); else lua_pushinteger(L, id);
+    return 1;
+}
+static int lua_graph_remove(lua_State* L){ lua_pushboolean(L, gDspGraph.remove((int32_t)luaL_checkinteger(L,1))); return 1; }
+static int lua_graph_clear(lua_State* L){ gDspGraph.clear(); return 0; }
+// graph_connect(src, dst [, port]) -> ok   (port from 0; default: first free)
+static int lua_graph_connect(lua_State* L){
+    lua_pushboolean(L, gDspGraph.connect((int32_t)luaL_checkinteger(L,1), (int32_t)luaL_checkinteger(L,2),
+                                         (int)luaL_optinteger(L,3,-1)));
+    return 1;
+}
+static int lua_graph_disconnect(lua_State* L){
+    lua_pushboolean(L, gDspGraph.disconnect((int32_t)luaL_checkinteger(L,1), (int32_t)luaL_checkinteger(L,2)));
+    return 1;
+}
+// graph_set(id, param, value) -> ok   (param by name or index; wave/mode accept names)
+static int lua_graph_set(lua_State* L){
+    const int32_t id = (int32_t)luaL_checkinteger(L,1);
+    const int type = gDspGraph.typeOf(id);
+    if (type < 0) { lua_pushboolean(L, 0); return 1; }
+    const int param = lua_type(L,2) == LUA_TSTRING ? dspParamIndex((DspNodeType)type, lua_tostring(L,2))
+                                                   : (int)luaL_checkinteger(L,2);
+    float v;
+    if (lua_type(L,3) == LUA_TSTRING && type == DspNode_Osc)    v = (float)osc_wave_from_lua(L,3);
+    else if (lua_type(L,3) == LUA_TSTRING && type == DspNode_Filter) v = (float)enum_from_lua(L,3,kFilterModeNames,0);
+    else if (lua_isboolean(L,3))                                 v = lua_toboolean(L,3) ? 1.0f : 0.0f;   // gate
+    else                                                         v = (float)luaL_checknumber(L,3);
+    lua_pushboolean(L, gDspGraph.set(id, param, v));
+    return 1;
+}
+// graph_commit() -> true | false, err   (on failure the running graph keeps playing)
+static int lua_graph_commit(lua_State* L){
+    std::string err;
+    if (gDspGraph.commit(&err)) { lua_pushboolean(L, 1); return 1; }
+    lua_pushboolean(L, 0); lua_pushstring(L, err.c_str());
+    return 2;
+}
+// graph_stats([t]) -> { nodes, ops, buffers, commits }
+static int lua_graph_stats(lua_State* L){
+    const DspStats s = gDspGraph.stats();
+    push_result_table(L, 1, 4);
+    lua_pushnumber(L, s.nodes);                  lua_setfield(L, -2, "nodes");
+    lua_pushnumber(L, s.ops);                    lua_setfield(L, -2, "ops");
+    lua_pushnumber(L, s.buffers);                lua_setfield(L, -2, "buffers");
+    lua_pushnumber(L, (lua_Number)s.commits);    lua_setfield(L, -2, "commits");
+    return 1;
+}
+// graph_editor() — node list, wiring and parameters
+static int lua_graph_editor(lua_State* L){
+    if (UiRecorder* rec = UiRecorder::current()) rec->simple(UiOp_GraphEditor);
+    else dspGraphEditor(gDspGraph);
+    return 0;
+}
+
+/*──────────── MIDI ───────────*/
+// midi_ports() -> { name, ... }   (index from 0, as midi_open takes it)
+static int lua_midi_ports(lua_State* L){
+    const std::vector<std::string> names = gMidi.ports();
+    lua_createtable(L, (int)names.size(), 0);
+    for (size_t i=0;i<names.size();++i) { lua_pushstring(L, names[i].c_str()); lua_rawseti(L, -2, (int)i + 1); }
+    return 1;
+}
+static int push_ok_err(lua_State* L, bool ok, const std::string& err){
+    lua_pushboolean(L, ok);
+    if (ok) return 1;
+    lua_pushstring(L, err.c_str());
+    return 2;
+}
+// midi_open(index | name_substring) -> true | false, err
+static int lua_midi_open(lua_State* L){
+    std::string err;
+    const bool ok = lua_type(L,1) == LUA_TNUMBER ? gMidi.openPort((int)lua_tointeger(L,1), &err)
+                                                 : gMidi.openPort(std::string(luaL_checkstring(L,1)), &err);
+    return push_ok_err(L, ok, err);
+}
+// midi_open_virtual([name]) -> true | false, err
+static int lua_midi_open_virtual(lua_State* L){
+    std::string err;
+    const bool ok = gMidi.openVirtual(luaL_optstring(L,1,"sine_demo"), &err);
+    return push_ok_err(L, ok, err);
+}
+// midi_play(path [, loop]) -> true | false, err   (Standard MIDI File, replayed in real time)
+static int lua_midi_play(lua_State* L){
+    std::string err;
+    const bool ok = gMidi.playFile(luaL_checkstring(L,1), lua_toboolean(L,2) != 0, &err);
+    return push_ok_err(L, ok, err);
+}
+static int lua_midi_close(lua_State* L){ gMidi.close(); return 0; }
+// midi_map(cc, "freq" | "amp" [, lo, hi]) or midi_map(cc, node_id, param [, lo, hi]) -> ok
+// CC 0..127 is scaled to lo..hi (default: the parameter's range).
+static int lua_midi_map(lua_State* L){
+    const int cc = (int)luaL_checkinteger(L,1);
+    bool ok = false;
+    if (lua_type(L,2) == LUA_TNUMBER) {
+        const int32_t id = (int32_t)lua_tointeger(L,2);
+        const int type = gDspGraph.typeOf(id);
+        const int param = type < 0 ? -1 : lua_type(L,3) == LUA_TSTRING ? dspParamIndex((DspNodeType)type, lua_tostring(L,3))
+                                                                       : (int)luaL_checkinteger(L,3);
+        if (param >= 0 && param < dspNodeInfo((DspNodeType)type).params) {
+            const DspNodeInfo& info = dspNodeInfo((DspNodeType)type);
+            ok = gAudio.mapCCGraph(cc, id, param, (float)luaL_optnumber(L,4,info.min[param]), (float)luaL_optnumber(L,5,info.max[param]));
+        }
+    } else {
+        const int p = enum_from_lua(L, 2, kAudioParamNames, -1);
+        if (p >= 0 && p < AudioParam_COUNT) {
+            static const float kLo[AudioParam_COUNT] = { 50.0f, 0.0f }, kHi[AudioParam_COUNT] = { 2000.0f, 1.0f };
+            ok = gAudio.mapCC(cc, (AudioParam)p, (float)luaL_optnumber(L,3,kLo[p]), (float)luaL_optnumber(L,4,kHi[p]));
+        }
+    }
+    lua_pushboolean(L, ok);
+    return 1;
+}
+// midi_unmap([cc])   (no argument: every CC)
+static int lua_midi_unmap(lua_State* L){ gAudio.unmapCC((int)luaL_optinteger(L,1,-1)); return 0; }
+// midi_voice(wave [, amp]) — waveform and full-velocity amplitude of MIDI notes
+static int lua_midi_voice(lua_State* L){
+    gAudio.setMidiVoice(osc_wave_from_lua(L,1), (float)luaL_optnumber(L,2,0.25));
+    return 0;
+}
+// midi_cc(n) -> last value 0..127 | nil
+static int lua_midi_cc(lua_State* L){
+    const int v = gMidi.cc((int)luaL_checkinteger(L,1));
+    if (v < 0) lua_pushnil(L); else lua_pushinteger(L, v);
+    return 1;
+}
+// midi_source() -> "port:<name>" | "virtual:<name>" | "file:<path>" | ""
+static int lua_midi_source(lua_State* L){ lua_pushstring(L, gMidi.source().c_str()); return 1; }
+// midi_stats([t]) -> { source = "port"|"virtual"|"file"|"", events, dropped, notes, last_cc, last_value, late, splits }
+static int lua_midi_stats(lua_State* L){
+    static const char* const kKinds[] = { "", "port", "virtual", "file" };
+    const MidiStats s = gMidi.stats();
+    const AudioMidiStats a = gAudio.midiStats();
+    push_result_table(L, 1, 8);
+    lua_pushstring(L, kKinds[s.kind]); lua_setfield(L, -2, "source");
+    #define SF(name, v) lua_pushnumber(L, (lua_Number)(v)); lua_setfield(L, -2, name)
+    SF("events", s.events); SF("dropped", s.dropped); SF("notes", s.notes);
+    SF("last_cc", s.lastCc); SF("last_value", s.lastValue);
+    SF("late", a.late); SF("splits", a.splits);
+    #undef SF
+    return 1;
+}
+
+/*──────────── LLM ───────────*/
+// The worker thread does all the inference; these only queue, cancel and
+// drain (see llm_worker.h), so they are safe to call every frame.
+// llm_load(path [, { ctx = 2048, threads = 0, gpu_layers = 0 }]) -> true | false, err   (returns before the model is loaded)
+static int lua_llm_load(lua_State* L){
+    LlmOptions opt;
+    if (lua_istable(L,2)) {
+        lua_getfield(L, 2, "ctx");        opt.nCtx      = (int)luaL_optinteger(L, -1, opt.nCtx);
+        lua_getfield(L, 2, "threads");    opt.threads   = (int)luaL_optinteger(L, -1, opt.threads);
+        lua_getfield(L, 2, "gpu_layers"); opt.gpuLayers = (int)luaL_optinteger(L, -1, opt.gpuLayers);
+        lua_pop(L, 3);
+    }
+    std::string err;
+    const bool ok = gLlm.load(luaL_checkstring(L,1), opt, &err);
+    return push_ok_err(L, ok, err);
+}
+static int lua_llm_unload(lua_State* L){ gLlm.unload(); return 0; }
+// llm_submit(prompt [, max_tokens [, temp]]) -> id | nil, err   (temp <= 0: greedy)
+static int lua_llm_submit(lua_State* L){
+    size_t n = 0;
+    const char* prompt = luaL_checklstring(L, 1, &n);
+    const uint32_t id = gLlm.submit(std::string(prompt, n), (int)luaL_optinteger(L,2,256), (float)luaL_optnumber(L,3,0.8));
+    if (id) { lua_pushinteger(L, id); return 1; }
+    lua_pushnil(L);
+    lua_pushstring(L, "no model loaded");
+    return 2;
+}
+// llm_cancel([id])   (no argument: every request)
+static int lua_llm_cancel(lua_State* L){ gLlm.cancel((uint32_t)luaL_optinteger(L,1,0)); return 0; }
+// llm_poll(id) -> new_text | nil, done, reason   (done is reported once; then the id is forgotten)
+static int lua_llm_poll(lua_State* L){
+    static LlmUpdate u;                        // keeps its buffer: no allocation on quiet frames
+    if (!gLlm.poll((uint32_t)luaL_checkinteger(L,1), u)) { lua_pushnil(L); lua_pushboolean(L, 1); lua_pushstring(L, "unknown"); return 3; }
+    if (u.text.empty()) lua_pushnil(L); else lua_pushlstring(L, u.text.data(), u.text.size());
+    lua_pushboolean(L, u.done);
+    lua_pushstring(L, u.reason);
+    return 3;
+}
+// llm_state() -> "off" | "loading" | "ready" | "busy" | "error" [, err]
+static int lua_llm_state(lua_State* L){
+    static const char* const kStates[] = { "off", "loading", "ready", "busy", "error" };
+    const LlmState st = gLlm.stats().state;
+    lua_pushstring(L, kStates[st]);
+    if (st != LlmState_Error) return 1;
+    lua_pushstring(L, gLlm.error().c_str());
+    return 2;
+}
+// llm_stats([t]) -> { progress, load_ms, requests, tokens, queued, active, ttft_ms, tok_s }
+static int lua_llm_stats(lua_State* L){
+    const LlmStats s = gLlm.stats();
+    push_result_table(L, 1, 8);
+    #define SF(name, v) lua_pushnumber(L, (lua_Number)(v)); lua_setfield(L, -2, name)
+    SF("progress", s.loadProgress); SF("load_ms", s.loadMs);
+    SF("requests", s.requests); SF("tokens", s.tokens);
+    SF("queued", s.queued); SF("active", s.active);
+    SF("ttft_ms", s.ttftMs); SF("tok_s", s.tokPerSec);
+    #undef SF
+    return 1;
+}
+
+// rainbow speed
+static int lua_gl_torus_rainbow_speed(lua_State* L){ demo_gl_torus_rainbow_speed((float)luaL_checknumber(L,1)); return 0; }
+
+// rt_budget_mb(mb) — VRAM budget of the render-target pool
+static int lua_rt_budget_mb(lua_State* L){
+    const double bytes = std::max(0.0, (double)luaL_checknumber(L,1)) * 1048576.0;
+    if (UiRecorder* rec = UiRecorder::current()) rec->value(UiOp_RtBudget, (float)bytes);
+    else gRenderTargets.setBudget((size_t)bytes);
+    return 0;
+}
+// rt_stats([t]) -> { targets, spares, mb, budget_mb, allocs, evictions, shrinks }
+static int lua_rt_stats(lua_State* L){
+    const UiRecorder* rec = UiRecorder::current();
+    const RenderTargetStats s = rec ? rec->snapshot().rt : gRenderTargets.stats();
+    push_result_table(L, 1, 7);
+    #define SF(name, v) lua_pushnumber(L, (lua_Number)(v)); lua_setfield(L, -2, name)
+    SF("targets", s.targets); SF("spares", s.spares);
+    SF("mb", (double)s.bytes / 1048576.0); SF("budget_mb", (double)s.budget / 1048576.0);
+    SF("allocs", s.allocs); SF("evictions", s.evictions); SF("shrinks", s.shrinks);
+    #undef SF
+    return 1;
+}
+
+// gl_torus_budget(ms) — render-cost budget for adaptive torus quality (0 = off)
+static int lua_gl_torus_budget(lua_State* L){
+    const float ms = (float)luaL_checknumber(L,1);
+    if (UiRecorder* rec = UiRecorder::current()) rec->value(UiOp_TorusBudget, ms);
+    else torusSetBudgetMs(ms);
+    return 0;
+}
+// gl_torus_quality() -> level (0 = full resolution and step count)
+static int lua_gl_torus_quality(lua_State* L){
+    const UiRecorder* rec = UiRecorder::current();
+    lua_pushinteger(L, rec ? rec->snapshot().torusQuality : torusQualityLevel());
+    return 1;
+}
+
+// gl_torus_cpu(on) — march the torus on the CPU (all cores) instead of the GPU
+static int lua_gl_torus_cpu(lua_State* L){
+    const bool on = lua_toboolean(L,1) != 0;
+    if (UiRecorder* rec = UiRecorder::current()) rec->value(UiOp_TorusCpu, on ? 1.0f : 0.0f);
+    else torusSetCpu(on);
+    return 0;
+}
+// gl_torus_cpu_stats([t]) -> { enabled, ms, threads, tiles, steals, isa }
+static int lua_gl_torus_cpu_stats(lua_State* L){
+    const UiRecorder* rec = UiRecorder::current();
+    const TorusCpuStats s = rec ? rec->snapshot().torusCpu : torusCpuStats();
+    push_result_table(L, 1, 6);
+    lua_pushboolean(L, s.enabled);                lua_setfield(L, -2, "enabled");
+    lua_pushnumber(L, s.ms);                      lua_setfield(L, -2, "ms");
+    lua_pushnumber(L, s.threads);                 lua_setfield(L, -2, "threads");
+    lua_pushnumber(L, s.tiles);                   lua_setfield(L, -2, "tiles");
+    lua_pushnumber(L, (lua_Number)s.steals);      lua_setfield(L, -2, "steals");
+    lua_pushstring(L, s.isa);                     lua_setfield(L, -2, "isa");
+    return 1;
+}
+
+// gl_torus([side [, yaw [, pitch [, R [, r [, id]]]]]]) — draw into the pooled
+// target for `id` and show it centered; side<0 => auto-fit (clamped 96..512)
+static int lua_gl_torus(lua_State* L){
+    int   side  = (int)luaL_optinteger(L,1,-1);
+    float yaw   = (float)luaL_optnumber (L,2,0.0f);
+    float pitch = (float)luaL_optnumber (L,3,0.0f);
+    float R     = (float)luaL_optnumber (L,4,0.75f);
+    float r     = (float)luaL_optnumber (L,5,0.25f);
+    demo_gl_torus(side, yaw, pitch, R, r, luaL_optstring(L,6,nullptr));
+    return 0;
+}
+
+static void push_knob_enums(lua_State* L){
+    lua_newtable(L);
+    #define KV(name) lua_pushinteger(L, (int)ImGuiKnobVariant_##name); lua_setfield(L, -2, #name)
+    KV(Tick); KV(Dot); KV(Wiper); KV(WiperOnly); KV(WiperDot); KV(Stepped); KV(Space);
+    #undef KV
+    lua_setglobal(L, "KnobVariant");
+
+    lua_newtable(L);
+    #define OW(name) lua_pushinteger(L, (int)OscWave_##name); lua_setfield(L, -2, #name)
+    OW(Sine); OW(Saw); OW(Square); OW(Triangle);
+    #undef OW
+    lua_setglobal(L, "OscWave");
+}
+
+void registerAllLua(lua_State* L){
+    luaL_Reg fns[] = {
+        {"Begin", lua_begin}, {"End", lua_end},
+        {"SetNextWindowSize", lua_set_next_window_size},
+        {"Separator", lua_separator}, {"Spacing", lua_spacing},
+        {"BeginTable", lua_begin_table}, {"TableNextColumn", lua_table_next_column}, {"EndTable", lua_end_table},
+        {"Button", lua_button}, {"Text", lua_text}, {"Textf", lua_textf}, {"SameLine", lua_same_line},
+        {"knob_float_full", lua_knob_float_full},
+        {"plot_sine", lua_plot_sine}, {"scope", lua_scope},
+        {"audio_set_freq", lua_audio_set_freq}, {"audio_set_amp", lua_audio_set_amp},
+        {"voice_on", lua_voice_on}, {"voice_off", lua_voice_off}, {"voice_all_off", lua_voice_all_off},
+        {"audio_voices", lua_audio_voices},
+        {"audio_stats", lua_audio_stats}, {"audio_stats_reset", lua_audio_stats_reset},
+        {"plot_audio_load", lua_plot_audio_load},
+        {"alloc_stats", lua_alloc_stats},
+        {"prof_begin", lua_prof_begin}, {"prof_end", lua_prof_end}, {"profiler_window", lua_profiler_window},
+        {"request_frames", lua_request_frames}, {"set_target_fps", lua_set_target_fps},
+        {"set_idle_fps", lua_set_idle_fps}, {"loop_stats", lua_loop_stats},
+        {"ui_thread_stats", lua_ui_thread_stats},
+        {"gl_torus", lua_gl_torus}, {"gl_torus_rainbow_speed", lua_gl_torus_rainbow_speed},
+        {"gl_torus_budget", lua_gl_torus_budget}, {"gl_torus_quality", lua_gl_torus_quality},
+        {"gl_torus_cpu", lua_gl_torus_cpu}, {"gl_torus_cpu_stats", lua_gl_torus_cpu_stats},
+        {"rt_budget_mb", lua_rt_budget_mb}, {"rt_stats", lua_rt_stats},
+        {"graph_add", lua_graph_add}, {"graph_remove", lua_graph_remove}, {"graph_clear", lua_graph_clear},
+        {"graph_connect", lua_graph_connect}, {"graph_disconnect", lua_graph_disconnect},
+        {"graph_set", lua_graph_set}, {"graph_commit", lua_graph_commit},
+        {"graph_stats", lua_graph_stats}, {"graph_editor", lua_graph_editor},
+        {"midi_ports", lua_midi_ports}, {"midi_open", lua_midi_open}, {"midi_open_virtual", lua_midi_open_virtual},
+        {"midi_play", lua_midi_play}, {"midi_close", lua_midi_close},
+        {"midi_map", lua_midi_map}, {"midi_unmap", lua_midi_unmap}, {"midi_voice", lua_midi_voice},
+        {"midi_cc", lua_midi_cc}, {"midi_source", lua_midi_source}, {"midi_stats", lua_midi_stats},
+        {"llm_load", lua_llm_load}, {"llm_unload", lua_llm_unload}, {"llm_submit", lua_llm_submit},
+        {"llm_cancel", lua_llm_cancel}, {"llm_poll", lua_llm_poll},
+        {"llm_state", lua_llm_state}, {"llm_stats", lua_llm_stats},
+        {nullptr,nullptr}
+    };
+    luaL_newlib(L, fns);
+    lua_pushstring(L, kDemoFfiCdef);
+    lua_setfield(L, -2, "ffi_cdef");
+    lua_setglobal(L, "demo");
+    push_knob_enums(L);
+    push_enum_cache(L, kKnobNames);
+    push_enum_cache(L, kWaveNames);
+    push_enum_cache(L, kNodeNames);
+    push_enum_cache(L, kFilterModeNames);
+    push_enum_cache(L, kAudioParamNames);
+}
+
+lua_State* newPooledLuaState(LuaPool* pool, bool* pooled){
+    lua_State* L = pool ? lua_newstate(LuaPool::alloc, pool) : nullptr;
+    if (pooled) *pooled = L != nullptr;
+    if (!L) L = luaL_newstate();
+    if (L) luaL_openlibs(L);
+    return L;
+}
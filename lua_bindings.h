@@ -0,0 +1,18 @@
+#pragma once
+// Classic lua_CFunction bindings: installs the global `demo` table (plus
+// demo.ffi_cdef for the LuaJIT FFI fast path) and the KnobVariant/OscWave
+// enum tables.
+
+extern "C" {
+#include <lua.h>
+}
+
+class LuaPool;
+
+void registerAllLua(lua_State* L);
+
+// New state allocating through `pool` (see alloc_hooks.h), with the standard
+// libraries opened. Falls back to luaL_newstate() where the VM refuses a
+// custom allocator (64-bit LuaJIT built without GC64); allocations are then
+// not counted, and *pooled (if given) is set to false.
+lua_State* newPooledLuaState(LuaPool* pool, bool* pooled = nullptr);
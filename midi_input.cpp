@@ -0,0 +1,264 @@
+#include "midi_input.h"
+#include "audio_stats.h"
+#include "util.h"
+
+#include <RtMidi.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+/*──────────────────── Standard MIDI File ───────────────────*/
+namespace {
+
+struct Reader {
+    const unsigned char* p;
+    const unsigned char* end;
+    bool has(size_t n) const { return (size_t)(end - p) >= n; }
+    uint32_t be(int n){ uint32_t v = 0; while (n--) v = v << 8 | *p++; return v; }
+    bool varlen(uint32_t& v){
+        v = 0;
+        for (int i=0;i<4 && p<end;++i) { const unsigned char b = *p++; v = v << 7 | (b & 0x7F); if (!(b & 0x80)) return true; }
+        return false;
+    }
+};
+
+struct TickEvent { uint64_t tick; uint8_t status, data1, data2; uint32_t tempo; };   // status 0xFF: tempo change
+
+} // namespace
+
+bool parseMidiFile(const std::string& bytes, std::vector<MidiFileEvent>& out, std::string& err){
+    out.clear();
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(bytes.data());
+    Reader r{ data, data + bytes.size() };
+    if (!r.has(14) || std::memcmp(r.p, "MThd", 4)) { err = "not a MIDI file"; return false; }
+    r.p += 4;
+    const uint32_t hlen = r.be(4);
+    if (hlen < 6 || !r.has(hlen)) { err = "bad MIDI header"; return false; }
+    const uint32_t format = r.be(2), tracks = r.be(2), division = r.be(2);
+    r.p += hlen - 6;
+    if (format > 1) { err = "format 2 MIDI files are not supported"; return false; }
+    if (!(division & 0x8000) && (division & 0x7FFF) == 0) { err = "bad MIDI time division"; return false; }
+
+    // every track to absolute ticks; the stable sort keeps file order within a tick
+    std::vector<TickEvent> ev;
+    for (uint32_t t=0; t<tracks && r.has(8); ) {
+        const bool isTrack = !std::memcmp(r.p, "MTrk", 4);
+        r.p += 4;
+        const uint32_t len = r.be(4);
+        if (!r.has(len)) { err = "truncated MIDI track"; return false; }
+        Reader tr{ r.p, r.p + len };
+        r.p += len;
+        if (!isTrack) continue;                            // unknown chunks are skipped
+        ++t;
+        uint64_t tick = 0;
+        uint8_t running = 0;
+        while (tr.p < tr.end) {
+            uint32_t delta, n;
+            if (!tr.varlen(delta) || !tr.has(1)) break;
+            tick += delta;
+            uint8_t st = *tr.p;
+            if (st & 0x80) ++tr.p;
+            else if (running) st = running;
+            else { err = "MIDI data byte without a status"; return false; }
+
+            if (st == 0xFF) {                              // meta event
+                if (!tr.has(1)) break;
+                const uint8_t type = *tr.p++;
+                if (!tr.varlen(n) || !tr.has(n)) break;
+                if (type == 0x51 && n == 3) ev.push_back(TickEvent{ tick, 0xFF, 0, 0, (uint32_t)tr.p[0] << 16 | tr.p[1] << 8 | tr.p[2] });
+                tr.p += n; running = 0;
+                if (type == 0x2F) break;                   // end of track
+                continue;
+            }
+            if (st == 0xF0 || st == 0xF7) {                // sysex
+                if (!tr.varlen(n) || !tr.has(n)) break;
+                tr.p += n; running = 0;
+                continue;
+            }
+            if (st > 0xF0) {                               // system common/real-time: skip its fixed data bytes
+                n = st == 0xF2 ? 2 : st == 0xF1 || st == 0xF3 ? 1 : 0;
+                if (!tr.has(n)) break;
+                tr.p += n; running = 0;
+                continue;
+            }
+            running = st;
+            const int nData = (st & 0xE0) == 0xC0 ? 1 : 2;    // program change, channel pressure
+            if (!tr.has(nData)) break;
+            ev.push_back(TickEvent{ tick, st, (uint8_t)(tr.p[0] & 0x7F), (uint8_t)(nData == 2 ? tr.p[1] & 0x7F : 0), 0 });
+            tr.p += nData;
+        }
+    }
+    std::stable_sort(ev.begin(), ev.end(), [](const TickEvent& a, const TickEvent& b){ return a.tick < b.tick; });
+
+    // ticks -> seconds through the tempo map (SMPTE divisions have a fixed rate)
+    const bool smpte = division & 0x8000;
+    double secPerTick = smpte ? 1.0 / ((double)-(int8_t)(division >> 8) * (double)(division & 0xFF))
+                              : 0.5 / (double)division;   // 120 bpm until the first tempo event
+    double sec = 0.0;
+    uint64_t last = 0;
+    for (const TickEvent& e : ev) {
+        sec += (double)(e.tick - last) * secPerTick;
+        last = e.tick;
+        if (e.status == 0xFF) { if (!smpte) secPerTick = (double)e.tempo * 1e-6 / (double)division; }
+        else out.push_back(MidiFileEvent{ sec, e.status, e.data1, e.data2 });
+    }
+    if (out.empty()) { err = "no channel events in the MIDI file"; return false; }
+    return true;
+}
+
+/*──────────────────── Producer side ───────────────────*/
+bool MidiInput::push(uint64_t t, uint8_t status, uint8_t d1, uint8_t d2){
+    if (!eng_.midiEvent(MidiEvent{ t, status, d1, d2 })) return false;
+    constexpr auto r = std::memory_order_relaxed;
+    events_.fetch_add(1, r);
+    if ((status & 0xF0) == 0x90 && d2) notes_.fetch_add(1, r);
+    if ((status & 0xF0) == 0xB0) { cc_[d1 & 127].store((int16_t)d2, r); lastCc_.store(d1 & 127, r); }
+    return true;
+}
+
+// RtMidi's input thread. Stamped on arrival; the engine adds one block of latency.
+void MidiInput::onMessage(double, std::vector<unsigned char>* msg, void* user){
+    auto* self = static_cast<MidiInput*>(user);
+    if (!msg || msg->empty() || (*msg)[0] < 0x80 || (*msg)[0] >= 0xF0) return;   // channel voice messages only
+    const uint8_t d1 = msg->size() > 1 ? (*msg)[1] : 0, d2 = msg->size() > 2 ? (*msg)[2] : 0;
+    if (!self->push(AudioStats::nowNs(), (*msg)[0], d1, d2)) self->dropped_.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Events are pushed up to kAheadNs before they are due, stamped with their
+// scheduled time, so the audio thread still places them on the exact sample.
+void MidiInput::replay(std::vector<MidiFileEvent> ev, bool loop){
+    constexpr uint64_t kLeadNs = 100000000, kAheadNs = 20000000;
+    const uint64_t length = std::max<uint64_t>((uint64_t)(ev.back().sec * 1e9), 1000000);
+    uint64_t start = AudioStats::nowNs() + kLeadNs;
+    auto quit = [this]{ return quit_; };
+    std::unique_lock<std::mutex> lk(pm_);
+    do {
+        for (const MidiFileEvent& e : ev) {
+            const uint64_t at = start + (uint64_t)(e.sec * 1e9);
+            const uint64_t now = AudioStats::nowNs();
+            if (at > now + kAheadNs && pcv_.wait_for(lk, std::chrono::nanoseconds(at - kAheadNs - now), quit)) return;
+            // a full queue delays the file rather than dropping notes
+            while (!push(at, e.status, e.data1, e.data2))
+                if (pcv_.wait_for(lk, std::chrono::milliseconds(1), quit)) return;
+            if (quit_) return;
+        }
+        start += length;
+    } while (loop);
+}
+
+/*──────────────────── Sources ───────────────────*/
+MidiInput::MidiInput(AudioEngine& engine) : eng_(engine) {
+    for (auto& c : cc_) c.store(-1, std::memory_order_relaxed);
+}
+
+MidiInput::~MidiInput(){ close(); }
+
+std::vector<std::string> MidiInput::ports(){
+    std::vector<std::string> names;
+    try {
+        RtMidiIn probe(RtMidi::UNSPECIFIED, "sine_demo probe");
+        const unsigned n = probe.getPortCount();
+        for (unsigned i=0;i<n;++i) names.push_back(probe.getPortName(i));
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "[midi] %s\n", e.what());
+    }
+    return names;
+}
+
+bool MidiInput::openRtMidi(int index, bool virt, const std::string& name, std::string* err){
+    std::lock_guard<std::mutex> lk(m_);
+    closeLocked();
+    try {
+        auto in = std::make_unique<RtMidiIn>(RtMidi::UNSPECIFIED, "sine_demo");
+        in->ignoreTypes(true, true, true);                 // sysex, clock, active sensing
+        in->setCallback(&MidiInput::onMessage, this);
+        if (virt) {
+            in->openVirtualPort(name);
+            source_ = "virtual:" + name;
+            kind_.store(MidiSource_Virtual, std::memory_order_relaxed);
+        } else {
+            if (index < 0 || (unsigned)index >= in->getPortCount()) {
+                if (err) *err = "no MIDI input port " + std::to_string(index);
+                return false;
+            }
+            in->openPort((unsigned)index, "sine_demo in");
+            source_ = "port:" + in->getPortName((unsigned)index);
+            kind_.store(MidiSource_Port, std::memory_order_relaxed);
+        }
+        in_ = std::move(in);
+    } catch (const std::exception& e) {
+        source_.clear();
+        kind_.store(MidiSource_None, std::memory_order_relaxed);
+        if (err) *err = e.what();
+        return false;
+    }
+    return true;
+}
+
+bool MidiInput::openPort(int index, std::string* err){ return openRtMidi(index, false, std::string(), err); }
+
+bool MidiInput::openPort(const std::string& nameContains, std::string* err){
+    const std::vector<std::string> names = ports();
+    for (size_t i=0;i<names.size();++i)
+        if (names[i].find(nameContains) != std::string::npos) return openRtMidi((int)i, false, std::string(), err);
+    if (err) *err = "no MIDI input port matching \"" + nameContains + "\"";
+    return false;
+}
+
+bool MidiInput::openVirtual(const std::string& name, std::string* err){
+#if defined(_WIN32)
+    (void)name;
+    if (err) *err = "virtual MIDI ports are not supported on Windows";
+    return false;
+#else
+    return openRtMidi(0, true, name, err);
+#endif
+}
+
+bool MidiInput::playFile(const std::string& path, bool loop, std::string* err){
+    std::string bytes, e;
+    std::vector<MidiFileEvent> ev;
+    if (!readFile(path, bytes)) e = "cannot read " + path;
+    else parseMidiFile(bytes, ev, e);
+    if (!e.empty()) { if (err) *err = e; return false; }
+
+    std::lock_guard<std::mutex> lk(m_);
+    closeLocked();
+    quit_ = false;
+    player_ = std::thread(&MidiInput::replay, this, std::move(ev), loop);
+    source_ = "file:" + path;
+    kind_.store(MidiSource_File, std::memory_order_relaxed);
+    return true;
+}
+
+void MidiInput::close(){
+    std::lock_guard<std::mutex> lk(m_);
+    closeLocked();
+}
+
+void MidiInput::closeLocked(){
+    if (in_) { in_->closePort(); in_.reset(); }          // joins RtMidi's thread
+    if (player_.joinable()) {
+        { std::lock_guard<std::mutex> lk(pm_); quit_ = true; }
+        pcv_.notify_all();
+        player_.join();
+    }
+    // the producer thread is gone, so this thread may push: silence hanging notes
+    if (!source_.empty()) eng_.midiEvent(MidiEvent{ 0, 0xB0, 123, 0 });
+    source_.clear();
+    kind_.store(MidiSource_None, std::memory_order_relaxed);
+}
+
+std::string MidiInput::source() const { std::lock_guard<std::mutex> lk(m_); return source_; }
+
+MidiStats MidiInput::stats() const {
+    constexpr auto r = std::memory_order_relaxed;
+    MidiStats s;
+    s.kind = (MidiSourceKind)kind_.load(r);
+    s.events = events_.load(r); s.dropped = dropped_.load(r); s.notes = notes_.load(r);
+    s.lastCc = lastCc_.load(r);
+    s.lastValue = s.lastCc >= 0 ? cc_[s.lastCc].load(r) : -1;
+    return s;
+}
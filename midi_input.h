@@ -0,0 +1,77 @@
+#pragma once
+// MIDI input: one source at a time feeding AudioEngine's MIDI queue.
+//
+//   * a hardware or software port (RtMidi),
+//   * a virtual port other programs can connect to (ALSA / CoreMIDI), or
+//   * a Standard MIDI File replayed in real time by a thread.
+//
+// Every source stamps events with AudioStats::nowNs() and pushes them through
+// the same lock-free queue; the audio callback places them at their sample
+// offset (see audio_engine.h). The file player stamps events with their
+// scheduled time and pushes them a little ahead, so replay is sample-accurate
+// and needs no MIDI hardware. The current source is the queue's only producer:
+// opening a new one closes the old one first, and close() joins its thread.
+
+#include "audio_engine.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class RtMidiIn;
+
+struct MidiFileEvent { double sec; uint8_t status, data1, data2; };
+
+// Format 0/1 SMF, tracks merged, tempo map applied. Channel voice messages only.
+bool parseMidiFile(const std::string& bytes, std::vector<MidiFileEvent>& out, std::string& err);
+
+enum MidiSourceKind : int { MidiSource_None, MidiSource_Port, MidiSource_Virtual, MidiSource_File };
+
+struct MidiStats {
+    MidiSourceKind kind = MidiSource_None;
+    uint64_t events = 0, dropped = 0, notes = 0;   // dropped: engine queue full
+    int      lastCc = -1, lastValue = -1;
+};
+
+class MidiInput {
+public:
+    explicit MidiInput(AudioEngine& engine);
+    ~MidiInput();
+
+    std::vector<std::string> ports();                      // queries the driver; not per frame
+    bool openPort(int index, std::string* err = nullptr);
+    bool openPort(const std::string& nameContains, std::string* err = nullptr);
+    bool openVirtual(const std::string& name, std::string* err = nullptr);
+    bool playFile(const std::string& path, bool loop, std::string* err = nullptr);
+    void close();                                          // also silences MIDI voices
+
+    std::string source() const;                            // "port:<name>", "file:<path>", ... "" when closed
+    MidiStats stats() const;                               // lock- and allocation-free
+    int cc(int n) const { return n >= 0 && n < 128 ? cc_[n].load(std::memory_order_relaxed) : -1; }
+
+private:
+    static void onMessage(double, std::vector<unsigned char>* msg, void* user);
+    bool push(uint64_t t, uint8_t status, uint8_t d1, uint8_t d2);
+    bool openRtMidi(int index, bool virt, const std::string& name, std::string* err);
+    void closeLocked();
+    void replay(std::vector<MidiFileEvent> ev, bool loop);
+
+    AudioEngine& eng_;
+    mutable std::mutex m_;                                 // open/close; never taken by a producer
+    std::unique_ptr<RtMidiIn> in_;
+    std::string source_;
+
+    std::thread player_;
+    std::mutex pm_;
+    std::condition_variable pcv_;
+    bool quit_ = false;
+
+    std::atomic<uint64_t> events_{0}, dropped_{0}, notes_{0};
+    std::atomic<int>      lastCc_{-1}, kind_{MidiSource_None};
+    std::atomic<int16_t>  cc_[128];
+};
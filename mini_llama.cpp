@@ -1,12 +1,58 @@
 // mini_llama.cpp (stable, template-free; no llama_batch_get_one)
 // Usage:
 //   ./mini_llama "Write a haiku about autumn." [models/tinyllama-1.1b-chat-v1.0.Q4_K_M.gguf]
+//
+// Benchmark (CPU, no output text; JSON on stdout with --json):
+//   ./mini_llama --bench [--model PATH] [--batch 128,512] [--ctx 512,2048]
+//                [--threads 1,4,8] [--prompt-tokens 256] [--gen 64] [--reps 3]
+//                [--prefix-tokens N] [--parallel N] [--draft PATH] [--draft-max 8] [--json]
+// Every n_batch x n_ctx x threads combination gets a fresh context. Prefill
+// and decode are timed separately: prefill tokens/s, time to first token
+// (prefill + first sample), decode tokens/s and per-token latency percentiles.
+// --prefix-tokens also times the first token with the first N prompt tokens
+// restored from a KvPrefixCache instead of decoded.
+//
+// --parallel N also runs N copies of the prompt through the continuous-batching
+// scheduler, one after another and then all at once, and reports aggregate tokens/s.
+// --draft PATH regenerates the greedy output with speculative decoding and
+// checks that it is identical; it reports decode tokens/s and acceptance rate.
+//
+// Chat mode caches the KV state of the fixed preamble in .kvcache/ (see
+// kv_prefix_cache.h): --prefix-cache DIR, --no-prefix-cache. --draft PATH
+// [--draft-max 8] generates with a small draft model (see SpecDecoder).
+//
+// Server (JSONL requests on stdin, or on a Unix socket; replies stream back):
+//   ./mini_llama --serve [--model PATH] [--slots 4] [--ctx 4096] [--batch 512]
+//                [--threads N] [--max-tokens 128] [--socket PATH]
+//   {"id":"a","prompt":"...","max_tokens":64,"temp":0.8,"top_p":0.9,"seed":1}
+//   {"id":"a","cancel":true}
+// Replies: {"id":"a","piece":"..."} per token, then
+//   {"id":"a","done":true,"reason":"eos|length|cancelled|error",...} or {"id":"a","error":"..."}.
 
+#include "kv_prefix_cache.h"
 #include "llama.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
+#if !defined(_WIN32)
+  #include <cerrno>
+  #include <sys/socket.h>
+  #include <sys/un.h>
+  #include <unistd.h>
+#endif
+
+static const char * kDefaultModel = "models/tinyllama-1.1b-chat-v1.0.Q4_K_M.gguf";
+static const char * kPreamble     = "You are a concise, helpful assistant.\nUser: ";
 
 // Robust tokenizer (resizes if initial buffer too small)
 static bool tokenize_text(const llama_vocab * vocab,
@@ -31,9 +77,983 @@ static bool tokenize_text(const llama_vocab * vocab,
     return true;
 }
 
+// Fill `batch` with toks[0..n) at positions pos0.., sequence 0; logits only on the last one.
+static void fill_batch(llama_batch & batch, const llama_token * toks, int n, int pos0, bool logits_last) {
+    for (int i = 0; i < n; ++i) {
+        batch.token[i]     = toks[i];
+        batch.pos[i]       = pos0 + i;
+        batch.seq_id[i][0] = 0;
+        batch.n_seq_id[i]  = 1;
+        batch.logits[i]    = logits_last && i == n - 1;
+    }
+    batch.n_tokens = n;
+}
+
+// Decode toks[0..n) from position pos0 in chunks of at most `cap` tokens (the batch's size).
+static bool decode_tokens(llama_context * ctx, llama_batch & batch, int cap,
+                          const llama_token * toks, int n, int pos0, bool logits_last) {
+    for (int i = 0; i < n; i += cap) {
+        const int k = std::min(cap, n - i);
+        fill_batch(batch, toks + i, k, pos0 + i, logits_last && i + k == n);
+        if (llama_decode(ctx, batch) != 0) return false;
+    }
+    return true;
+}
+
+static double ms_since(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static std::string json_escape(const std::string & s) {
+    std::string out;
+    for (const char c : s) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n";  break;
+            case '\r': out += "\\r";  break;
+            case '\t': out += "\\t";  break;
+            default:
+                if ((unsigned char)c >= 0x20) out += c;
+                else { char u[8]; std::snprintf(u, sizeof(u), "\\u%04x", (unsigned)c); out += u; }
+        }
+    }
+    return out;
+}
+
+// Bytes at the end of s that start a UTF-8 sequence not yet complete (a token can end mid-character).
+static size_t utf8_incomplete_tail(const std::string & s) {
+    for (size_t k = 1; k <= 3 && k <= s.size(); ++k) {
+        const unsigned char c = (unsigned char)s[s.size() - k];
+        if ((c & 0xC0) == 0x80) continue;                          // continuation byte
+        const size_t need = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+        return need > k ? k : 0;
+    }
+    return 0;
+}
+
+/*──────────────────── Continuous batching ───────────────────*/
+// Every request owns one sequence id ("slot") of a shared context. step() is
+// one llama_decode: the next token of every generating slot, then prompt
+// chunks of slots still in prefill, up to n_batch tokens. Requests take a free
+// slot between steps, and a finished one clears its KV cells right away, so
+// the batch never waits for the slowest sequence.
+
+struct ServeClient {                       // where replies go; written by the scheduler thread only
+    FILE * out;
+    bool   dead = false;                   // a write failed: its requests are cancelled
+    explicit ServeClient(FILE * f) : out(f) {}
+    ~ServeClient() { if (out != stdout) std::fclose(out); }
+    void send(const std::string & line) {
+        if (!dead) dead = std::fwrite(line.data(), 1, line.size(), out) != line.size() || std::fflush(out) != 0;
+    }
+};
+
+struct ServeRequest {
+    std::shared_ptr<ServeClient> client;   // null: tokens are only counted (benchmark)
+    std::string id, prompt, error;         // error: the reader rejected the line
+    bool     cancel = false, ignore_eos = false;
+    int      max_tokens = 0;               // 0: the server's default
+    float    temp = 0.8f, top_p = 0.9f;    // temp <= 0: greedy
+    uint32_t seed = LLAMA_DEFAULT_SEED;
+    std::vector<llama_token> toks;         // prompt tokens, when already tokenized
+    std::chrono::steady_clock::time_point arrived = std::chrono::steady_clock::now();
+};
+
+static void reply_error(const ServeRequest & r, const std::string & msg) {
+    if (r.client) r.client->send("{\"id\":\"" + json_escape(r.id) + "\",\"error\":\"" + json_escape(msg) + "\"}\n");
+}
+
+struct ServeStats { uint64_t requests = 0, prompt_tokens = 0, gen_tokens = 0, decodes = 0, batch_tokens = 0; };
+
+class BatchServer {
+public:
+    BatchServer(llama_context * ctx, const llama_vocab * vocab, int n_slots, int seq_ctx)
+        : ctx_(ctx), vocab_(vocab), seq_ctx_(seq_ctx), n_batch_((int)llama_n_batch(ctx)),
+          batch_(llama_batch_init(n_batch_, /*embd*/0, /*n_seq_max*/1)), slots_((size_t)n_slots) {}
+    ~BatchServer() {
+        for (Slot & s : slots_) if (s.active) finish(s, "cancelled");
+        llama_batch_free(batch_);
+    }
+    BatchServer(const BatchServer &) = delete;
+    BatchServer & operator=(const BatchServer &) = delete;
+
+    bool idle() const { for (const Slot & s : slots_) if (s.active) return false; return true; }
+    bool has_free_slot() const { for (const Slot & s : slots_) if (!s.active) return true; return false; }
+    const ServeStats & stats() const { return stats_; }
+
+    // Takes a free slot; the prompt is decoded by the following steps.
+    void start(ServeRequest && r) {
+        Slot * s = nullptr;
+        for (Slot & x : slots_) if (!x.active) { s = &x; break; }
+        if (!s || (r.client && r.client->dead)) return;
+        if (r.toks.empty() && !tokenize_text(vocab_, r.prompt, r.toks, /*add_special=*/true, /*parse_special=*/false)) {
+            reply_error(r, "empty prompt"); return;
+        }
+        if ((int)r.toks.size() >= seq_ctx_) {
+            reply_error(r, "prompt is " + std::to_string(r.toks.size()) + " tokens, a slot holds " + std::to_string(seq_ctx_));
+            return;
+        }
+        llama_sampler * smpl = llama_sampler_chain_init(llama_sampler_chain_default_params());
+        if (r.temp <= 0.0f) llama_sampler_chain_add(smpl, llama_sampler_init_greedy());
+        else {
+            llama_sampler_chain_add(smpl, llama_sampler_init_top_p(r.top_p, /*min_keep=*/1));
+            llama_sampler_chain_add(smpl, llama_sampler_init_temp(r.temp));
+            llama_sampler_chain_add(smpl, llama_sampler_init_dist(r.seed));
+        }
+        llama_memory_seq_rm(llama_get_memory(ctx_), seq_of(*s), -1, -1);
+        *s = Slot();
+        s->active = true;
+        s->req    = std::move(r);
+        s->smpl   = smpl;
+    }
+
+    bool cancel(const ServeClient * c, const std::string & id) {
+        for (Slot & s : slots_)
+            if (s.active && s.req.client.get() == c && s.req.id == id) { finish(s, "cancelled"); return true; }
+        return false;
+    }
+
+    // One shared decode; false when there was nothing to do.
+    bool step() {
+        for (Slot & s : slots_) if (s.active && s.req.client && s.req.client->dead) finish(s, "cancelled");
+        batch_.n_tokens = 0;
+        for (Slot & s : slots_) { s.i_batch = -1; s.in_batch = false; }
+        for (Slot & s : slots_)                                    // generating slots first: one token each
+            if (s.active && s.n_fed == (int)s.req.toks.size() && batch_.n_tokens < n_batch_) add(s, s.last, true);
+        for (Slot & s : slots_) {                                  // prefill takes what is left
+            const int left = (int)s.req.toks.size() - s.n_fed;
+            if (!s.active || left == 0) continue;
+            const int k = std::min(n_batch_ - batch_.n_tokens, left);
+            for (int j = 0; j < k; ++j, ++s.n_fed) add(s, s.req.toks[s.n_fed], s.n_fed + 1 == (int)s.req.toks.size());
+            stats_.prompt_tokens += (uint64_t)k;
+        }
+        if (batch_.n_tokens == 0) return false;
+
+        const int rc = llama_decode(ctx_, batch_);
+        ++stats_.decodes;
+        stats_.batch_tokens += (uint64_t)batch_.n_tokens;
+        if (rc != 0) {
+            for (Slot & s : slots_) if (s.active && s.in_batch) finish(s, "error");
+            return true;
+        }
+        for (Slot & s : slots_) {
+            if (!s.active || s.i_batch < 0) continue;
+            const llama_token id = llama_sampler_sample(s.smpl, ctx_, s.i_batch);   // also accepts id
+            if (s.n_gen == 0) { s.ttft_ms = ms_since(s.req.arrived); s.t_first = std::chrono::steady_clock::now(); }
+            if (!s.req.ignore_eos && llama_vocab_is_eog(vocab_, id)) { finish(s, "eos"); continue; }
+            ++s.n_gen;
+            ++stats_.gen_tokens;
+            s.last = id;
+            if (s.req.client) {
+                char piece[256];
+                const int n = llama_token_to_piece(vocab_, id, piece, (int)sizeof(piece), /*lstrip=*/0, /*special=*/false);
+                if (n > 0) s.text.append(piece, (size_t)n);
+                flush_text(s, false);
+            }
+            if (s.n_gen >= s.req.max_tokens || s.n_past >= seq_ctx_) finish(s, "length");
+        }
+        return true;
+    }
+
+private:
+    struct Slot {
+        bool active = false, in_batch = false;
+        ServeRequest req;
+        llama_sampler * smpl = nullptr;
+        int n_fed = 0, n_past = 0, n_gen = 0, i_batch = -1;    // prompt tokens decoded, KV cells, tokens sampled
+        llama_token last = 0;
+        std::string text;                                       // sampled bytes not sent yet
+        double ttft_ms = 0.0;
+        std::chrono::steady_clock::time_point t_first;
+    };
+
+    llama_seq_id seq_of(const Slot & s) const { return (llama_seq_id)(&s - slots_.data()); }
+
+    void add(Slot & s, llama_token t, bool logits) {
+        const int i = batch_.n_tokens++;
+        batch_.token[i]     = t;
+        batch_.pos[i]       = s.n_past++;
+        batch_.seq_id[i][0] = seq_of(s);
+        batch_.n_seq_id[i]  = 1;
+        batch_.logits[i]    = logits;
+        s.in_batch = true;
+        if (logits) s.i_batch = i;
+    }
+
+    void flush_text(Slot & s, bool all) {
+        const size_t n = s.text.size() - (all ? 0 : utf8_incomplete_tail(s.text));
+        if (n == 0) return;
+        s.req.client->send("{\"id\":\"" + json_escape(s.req.id) + "\",\"piece\":\"" + json_escape(s.text.substr(0, n)) + "\"}\n");
+        s.text.erase(0, n);
+    }
+
+    void finish(Slot & s, const char * reason) {
+        if (s.req.client) {
+            flush_text(s, true);
+            const double gen_s = s.n_gen > 1 ? ms_since(s.t_first) * 1e-3 : 0.0;
+            char tail[192];
+            std::snprintf(tail, sizeof(tail), "\",\"done\":true,\"reason\":\"%s\",\"prompt_tokens\":%d,\"tokens\":%d,\"ttft_ms\":%.1f,\"tok_s\":%.1f}\n",
+                          reason, (int)s.req.toks.size(), s.n_gen, s.ttft_ms, gen_s > 0 ? (s.n_gen - 1) / gen_s : 0.0);
+            s.req.client->send("{\"id\":\"" + json_escape(s.req.id) + tail);
+        }
+        ++stats_.requests;
+        llama_memory_seq_rm(llama_get_memory(ctx_), seq_of(s), -1, -1);
+        llama_sampler_free(s.smpl);
+        s = Slot();
+    }
+
+    llama_context *     ctx_;
+    const llama_vocab * vocab_;
+    int                 seq_ctx_, n_batch_;                     // KV cells per slot, batch capacity
+    llama_batch         batch_;
+    std::vector<Slot>   slots_;
+    ServeStats          stats_;
+};
+
+/*──────────────────── Speculative decoding ───────────────────*/
+// A small draft model proposes k tokens; the target decodes them all in one
+// batch and keeps the longest run its own sampler agrees with, plus its own
+// next token. KV cells past that run are removed from both contexts. With a
+// deterministic (greedy) chain the output is token for token what one
+// decode per token would give. k follows the observed acceptance rate and
+// the measured cost of a draft token relative to a target decode.
+
+// Same special tokens, and the ids both vocabularies have spell the same text.
+static bool draft_compatible(const llama_model * target, const llama_model * draft) {
+    const llama_vocab * tv = llama_model_get_vocab(target);
+    const llama_vocab * dv = llama_model_get_vocab(draft);
+    const int nt = llama_vocab_n_tokens(tv), nd = llama_vocab_n_tokens(dv);
+    if (llama_vocab_bos(tv) != llama_vocab_bos(dv) || llama_vocab_eos(tv) != llama_vocab_eos(dv) || std::abs(nt - nd) > 128) return false;
+    const int n = std::min(nt, nd);
+    char a[256], b[256];
+    for (int i = 0; i < n; i += std::max(1, n / 997)) {
+        const int la = llama_token_to_piece(tv, i, a, (int)sizeof(a), 0, true);
+        const int lb = llama_token_to_piece(dv, i, b, (int)sizeof(b), 0, true);
+        if (la != lb || (la > 0 && std::memcmp(a, b, (size_t)la) != 0)) return false;
+    }
+    return true;
+}
+
+struct SpecStats { int rounds = 0, drafted = 0, accepted = 0; double draft_ms = 0.0, verify_ms = 0.0; };
+
+class SpecDecoder {
+public:
+    // Both contexts hold the prompt in sequence 0 at positions 0..n_prompt-1,
+    // and tgt has logits for its last token. smpl is the target's chain.
+    SpecDecoder(llama_context * tgt, llama_context * dft, llama_sampler * smpl, int n_prompt, int k_max)
+        : tgt_(tgt), dft_(dft), smpl_(smpl), dsmpl_(llama_sampler_init_greedy()),
+          tb_(llama_batch_init(k_max + 1, 0, 1)), db_(llama_batch_init(k_max + 2, 0, 1)),
+          k_max_(std::max(1, k_max)), n_past_(n_prompt), d_past_(n_prompt), base_(n_prompt),
+          n_ctx_((int)std::min(llama_n_ctx(tgt), llama_n_ctx(dft))),
+          n_vocab_(llama_vocab_n_tokens(llama_model_get_vocab(llama_get_model(tgt)))) {}
+    ~SpecDecoder() { llama_batch_free(db_); llama_batch_free(tb_); llama_sampler_free(dsmpl_); }
+    SpecDecoder(const SpecDecoder &) = delete;
+    SpecDecoder & operator=(const SpecDecoder &) = delete;
+
+    // Appends at least one and at most max_out tokens; false on a decode error or a full context.
+    bool next(std::vector<llama_token> & out, int max_out) {
+        if (!started_) {                                           // the first token comes from the prompt's logits
+            started_ = true;
+            id_ = llama_sampler_sample(smpl_, tgt_, -1);
+            out.push_back(id_);
+            return true;
+        }
+        const int k = std::min({ choose_k(), max_out - 1, n_ctx_ - n_past_ - 1 });
+        if (k < 0) return false;
+
+        // draft: catch up on what the target accepted last round, then propose greedily
+        draft_.clear();
+        if (k > 0) {
+            const auto t0 = std::chrono::steady_clock::now();
+            feed_.assign(hist_.begin() + (d_past_ - base_), hist_.end());
+            feed_.push_back(id_);
+            if (!decode_tokens(dft_, db_, k_max_ + 2, feed_.data(), (int)feed_.size(), d_past_, /*logits_last=*/true)) return false;
+            d_past_ = n_past_ + 1;
+            for (;;) {
+                const llama_token t = llama_sampler_sample(dsmpl_, dft_, -1);
+                if (t >= n_vocab_) break;                          // the target has no such token
+                draft_.push_back(t);
+                if ((int)draft_.size() == k) break;
+                fill_batch(db_, &t, 1, d_past_++, true);
+                if (llama_decode(dft_, db_) != 0) return false;
+            }
+            const double ms = ms_since(t0);
+            st_.draft_ms += ms;
+            t_draft_ = ema(t_draft_, ms / (double)std::max<size_t>(1, draft_.size()));
+        }
+
+        // verify: id_ and every draft token in one target decode, logits for all
+        const auto t0 = std::chrono::steady_clock::now();
+        feed_.assign(1, id_);
+        feed_.insert(feed_.end(), draft_.begin(), draft_.end());
+        fill_batch(tb_, feed_.data(), (int)feed_.size(), n_past_, false);
+        for (int i = 0; i < tb_.n_tokens; ++i) tb_.logits[i] = true;
+        if (llama_decode(tgt_, tb_) != 0) return false;
+        size_t a = 0;
+        for (;; ++a) {
+            const llama_token t = llama_sampler_sample(smpl_, tgt_, (int)a);
+            out.push_back(t);
+            if (a == draft_.size() || t != draft_[a]) break;
+        }
+        const double ms = ms_since(t0);
+        st_.verify_ms += ms;
+        t_verify_ = ema(t_verify_, ms);
+
+        // keep id_ and the accepted drafts; drop the rest from both caches
+        hist_.push_back(id_);
+        hist_.insert(hist_.end(), draft_.begin(), draft_.begin() + (long)a);
+        n_past_ += 1 + (int)a;
+        llama_memory_seq_rm(llama_get_memory(tgt_), 0, n_past_, -1);
+        if (d_past_ > n_past_) { llama_memory_seq_rm(llama_get_memory(dft_), 0, n_past_, -1); d_past_ = n_past_; }
+        id_ = out.back();
+
+        ++st_.rounds;
+        st_.drafted  += (int)draft_.size();
+        st_.accepted += (int)a;
+        acc_ = 0.9 * acc_ + (double)a;
+        rej_ = 0.9 * rej_ + (a < draft_.size() ? 1.0 : 0.0);
+        return true;
+    }
+
+    const SpecStats & stats() const { return st_; }
+
+private:
+    static double ema(double avg, double x) { return avg > 0.0 ? 0.8 * avg + 0.2 * x : x; }
+
+    // The k that maximises expected tokens per millisecond: a round yields
+    // (1 - p^(k+1)) / (1 - p) tokens for one verify plus k draft tokens.
+    int choose_k() const {
+        const double p = (acc_ + 1.0) / (acc_ + rej_ + 2.0);      // per-token acceptance, smoothed
+        const double r = t_draft_ > 0.0 && t_verify_ > 0.0 ? t_draft_ / t_verify_ : 0.1;
+        int best = 1;
+        double best_rate = 0.0, pk = p;
+        for (int k = 1; k <= k_max_; ++k) {
+            pk *= p;
+            const double rate = (1.0 - pk) / (1.0 - p) / (1.0 + k * r);
+            if (rate > best_rate) { best_rate = rate; best = k; }
+        }
+        return best;
+    }
+
+    llama_context * tgt_;
+    llama_context * dft_;
+    llama_sampler * smpl_;
+    llama_sampler * dsmpl_;
+    llama_batch     tb_, db_;
+    int  k_max_, n_past_, d_past_, base_, n_ctx_, n_vocab_;   // n_past_/d_past_: KV cells in tgt/dft
+    bool started_ = false;
+    llama_token id_ = 0;                                        // last emitted token, not decoded yet
+    std::vector<llama_token> hist_, draft_, feed_;              // hist_: accepted tokens after the prompt
+    double acc_ = 0.0, rej_ = 0.0, t_draft_ = 0.0, t_verify_ = 0.0;
+    SpecStats st_;
+};
+
+/*──────────────────── Benchmark ───────────────────*/
+static std::vector<int> parse_list(const char * s) {
+    std::vector<int> v;
+    while (s && *s) {
+        char * end = nullptr; long x = std::strtol(s, &end, 10);
+        if (end == s) break;
+        v.push_back((int)x);
+        s = (*end == ',') ? end + 1 : end;
+    }
+    return v;
+}
+
+static double percentile(std::vector<double> v, double p) {
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    const size_t i = std::min(v.size() - 1, (size_t)(p * (double)(v.size() - 1) + 0.5));
+    return v[i];
+}
+
+struct BenchResult {
+    int    n_batch, n_ctx, threads, prompt_tokens, gen_tokens;
+    double prefill_ms, prefill_tok_s, ttft_ms, decode_tok_s, p50_ms, p90_ms, p99_ms;
+    bool   ok;
+    int    prefix_tokens;     // > 0: ttft_prefix_ms restores that many tokens from a KvPrefixCache
+    double ttft_prefix_ms;
+    int    parallel;          // > 1: that many copies of the prompt through BatchServer
+    double serial_tok_s, batched_tok_s;
+    int    draft_max;         // > 0: greedy generation again through SpecDecoder
+    double spec_tok_s, accept_rate, tokens_per_verify;
+    bool   spec_identical;
+};
+
+// Prompt of exactly n tokens: BOS + a paragraph repeated.
+static std::vector<llama_token> bench_prompt(const llama_vocab * vocab, int n) {
+    static const char * kText =
+        " The quick brown fox jumps over the lazy dog while the audio engine renders"
+        " another block and the user interface redraws a rainbow torus.";
+    std::vector<llama_token> toks, more;
+    tokenize_text(vocab, kText, toks, /*add_special=*/true);
+    tokenize_text(vocab, kText, more, /*add_special=*/false);
+    while ((int)toks.size() < n && !more.empty()) toks.insert(toks.end(), more.begin(), more.end());
+    toks.resize(std::min((int)toks.size(), n));
+    return toks;
+}
+
+// n_par copies of the prompt, each in its own n_ctx slot: one request at a time,
+// then all at once. Aggregate generated tokens/s, prefill included.
+static bool bench_parallel(llama_model * model, int n_batch, int n_ctx, int threads, const std::vector<llama_token> & prompt,
+                           int gen_tokens, int n_par, double & serial_tok_s, double & batched_tok_s) {
+    llama_context_params cp = llama_context_default_params();
+    cp.n_ctx           = (uint32_t)(n_ctx * n_par);
+    cp.n_batch         = (uint32_t)std::max(n_batch, n_par);
+    cp.n_ubatch        = cp.n_batch;
+    cp.n_seq_max       = (uint32_t)n_par;
+    cp.n_threads       = threads;
+    cp.n_threads_batch = threads;
+    cp.no_perf         = true;
+    llama_context * ctx = llama_init_from_model(model, cp);
+    if (!ctx) return false;
+
+    bool ok = true;
+    for (int pass = -1; pass < 2 && ok; ++pass) {                  // pass -1: one request to warm up
+        BatchServer server(ctx, llama_model_get_vocab(model), n_par, n_ctx);
+        const int n_req = pass < 0 ? 1 : n_par;
+        const auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < n_req; ++i) {
+            ServeRequest q;
+            q.toks = prompt; q.max_tokens = gen_tokens; q.temp = 0.0f; q.ignore_eos = true;
+            server.start(std::move(q));
+            if (pass < 1) while (server.step()) {}                 // serial: wait for it to finish
+        }
+        while (server.step()) {}
+        const double sec = ms_since(t0) * 1e-3;
+        ok = server.stats().gen_tokens == (uint64_t)n_req * (uint64_t)gen_tokens;
+        if (pass == 0) serial_tok_s  = n_req * gen_tokens / sec;
+        if (pass == 1) batched_tok_s = n_req * gen_tokens / sec;
+    }
+    llama_free(ctx);
+    return ok;
+}
+
+// The greedy tokens of the plain decode loop (ref) regenerated with a draft
+// model; decode rate, acceptance and whether the output matched.
+static bool bench_spec(llama_context * ctx, llama_model * draft, const llama_context_params & cp, llama_batch & batch,
+                       const std::vector<llama_token> & prompt, const std::vector<llama_token> & ref, int reps, int draft_max,
+                       BenchResult & r) {
+    llama_context * dctx = llama_init_from_model(draft, cp);
+    if (!dctx) return false;
+    llama_sampler * smpl = llama_sampler_init_greedy();
+    const int n_prompt = (int)prompt.size(), cap = (int)cp.n_batch;
+    std::vector<double> rate;
+    std::vector<llama_token> out;
+    bool ok = true;
+    for (int rep = 0; rep < reps && ok; ++rep) {
+        llama_memory_clear(llama_get_memory(ctx), true);
+        llama_memory_clear(llama_get_memory(dctx), true);
+        llama_sampler_reset(smpl);
+        ok = decode_tokens(ctx, batch, cap, prompt.data(), n_prompt, 0, true)
+          && decode_tokens(dctx, batch, cap, prompt.data(), n_prompt, 0, false);
+        SpecDecoder spec(ctx, dctx, smpl, n_prompt, draft_max);
+        out.clear();
+        const auto t0 = std::chrono::steady_clock::now();
+        while (ok && out.size() < ref.size()) ok = spec.next(out, (int)(ref.size() - out.size()));
+        if (!ok) break;
+        rate.push_back((double)(ref.size() - 1) / (ms_since(t0) * 1e-3));  // as decode_tok_s: one token per decode step
+        const SpecStats & ss = spec.stats();
+        r.accept_rate       = ss.drafted ? (double)ss.accepted / ss.drafted : 0.0;
+        r.tokens_per_verify = ss.rounds ? (double)(ref.size() - 1) / ss.rounds : 0.0;
+        r.spec_identical    = out == ref;
+    }
+    if (ok) { r.spec_tok_s = percentile(rate, 0.5); r.draft_max = draft_max; }
+    llama_sampler_free(smpl);
+    llama_free(dctx);
+    return ok;
+}
+
+static BenchResult bench_one(llama_model * model, int n_batch, int n_ctx, int threads,
+                             int prompt_tokens, int gen_tokens, int reps, int prefix_tokens, int n_par,
+                             llama_model * draft, int draft_max) {
+    BenchResult r{ n_batch, n_ctx, threads, prompt_tokens, gen_tokens, 0, 0, 0, 0, 0, 0, 0, false, 0, 0, 0, 0, 0, 0, 0, 0, 0, false };
+    if (prompt_tokens + gen_tokens > n_ctx) return r;             // does not fit: reported as skipped
+
+    llama_context_params cp = llama_context_default_params();
+    cp.n_ctx           = (uint32_t)n_ctx;
+    cp.n_batch         = (uint32_t)n_batch;
+    cp.n_ubatch        = (uint32_t)n_batch;
+    cp.n_threads       = threads;
+    cp.n_threads_batch = threads;
+    cp.no_perf         = true;
+    llama_context * ctx = llama_init_from_model(model, cp);
+    if (!ctx) return r;
+
+    const llama_vocab * vocab = llama_model_get_vocab(model);
+    const std::vector<llama_token> prompt = bench_prompt(vocab, prompt_tokens);
+    llama_batch batch = llama_batch_init(n_batch, /*embd*/0, /*n_seq_max*/1);
+    llama_sampler * smpl = llama_sampler_init_greedy();           // deterministic across runs
+    llama_memory_t mem = llama_get_memory(ctx);
+
+    const int n_prompt = (int)prompt.size();
+    std::vector<double> prefill, ttft, step;
+    std::vector<llama_token> ref;                                  // the greedy output, for the draft run
+    bool ok = !prompt.empty();
+    for (int rep = -1; rep < reps && ok; ++rep) {                  // rep -1 warms caches and thread pools
+        llama_memory_clear(mem, true);
+        llama_sampler_reset(smpl);
+        const auto t0 = std::chrono::steady_clock::now();
+        ok = decode_tokens(ctx, batch, n_batch, prompt.data(), n_prompt, 0, true);
+        if (!ok) break;
+        const double pre = ms_since(t0);
+        llama_token id = llama_sampler_sample(smpl, ctx, -1);
+        const double first = ms_since(t0);
+        std::vector<double> lat;
+        ref.assign(1, id);
+        for (int t = 0; t < gen_tokens && ok; ++t) {
+            const auto s0 = std::chrono::steady_clock::now();
+            fill_batch(batch, &id, 1, n_prompt + t, true);
+            ok = llama_decode(ctx, batch) == 0;
+            id = llama_sampler_sample(smpl, ctx, -1);             // EOS is fed back like any token
+            lat.push_back(ms_since(s0));
+            ref.push_back(id);
+        }
+        if (rep < 0) continue;
+        prefill.push_back(pre); ttft.push_back(first);
+        step.insert(step.end(), lat.begin(), lat.end());
+    }
+
+    // the same prompt with its first prefix_tokens restored instead of decoded
+    std::vector<double> ttftPrefix;
+    if (ok && prefix_tokens > 0 && prefix_tokens < n_prompt) {
+        KvPrefixCache cache("");                                   // in-process only
+        llama_memory_clear(mem, true);
+        ok = decode_tokens(ctx, batch, n_batch, prompt.data(), prefix_tokens, 0, false)
+          && cache.store(ctx, 0, prompt.data(), prefix_tokens);
+        for (int rep = 0; rep < reps && ok; ++rep) {
+            llama_memory_clear(mem, true);
+            llama_sampler_reset(smpl);
+            const auto t0 = std::chrono::steady_clock::now();
+            ok = cache.restore(ctx, 0, prompt.data(), prefix_tokens)
+              && decode_tokens(ctx, batch, n_batch, prompt.data() + prefix_tokens, n_prompt - prefix_tokens, prefix_tokens, true);
+            if (!ok) break;
+            llama_sampler_sample(smpl, ctx, -1);
+            ttftPrefix.push_back(ms_since(t0));
+        }
+    }
+
+    if (ok && !prefill.empty()) {
+        double sum = 0.0;
+        for (double s : step) sum += s;
+        r.prefill_ms    = percentile(prefill, 0.5);
+        r.prefill_tok_s = prompt.size() / (r.prefill_ms * 1e-3);
+        r.ttft_ms       = percentile(ttft, 0.5);
+        r.decode_tok_s  = step.empty() ? 0.0 : step.size() / (sum * 1e-3);
+        r.p50_ms = percentile(step, 0.50); r.p90_ms = percentile(step, 0.90); r.p99_ms = percentile(step, 0.99);
+        r.prompt_tokens = n_prompt;
+        if (!ttftPrefix.empty()) { r.prefix_tokens = prefix_tokens; r.ttft_prefix_ms = percentile(ttftPrefix, 0.5); }
+        r.ok = true;
+    }
+    if (r.ok && draft && gen_tokens > 0)
+        r.ok = bench_spec(ctx, draft, cp, batch, prompt, ref, reps, draft_max, r);
+    llama_sampler_free(smpl);
+    llama_batch_free(batch);
+    llama_free(ctx);
+
+    if (r.ok && n_par > 1 && gen_tokens > 0) {
+        r.ok = bench_parallel(model, n_batch, n_ctx, threads, prompt, gen_tokens, n_par, r.serial_tok_s, r.batched_tok_s);
+        r.parallel = n_par;
+    }
+    return r;
+}
+
+static void quiet_log(ggml_log_level level, const char * text, void *) {
+    if (level == GGML_LOG_LEVEL_ERROR) std::fputs(text, stderr);
+}
+
+static int bench_main(int argc, char ** argv) {
+    const char * model_path = kDefaultModel;
+    std::vector<int> batches = { 512 };
+    std::vector<int> ctxs    = { 2048 };
+    std::vector<int> threads = { (int)std::max(1u, std::thread::hardware_concurrency() / 2) };
+    const char * draft_path = nullptr;
+    int prompt_tokens = 256, gen_tokens = 64, reps = 3, prefix_tokens = 0, n_par = 0, draft_max = 8;
+    bool json = false, verbose = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const char * a = argv[i];
+        auto next = [&]{ if (i + 1 >= argc) { std::fprintf(stderr, "%s needs a value\n", a); std::exit(2); } return argv[++i]; };
+        if      (!std::strcmp(a, "--bench"))         {}
+        else if (!std::strcmp(a, "--model"))         model_path    = next();
+        else if (!std::strcmp(a, "--batch"))         batches       = parse_list(next());
+        else if (!std::strcmp(a, "--ctx"))           ctxs          = parse_list(next());
+        else if (!std::strcmp(a, "--threads"))       threads       = parse_list(next());
+        else if (!std::strcmp(a, "--prompt-tokens")) prompt_tokens = std::atoi(next());
+        else if (!std::strcmp(a, "--gen"))           gen_tokens    = std::atoi(next());
+        else if (!std::strcmp(a, "--reps"))          reps          = std::atoi(next());
+        else if (!std::strcmp(a, "--prefix-tokens")) prefix_tokens = std::atoi(next());
+        else if (!std::strcmp(a, "--parallel"))      n_par         = std::atoi(next());
+        else if (!std::strcmp(a, "--draft"))         draft_path    = next();
+        else if (!std::strcmp(a, "--draft-max"))     draft_max     = std::max(1, std::atoi(next()));
+        else if (!std::strcmp(a, "--json"))          json          = true;
+        else if (!std::strcmp(a, "--verbose"))       verbose       = true;
+        else { std::fprintf(stderr, "unknown option %s\n", a); return 2; }
+    }
+    if (batches.empty() || ctxs.empty() || threads.empty() || prompt_tokens <= 0 || gen_tokens < 0 || reps <= 0) {
+        std::fprintf(stderr, "nothing to run\n"); return 2;
+    }
+
+    if (!verbose) llama_log_set(quiet_log, nullptr);
+    llama_backend_init();
+    llama_model_params mp = llama_model_default_params();
+    mp.n_gpu_layers = 0;                                           // CPU numbers are the baseline we track
+    const auto tl = std::chrono::steady_clock::now();
+    llama_model * model = llama_model_load_from_file(model_path, mp);
+    if (!model) { std::fprintf(stderr, "Failed to load model: %s\n", model_path); llama_backend_free(); return 1; }
+    const double load_ms = ms_since(tl);
+    llama_model * draft = draft_path ? llama_model_load_from_file(draft_path, mp) : nullptr;
+    if (draft_path && (!draft || !draft_compatible(model, draft))) {
+        std::fprintf(stderr, "draft model %s: %s\n", draft_path, draft ? "has a different vocabulary" : "failed to load");
+        if (draft) llama_model_free(draft);
+        llama_model_free(model); llama_backend_free(); return 1;
+    }
+
+    std::vector<BenchResult> results;
+    for (int c : ctxs)
+        for (int b : batches)
+            for (int t : threads) {
+                results.push_back(bench_one(model, b, c, t, prompt_tokens, gen_tokens, reps, prefix_tokens, n_par, draft, draft_max));
+                if (!json) std::fprintf(stderr, "  ctx %d batch %d threads %d done\n", c, b, t);
+            }
+
+    char desc[128];
+    llama_model_desc(model, desc, sizeof(desc));
+    if (json) {
+        std::printf("{\"model\":\"%s\",\"desc\":\"%s\",\"load_ms\":%.1f,\"prompt_tokens\":%d,\"gen_tokens\":%d,\"reps\":%d,\"results\":[",
+                    json_escape(model_path).c_str(), json_escape(desc).c_str(), load_ms, prompt_tokens, gen_tokens, reps);
+        for (size_t i = 0; i < results.size(); ++i) {
+            const BenchResult & r = results[i];
+            std::printf("%s{\"n_batch\":%d,\"n_ctx\":%d,\"threads\":%d,\"ok\":%s", i ? "," : "",
+                        r.n_batch, r.n_ctx, r.threads, r.ok ? "true" : "false");
+            if (r.ok)
+                std::printf(",\"prompt_tokens\":%d,\"prefill_ms\":%.2f,\"prefill_tok_s\":%.1f,\"ttft_ms\":%.2f,"
+                            "\"decode_tok_s\":%.2f,\"decode_p50_ms\":%.3f,\"decode_p90_ms\":%.3f,\"decode_p99_ms\":%.3f",
+                            r.prompt_tokens, r.prefill_ms, r.prefill_tok_s, r.ttft_ms,
+                            r.decode_tok_s, r.p50_ms, r.p90_ms, r.p99_ms);
+            if (r.prefix_tokens)
+                std::printf(",\"prefix_tokens\":%d,\"ttft_prefix_ms\":%.2f", r.prefix_tokens, r.ttft_prefix_ms);
+            if (r.parallel)
+                std::printf(",\"parallel\":%d,\"serial_tok_s\":%.2f,\"batched_tok_s\":%.2f", r.parallel, r.serial_tok_s, r.batched_tok_s);
+            if (r.draft_max)
+                std::printf(",\"draft_max\":%d,\"spec_tok_s\":%.2f,\"spec_speedup\":%.3f,\"accept_rate\":%.3f,"
+                            "\"tokens_per_verify\":%.2f,\"spec_identical\":%s",
+                            r.draft_max, r.spec_tok_s, r.decode_tok_s > 0 ? r.spec_tok_s / r.decode_tok_s : 0.0, r.accept_rate,
+                            r.tokens_per_verify, r.spec_identical ? "true" : "false");
+            std::printf("}");
+        }
+        std::printf("]}\n");
+    } else {
+        std::printf("%s (%s), load %.0f ms, %d prompt + %d generated tokens, %d reps\n",
+                    model_path, desc, load_ms, prompt_tokens, gen_tokens, reps);
+        std::printf("%6s %6s %4s %11s %12s %9s %11s %8s %8s %8s\n",
+                    "ctx", "batch", "thr", "prefill ms", "prefill t/s", "ttft ms", "decode t/s", "p50 ms", "p90 ms", "p99 ms");
+        for (const BenchResult & r : results) {
+            if (!r.ok) { std::printf("%6d %6d %4d   (skipped: prompt + gen > ctx, or context failed)\n", r.n_ctx, r.n_batch, r.threads); continue; }
+            std::printf("%6d %6d %4d %11.1f %12.1f %9.1f %11.2f %8.2f %8.2f %8.2f\n",
+                        r.n_ctx, r.n_batch, r.threads, r.prefill_ms, r.prefill_tok_s, r.ttft_ms,
+                        r.decode_tok_s, r.p50_ms, r.p90_ms, r.p99_ms);
+            if (r.prefix_tokens)
+                std::printf("%20s ttft %.1f ms with %d prefix tokens restored (%.1fx)\n", "",
+                            r.ttft_prefix_ms, r.prefix_tokens, r.ttft_prefix_ms > 0 ? r.ttft_ms / r.ttft_prefix_ms : 0.0);
+            if (r.parallel)
+                std::printf("%20s %d sequences: %.1f tok/s one at a time, %.1f tok/s batched (%.1fx)\n", "", r.parallel,
+                            r.serial_tok_s, r.batched_tok_s, r.serial_tok_s > 0 ? r.batched_tok_s / r.serial_tok_s : 0.0);
+            if (r.draft_max)
+                std::printf("%20s draft k<=%d: %.2f tok/s (%.2fx), %.0f%% accepted, %.2f tokens per target decode%s\n", "",
+                            r.draft_max, r.spec_tok_s, r.decode_tok_s > 0 ? r.spec_tok_s / r.decode_tok_s : 0.0,
+                            100.0 * r.accept_rate, r.tokens_per_verify, r.spec_identical ? "" : ", OUTPUT DIFFERS");
+        }
+    }
+
+    if (draft) llama_model_free(draft);
+    llama_model_free(model);
+    llama_backend_free();
+    for (const BenchResult & r : results)
+        if ((!r.ok && r.prompt_tokens + r.gen_tokens <= r.n_ctx) || (r.draft_max && !r.spec_identical)) return 1;
+    return 0;
+}
+
+/*──────────────────── Server ───────────────────*/
+// Just enough JSON for a request line: one flat object of strings, numbers and booleans.
+struct JsonCursor {
+    const char * p;
+    const char * end;
+
+    void ws() { while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) ++p; }
+    bool eat(char c) { ws(); if (p < end && *p == c) { ++p; return true; } return false; }
+    bool hex4(uint32_t & v) {
+        if (end - p < 4) return false;
+        v = 0;
+        for (int i = 0; i < 4; ++i, ++p) {
+            const char c = *p;
+            v = v << 4 | (uint32_t)(c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : 99);
+            if (v & ~0xFFFFu) return false;
+        }
+        return true;
+    }
+    bool string(std::string & out) {
+        out.clear();
+        if (!eat('"')) return false;
+        while (p < end) {
+            char c = *p++;
+            if (c == '"') return true;
+            if (c != '\\') { out += c; continue; }
+            if (p >= end) return false;
+            switch (c = *p++) {
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'u': {
+                    uint32_t cp, lo;
+                    if (!hex4(cp)) return false;
+                    if (cp >= 0xD800 && cp < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u') {   // surrogate pair
+                        p += 2;
+                        if (!hex4(lo)) return false;
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                    }
+                    if      (cp < 0x80)    out += (char)cp;
+                    else if (cp < 0x800)   { out += (char)(0xC0 | cp >> 6); out += (char)(0x80 | (cp & 0x3F)); }
+                    else if (cp < 0x10000) { out += (char)(0xE0 | cp >> 12); out += (char)(0x80 | (cp >> 6 & 0x3F)); out += (char)(0x80 | (cp & 0x3F)); }
+                    else { out += (char)(0xF0 | cp >> 18); out += (char)(0x80 | (cp >> 12 & 0x3F));
+                           out += (char)(0x80 | (cp >> 6 & 0x3F)); out += (char)(0x80 | (cp & 0x3F)); }
+                    break;
+                }
+                default: out += c;                                  // \" \\ \/
+            }
+        }
+        return false;
+    }
+    bool scalar(std::string & out) {                                // number, true, false, null
+        ws();
+        const char * b = p;
+        while (p < end && *p != ',' && *p != '}' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') ++p;
+        out.assign(b, p);
+        return !out.empty() && out[0] != '{' && out[0] != '[';
+    }
+};
+
+static bool parse_request(const std::string & line, ServeRequest & r) {
+    JsonCursor j{ line.data(), line.data() + line.size() };
+    bool has_prompt = false;
+    if (!j.eat('{')) { r.error = "expected a JSON object"; return false; }
+    if (!j.eat('}')) {
+        do {
+            std::string key, val;
+            if (!j.string(key) || !j.eat(':')) { r.error = "bad JSON"; return false; }
+            j.ws();
+            const bool str = j.p < j.end && *j.p == '"';
+            if (str ? !j.string(val) : !j.scalar(val)) { r.error = "bad value for \"" + key + "\""; return false; }
+            if      (key == "id")                          r.id = val;
+            else if (key == "prompt")                      { r.prompt = val; has_prompt = true; }
+            else if (key == "max_tokens")                  r.max_tokens = std::atoi(val.c_str());
+            else if (key == "temp" || key == "temperature") r.temp = (float)std::atof(val.c_str());
+            else if (key == "top_p")                       r.top_p = (float)std::atof(val.c_str());
+            else if (key == "seed")                        r.seed = (uint32_t)std::strtoul(val.c_str(), nullptr, 10);
+            else if (key == "cancel")                      r.cancel = val == "true";
+        } while (j.eat(','));                                      // other keys are ignored
+        if (!j.eat('}')) { r.error = "bad JSON"; return false; }
+    }
+    if (!r.cancel && !has_prompt) { r.error = "missing \"prompt\""; return false; }
+    return true;
+}
+
+// Readers (stdin, or one thread per socket connection) parse lines and hand
+// them to the scheduler thread, which does all decoding and all writing.
+struct ServeInbox {
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<ServeRequest> q;
+    int producers = 0;                                              // readers (and the socket acceptor) still running
+
+    void push(ServeRequest && r) { { std::lock_guard<std::mutex> lk(m); q.push_back(std::move(r)); } cv.notify_one(); }
+    void open()  { std::lock_guard<std::mutex> lk(m); ++producers; }
+    void close() { { std::lock_guard<std::mutex> lk(m); --producers; } cv.notify_one(); }
+};
+
+static void serve_read(FILE * in, std::shared_ptr<ServeClient> client, ServeInbox * inbox) {
+    std::string line;
+    char buf[4096];
+    int n = 0;
+    for (;;) {
+        line.clear();
+        while (std::fgets(buf, sizeof(buf), in)) { line += buf; if (line.back() == '\n') break; }
+        if (line.empty()) break;                                    // EOF
+        if (line.find_first_not_of(" \t\r\n") == std::string::npos) continue;
+        ServeRequest r;
+        r.client = client;
+        parse_request(line, r);
+        if (r.id.empty()) r.id = std::to_string(++n);
+        inbox->push(std::move(r));
+    }
+    if (in != stdin) std::fclose(in);
+    inbox->close();
+}
+
+#if !defined(_WIN32)
+static bool serve_listen(const char * path, ServeInbox & inbox) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (std::strlen(path) >= sizeof(addr.sun_path)) { std::fprintf(stderr, "socket path too long: %s\n", path); return false; }
+    std::strcpy(addr.sun_path, path);
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ::unlink(path);                                                 // a stale socket from an earlier run
+    if (fd < 0 || ::bind(fd, (const sockaddr *)&addr, sizeof(addr)) != 0 || ::listen(fd, 16) != 0) {
+        std::perror(path);
+        if (fd >= 0) ::close(fd);
+        return false;
+    }
+    inbox.open();                                                   // never closed: serve until a signal
+    std::thread([fd, &inbox] {
+        for (;;) {
+            const int c = ::accept(fd, nullptr, nullptr);
+            if (c < 0) { if (errno == EINTR || errno == ECONNABORTED) continue; break; }
+            FILE * out = fdopen(c, "w");
+            const int rd = out ? ::dup(c) : -1;
+            FILE * in = rd >= 0 ? fdopen(rd, "r") : nullptr;
+            if (!in) {
+                if (rd >= 0) ::close(rd);
+                if (out) std::fclose(out); else ::close(c);
+                continue;
+            }
+            inbox.open();
+            std::thread(serve_read, in, std::make_shared<ServeClient>(out), &inbox).detach();
+        }
+    }).detach();
+    return true;
+}
+#endif
+
+static volatile std::sig_atomic_t g_serve_stop = 0;
+static void on_serve_signal(int) { g_serve_stop = 1; }
+
+static int serve_main(int argc, char ** argv) {
+    const char * model_path  = kDefaultModel;
+    const char * socket_path = nullptr;
+    int slots = 4, n_ctx = 4096, n_batch = 512, max_tokens = 128;
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    bool verbose = false;
+    for (int i = 1; i < argc; ++i) {
+        const char * a = argv[i];
+        auto next = [&]{ if (i + 1 >= argc) { std::fprintf(stderr, "%s needs a value\n", a); std::exit(2); } return argv[++i]; };
+        if      (!std::strcmp(a, "--serve"))      {}
+        else if (!std::strcmp(a, "--model"))      model_path  = next();
+        else if (!std::strcmp(a, "--slots"))      slots       = std::atoi(next());
+        else if (!std::strcmp(a, "--ctx"))        n_ctx       = std::atoi(next());
+        else if (!std::strcmp(a, "--batch"))      n_batch     = std::atoi(next());
+        else if (!std::strcmp(a, "--threads"))    threads     = std::atoi(next());
+        else if (!std::strcmp(a, "--max-tokens")) max_tokens  = std::atoi(next());
+        else if (!std::strcmp(a, "--socket"))     socket_path = next();
+        else if (!std::strcmp(a, "--verbose"))    verbose     = true;
+        else { std::fprintf(stderr, "unknown option %s\n", a); return 2; }
+    }
+    if (slots <= 0 || n_ctx / std::max(slots, 1) < 16 || n_batch <= 0 || threads <= 0 || max_tokens <= 0) {
+        std::fprintf(stderr, "bad --slots/--ctx/--batch/--threads/--max-tokens\n"); return 2;
+    }
+#if defined(_WIN32)
+    if (socket_path) { std::fprintf(stderr, "--socket needs a POSIX system; use stdin\n"); return 2; }
+#else
+    std::signal(SIGPIPE, SIG_IGN);                                  // a client that hangs up only fails its writes
+#endif
+    n_batch = std::max(n_batch, slots);                             // every generating slot fits in one step
+
+    if (!verbose) llama_log_set(quiet_log, nullptr);
+    llama_backend_init();
+    llama_model * model = llama_model_load_from_file(model_path, llama_model_default_params());
+    if (!model) { std::fprintf(stderr, "Failed to load model: %s\n", model_path); llama_backend_free(); return 1; }
+    llama_context_params cp = llama_context_default_params();
+    cp.n_ctx           = (uint32_t)n_ctx;
+    cp.n_batch         = (uint32_t)n_batch;
+    cp.n_ubatch        = (uint32_t)n_batch;
+    cp.n_seq_max       = (uint32_t)slots;
+    cp.n_threads       = threads;
+    cp.n_threads_batch = threads;
+    llama_context * ctx = llama_init_from_model(model, cp);
+    if (!ctx) { std::fprintf(stderr, "Failed to create context\n"); llama_model_free(model); llama_backend_free(); return 1; }
+
+    ServeInbox & inbox = *new ServeInbox;                           // outlives the detached reader threads
+#if !defined(_WIN32)
+    if (socket_path && !serve_listen(socket_path, inbox)) { llama_free(ctx); llama_model_free(model); llama_backend_free(); return 1; }
+#endif
+    if (!socket_path) {
+        inbox.open();
+        std::thread(serve_read, stdin, std::make_shared<ServeClient>(stdout), &inbox).detach();
+    }
+    std::signal(SIGINT,  on_serve_signal);
+    std::signal(SIGTERM, on_serve_signal);
+    std::fprintf(stderr, "[serve] %d slots x %d tokens, batch %d, %d threads, requests on %s\n",
+                 slots, n_ctx / slots, n_batch, threads, socket_path ? socket_path : "stdin");
+
+    const auto t0 = std::chrono::steady_clock::now();
+    {
+        BatchServer server(ctx, llama_model_get_vocab(model), slots, n_ctx / slots);
+        std::deque<ServeRequest> pending, in;
+        while (!g_serve_stop) {
+            bool more;
+            {
+                std::unique_lock<std::mutex> lk(inbox.m);
+                if (server.idle() && pending.empty())               // nothing running: sleep until a request
+                    inbox.cv.wait_for(lk, std::chrono::milliseconds(200), [&]{ return !inbox.q.empty() || inbox.producers == 0; });
+                in.swap(inbox.q);
+                more = inbox.producers > 0;
+            }
+            for (ServeRequest & r : in) {
+                if (!r.error.empty()) { reply_error(r, r.error); continue; }
+                if (r.cancel) {
+                    if (server.cancel(r.client.get(), r.id)) continue;
+                    auto it = std::find_if(pending.begin(), pending.end(),
+                                           [&](const ServeRequest & p){ return p.client == r.client && p.id == r.id; });
+                    if (it == pending.end()) { reply_error(r, "no such request"); continue; }
+                    r.client->send("{\"id\":\"" + json_escape(r.id) + "\",\"done\":true,\"reason\":\"cancelled\",\"tokens\":0}\n");
+                    pending.erase(it);
+                    continue;
+                }
+                if (r.max_tokens <= 0) r.max_tokens = max_tokens;
+                pending.push_back(std::move(r));
+            }
+            in.clear();
+            while (!pending.empty() && server.has_free_slot()) { server.start(std::move(pending.front())); pending.pop_front(); }
+            if (!server.step() && pending.empty() && !more) break;
+        }
+
+        const ServeStats & st = server.stats();
+        const double sec = ms_since(t0) * 1e-3;
+        std::fprintf(stderr, "[serve] %llu requests, %llu prompt + %llu generated tokens in %.1f s: %.1f generated tok/s, %.1f tokens per decode\n",
+                     (unsigned long long)st.requests, (unsigned long long)st.prompt_tokens, (unsigned long long)st.gen_tokens, sec,
+                     sec > 0 ? st.gen_tokens / sec : 0.0, st.decodes ? (double)st.batch_tokens / st.decodes : 0.0);
+    }
+#if !defined(_WIN32)
+    if (socket_path) ::unlink(socket_path);
+#endif
+    llama_free(ctx);
+    llama_model_free(model);
+    llama_backend_free();
+    return 0;
+}
+
+/*──────────────────── One-shot chat ───────────────────*/
 int main(int argc, char **argv) {
-    const char * user_text  = (argc > 1) ? argv[1] : "Say hi in one sentence.";
-    const char * model_path = (argc > 2) ? argv[2] : "models/tinyllama-1.1b-chat-v1.0.Q4_K_M.gguf";
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--bench")) return bench_main(argc, argv);
+        if (!std::strcmp(argv[i], "--serve")) return serve_main(argc, argv);
+    }
+
+    const char * user_text  = "Say hi in one sentence.";
+    const char * model_path = kDefaultModel;
+    const char * cache_dir  = ".kvcache";
+    const char * draft_path = nullptr;
+    int draft_max = 8;
+    for (int i = 1, positional = 0; i < argc; ++i) {
+        if      (!std::strcmp(argv[i], "--prefix-cache") && i + 1 < argc) cache_dir = argv[++i];
+        else if (!std::strcmp(argv[i], "--no-prefix-cache"))              cache_dir = nullptr;
+        else if (!std::strcmp(argv[i], "--draft") && i + 1 < argc)        draft_path = argv[++i];
+        else if (!std::strcmp(argv[i], "--draft-max") && i + 1 < argc)    draft_max = std::max(1, std::atoi(argv[++i]));
+        else if (positional++ == 0) user_text  = argv[i];
+        else                        model_path = argv[i];
+    }
 
     // 1) backend
     llama_backend_init();
@@ -68,9 +1088,7 @@ int main(int argc, char **argv) {
     }
 
     // 4) simple, template-free prompt
-    std::string prompt;
-    prompt += "You are a concise, helpful assistant.\n";
-    prompt += "User: ";
+    std::string prompt = kPreamble;
     prompt += user_text;
     prompt += "\nAssistant:";
 
@@ -86,18 +1104,28 @@ int main(int argc, char **argv) {
         return 1;
     }
 
-    // 6) feed prompt
-    llama_batch batch = llama_batch_init((int)toks.size(), /*embd*/0, /*n_seq_max*/1);
-    for (int i = 0; i < (int)toks.size(); ++i) {
-        batch.token[i]     = toks[i];
-        batch.pos[i]       = i;
-        batch.seq_id[i][0] = 0;
-        batch.n_seq_id[i]  = 1;
-        batch.logits[i]    = (i == (int)toks.size() - 1);
+    // 6) feed prompt; the preamble's KV state comes from the prefix cache if it can.
+    // Only the leading tokens the preamble and the full prompt share are
+    // cached: a tokenizer may merge the preamble's trailing space into the user text.
+    const auto t_prompt = std::chrono::steady_clock::now();
+    KvPrefixCache cache(cache_dir ? cache_dir : "");
+    std::vector<llama_token> pre;
+    int n_prefix = 0;
+    if (cache_dir && cache.setModel(model_path, model) && tokenize_text(vocab, kPreamble, pre, true, false)) {
+        const int lim = std::min((int)pre.size(), (int)toks.size() - 1);   // one token left to produce logits
+        while (n_prefix < lim && pre[n_prefix] == toks[n_prefix]) ++n_prefix;
     }
-    batch.n_tokens = (int)toks.size();
-
-    if (llama_decode(ctx, batch) != 0) {
+    const int cap = std::min((int)toks.size(), (int)cp.n_batch);
+    llama_batch batch = llama_batch_init(cap, /*embd*/0, /*n_seq_max*/1);
+    const bool prefix_hit = n_prefix > 0 && cache.restore(ctx, 0, toks.data(), n_prefix);
+    bool ok = true;
+    if (n_prefix > 0 && !prefix_hit) {
+        ok = decode_tokens(ctx, batch, cap, toks.data(), n_prefix, 0, /*logits_last=*/false);
+        if (ok) cache.store(ctx, 0, toks.data(), n_prefix);
+    }
+    ok = ok && decode_tokens(ctx, batch, cap, toks.data() + n_prefix, (int)toks.size() - n_prefix, n_prefix,
+                             /*logits_last=*/true);
+    if (!ok) {
         std::fprintf(stderr, "decode failed (prompt)\n");
         llama_batch_free(batch);
         llama_free(ctx);
@@ -123,19 +1151,36 @@ int main(int argc, char **argv) {
 
     const llama_token tok_eos = llama_vocab_eos(vocab);
 
+    // 7b) optional draft model: same prompt, its own context
+    llama_model *   dmodel = nullptr;
+    llama_context * dctx   = nullptr;
+    if (draft_path) {
+        dmodel = llama_model_load_from_file(draft_path, mp);
+        const char * err = !dmodel ? "failed to load" : !draft_compatible(model, dmodel) ? "has a different vocabulary" : nullptr;
+        if (!err && !(dctx = llama_init_from_model(dmodel, cp))) err = "context failed";
+        if (!err && !decode_tokens(dctx, batch, cap, toks.data(), (int)toks.size(), 0, /*logits_last=*/false)) err = "decode failed (prompt)";
+        if (err) {
+            std::fprintf(stderr, "draft model %s: %s\n", draft_path, err);
+            if (dctx) llama_free(dctx);
+            if (dmodel) llama_model_free(dmodel);
+            llama_sampler_free(smpl);
+            llama_batch_free(batch);
+            llama_free(ctx);
+            llama_model_free(model);
+            llama_backend_free();
+            return 1;
+        }
+    }
+
     // 8) generation: reuse a 1-token batch (no get_one)
     llama_batch next = llama_batch_init(/*n_tokens=*/1, /*embd=*/0, /*n_seq_max=*/1);
 
     const int max_new_tokens = 128;
     int n_past = (int)toks.size();
+    double ttft_ms = 0.0;
 
-    std::printf("\n[Model output]: ");
-    for (int t = 0; t < max_new_tokens; ++t) {
-        const llama_token id = llama_sampler_sample(smpl, ctx, /*idx_last*/-1);
-        llama_sampler_accept(smpl, id);
-        if (id == tok_eos) break;
-
-        // print piece (use a roomy buffer)
+    // print piece (use a roomy buffer)
+    auto print_piece = [&](llama_token id) {
         char piece[1024];
         const int wrote = llama_token_to_piece(vocab, id, piece, (int)sizeof(piece),
                                                /*lstrip=*/0, /*special=*/true);
@@ -143,14 +1188,47 @@ int main(int argc, char **argv) {
             std::fwrite(piece, 1, wrote, stdout);
             std::fflush(stdout);
         }
+    };
+
+    std::printf("\n[Model output]: ");
+    const auto t_gen = std::chrono::steady_clock::now();
+    int n_gen = 0;
+    if (dctx) {
+        // 8b) speculative: every round emits the target's tokens for one verify decode
+        SpecDecoder spec(ctx, dctx, smpl, (int)toks.size(), draft_max);
+        std::vector<llama_token> run;
+        bool eos = false;
+        while (n_gen < max_new_tokens && !eos) {
+            run.clear();
+            if (!spec.next(run, max_new_tokens - n_gen)) {
+                std::fprintf(stderr, "\ndecode failed (generation)\n");
+                break;
+            }
+            for (const llama_token id : run) {
+                if (n_gen++ == 0) ttft_ms = ms_since(t_prompt);
+                llama_sampler_accept(smpl, id);
+                if ((eos = id == tok_eos)) break;
+                print_piece(id);
+            }
+        }
+        std::printf("\n");
+        const SpecStats & ss = spec.stats();
+        const double gen_s = ms_since(t_gen) * 1e-3;
+        std::fprintf(stderr, "[spec] %d drafted, %d accepted (%.0f%%), %.2f tokens per target decode, %.1f tok/s; "
+                             "draft %.0f ms, verify %.0f ms\n",
+                     ss.drafted, ss.accepted, ss.drafted ? 100.0 * ss.accepted / ss.drafted : 0.0,
+                     ss.rounds ? (double)(n_gen - 1) / ss.rounds : 0.0, gen_s > 0 ? n_gen / gen_s : 0.0,
+                     ss.draft_ms, ss.verify_ms);
+    }
+    for (int t = 0; t < max_new_tokens && !dctx; ++t) {
+        const llama_token id = llama_sampler_sample(smpl, ctx, /*idx_last*/-1);
+        if (t == 0) ttft_ms = ms_since(t_prompt);
+        llama_sampler_accept(smpl, id);
+        if (id == tok_eos) break;
+        print_piece(id);
 
         // fill "next" batch explicitly
-        next.n_tokens      = 1;
-        next.token[0]      = id;
-        next.pos[0]        = n_past;
-        next.seq_id[0][0]  = 0;
-        next.n_seq_id[0]   = 1;
-        next.logits[0]     = true;
+        fill_batch(next, &id, 1, n_past, /*logits_last=*/true);
 
         if (llama_decode(ctx, next) != 0) {
             std::fprintf(stderr, "\ndecode failed (generation)\n");
@@ -158,9 +1236,19 @@ int main(int argc, char **argv) {
         }
         ++n_past;
     }
-    std::printf("\n");
+    if (!dctx) std::printf("\n");
+
+    const KvPrefixStats & ks = cache.stats();
+    if (prefix_hit)
+        std::fprintf(stderr, "[prefix] restored %d tokens (%.1f KB) in %.2f ms\n", n_prefix, ks.lastBytes / 1024.0, ks.lastRestoreMs);
+    else if (ks.stores)
+        std::fprintf(stderr, "[prefix] decoded and cached %d tokens (%.1f KB, %.2f ms to save)\n", n_prefix, ks.lastBytes / 1024.0, ks.lastStoreMs);
+    std::fprintf(stderr, "[ttft] %.1f ms for %d prompt tokens (%d decoded)\n", ttft_ms, (int)toks.size(),
+                 (int)toks.size() - (prefix_hit ? n_prefix : 0));
 
     // 9) cleanup
+    if (dctx) llama_free(dctx);
+    if (dmodel) llama_model_free(dmodel);
     llama_batch_free(next);
     llama_sampler_free(smpl);
     llama_batch_free(batch);
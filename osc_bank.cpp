@@ -0,0 +1,305 @@
+#include "osc_bank.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+  #define OSC_X86 1
+  #include <immintrin.h>
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+  #define OSC_NEON 1
+  #include <arm_neon.h>
+#endif
+
+#if defined(OSC_X86) && defined(__GNUC__)
+  #define OSC_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+  #define OSC_TARGET_AVX2
+#endif
+
+static constexpr int      kFracBits  = 32 - OscBank::kTableBits;
+static constexpr uint32_t kFracMask  = (1u << kFracBits) - 1u;
+static constexpr float    kFracScale = 1.0f / (float)(1u << kFracBits);
+static constexpr float    kLevel0Max = 40.0f;   // top fundamental of mip level 0
+
+/*──────────────────── Kernels ───────────────────*/
+// Mix one voice into out[0..n): table lookup with linear interpolation and a
+// linear gain ramp g0 + dg*i. Phase wraps naturally in 32 bits.
+using OscKernel = void (*)(const float* tab, uint32_t phase, uint32_t inc,
+                           float g0, float dg, float* out, int n);
+
+static void kernel_scalar(const float* tab, uint32_t ph, uint32_t inc,
+                          float g, float dg, float* out, int n){
+    for (int i=0;i<n;++i) {
+        const uint32_t idx = ph >> kFracBits;
+        const float    f   = (float)(ph & kFracMask) * kFracScale;
+        const float    a   = tab[idx];
+        out[i] += g * (a + f * (tab[idx+1] - a));
+        ph += inc; g += dg;
+    }
+}
+
+#if defined(OSC_X86)
+static void kernel_sse2(const float* tab, uint32_t ph, uint32_t inc,
+                        float g0, float dg, float* out, int n){
+    __m128i p   = _mm_setr_epi32((int)ph, (int)(ph+inc), (int)(ph+2*inc), (int)(ph+3*inc));
+    const __m128i pstep = _mm_set1_epi32((int)(4*inc));
+    const __m128i fmask = _mm_set1_epi32((int)kFracMask);
+    const __m128  fscl  = _mm_set1_ps(kFracScale);
+    __m128 g = _mm_setr_ps(g0, g0+dg, g0+2*dg, g0+3*dg);
+    const __m128 gstep = _mm_set1_ps(4*dg);
+    alignas(16) int32_t idx[4];
+    int i=0;
+    for (; i+4<=n; i+=4) {
+        _mm_store_si128((__m128i*)idx, _mm_srli_epi32(p, kFracBits));
+        const __m128 a = _mm_setr_ps(tab[idx[0]],   tab[idx[1]],   tab[idx[2]],   tab[idx[3]]);
+        const __m128 b = _mm_setr_ps(tab[idx[0]+1], tab[idx[1]+1], tab[idx[2]+1], tab[idx[3]+1]);
+        const __m128 f = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(p, fmask)), fscl);
+        const __m128 s = _mm_add_ps(a, _mm_mul_ps(f, _mm_sub_ps(b, a)));
+        _mm_storeu_ps(out+i, _mm_add_ps(_mm_loadu_ps(out+i), _mm_mul_ps(s, g)));
+        p = _mm_add_epi32(p, pstep); g = _mm_add_ps(g, gstep);
+    }
+    if (i<n) kernel_scalar(tab, ph + inc*(uint32_t)i, inc, g0 + dg*(float)i, dg, out+i, n-i);
+}
+
+OSC_TARGET_AVX2
+static void kernel_avx2(const float* tab, uint32_t ph, uint32_t inc,
+                        float g0, float dg, float* out, int n){
+    const __m256i lane  = _mm256_setr_epi32(0,1,2,3,4,5,6,7);
+    __m256i p = _mm256_add_epi32(_mm256_set1_epi32((int)ph),
+                                 _mm256_mullo_epi32(lane, _mm256_set1_epi32((int)inc)));
+    const __m256i pstep = _mm256_set1_epi32((int)(8*inc));
+    const __m256i fmask = _mm256_set1_epi32((int)kFracMask);
+    const __m256  fscl  = _mm256_set1_ps(kFracScale);
+    __m256 g = _mm256_fmadd_ps(_mm256_cvtepi32_ps(lane), _mm256_set1_ps(dg), _mm256_set1_ps(g0));
+    const __m256 gstep = _mm256_set1_ps(8*dg);
+    int i=0;
+    for (; i+8<=n; i+=8) {
+        const __m256i idx = _mm256_srli_epi32(p, kFracBits);
+        const __m256  a = _mm256_i32gather_ps(tab,   idx, 4);
+        const __m256  b = _mm256_i32gather_ps(tab+1, idx, 4);
+        const __m256  f = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(p, fmask)), fscl);
+        const __m256  s = _mm256_fmadd_ps(f, _mm256_sub_ps(b, a), a);
+        _mm256_storeu_ps(out+i, _mm256_fmadd_ps(s, g, _mm256_loadu_ps(out+i)));
+        p = _mm256_add_epi32(p, pstep); g = _mm256_add_ps(g, gstep);
+    }
+    if (i<n) kernel_scalar(tab, ph + inc*(uint32_t)i, inc, g0 + dg*(float)i, dg, out+i, n-i);
+}
+#endif
+
+#if defined(OSC_NEON)
+static void kernel_neon(const float* tab, uint32_t ph, uint32_t inc,
+                        float g0, float dg, float* out, int n){
+    const uint32_t p0[4] = { ph, ph+inc, ph+2*inc, ph+3*inc };
+    const float    g0v[4]= { g0, g0+dg, g0+2*dg, g0+3*dg };
+    uint32x4_t p = vld1q_u32(p0);
+    const uint32x4_t pstep = vdupq_n_u32(4*inc);
+    const uint32x4_t fmask = vdupq_n_u32(kFracMask);
+    float32x4_t g = vld1q_f32(g0v);
+    const float32x4_t gstep = vdupq_n_f32(4*dg);
+    uint32_t idx[4];
+    int i=0;
+    for (; i+4<=n; i+=4) {
+        vst1q_u32(idx, vshrq_n_u32(p, kFracBits));
+        float32x4_t a = vdupq_n_f32(0.0f), b = vdupq_n_f32(0.0f);
+        a = vld1q_lane_f32(tab+idx[0], a, 0); b = vld1q_lane_f32(tab+idx[0]+1, b, 0);
+        a = vld1q_lane_f32(tab+idx[1], a, 1); b = vld1q_lane_f32(tab+idx[1]+1, b, 1);
+        a = vld1q_lane_f32(tab+idx[2], a, 2); b = vld1q_lane_f32(tab+idx[2]+1, b, 2);
+        a = vld1q_lane_f32(tab+idx[3], a, 3); b = vld1q_lane_f32(tab+idx[3]+1, b, 3);
+        const float32x4_t f = vmulq_n_f32(vcvtq_f32_u32(vandq_u32(p, fmask)), kFracScale);
+        const float32x4_t s = vmlaq_f32(a, f, vsubq_f32(b, a));
+        vst1q_f32(out+i, vmlaq_f32(vld1q_f32(out+i), s, g));
+        p = vaddq_u32(p, pstep); g = vaddq_f32(g, gstep);
+    }
+    if (i<n) kernel_scalar(tab, ph + inc*(uint32_t)i, inc, g0 + dg*(float)i, dg, out+i, n-i);
+}
+#endif
+
+/*──────────────────── Runtime dispatch ───────────────────*/
+struct IsaEntry { const char* name; OscKernel fn; bool (*supported)(); };
+
+static bool always(){ return true; }
+#if defined(OSC_X86)
+static bool has_avx2(){
+  #if defined(__GNUC__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  #else
+    return false;
+  #endif
+}
+#endif
+
+// best first
+static const IsaEntry kIsas[] = {
+#if defined(OSC_X86)
+    { "avx2",   kernel_avx2,   has_avx2 },
+    { "sse2",   kernel_sse2,   always   },
+#endif
+#if defined(OSC_NEON)
+    { "neon",   kernel_neon,   always   },
+#endif
+    { "scalar", kernel_scalar, always   },
+};
+
+static const IsaEntry* pickIsa(){
+    if (const char* env = std::getenv("SINE_OSC_ISA"))
+        for (const IsaEntry& e : kIsas)
+            if (!std::strcmp(e.name, env) && e.supported()) return &e;
+    for (const IsaEntry& e : kIsas) if (e.supported()) return &e;
+    return &kIsas[sizeof(kIsas)/sizeof(kIsas[0]) - 1];
+}
+
+static const IsaEntry* gIsa = pickIsa();
+
+bool OscBank::setIsa(const char* name){
+    for (const IsaEntry& e : kIsas)
+        if (!std::strcmp(e.name, name)) {
+            if (!e.supported()) return false;
+            gIsa = &e; return true;
+        }
+    return false;
+}
+
+const char* OscBank::isa(){ return gIsa->name; }
+
+/*──────────────────── Wavetables ───────────────────*/
+// Harmonic k amplitude of each waveform's Fourier series (0 = absent).
+static double harmonic(OscWave w, int k){
+    switch (w) {
+    case OscWave_Sine:     return k==1 ? 1.0 : 0.0;
+    case OscWave_Saw:      return ((k&1) ? 2.0 : -2.0) / (M_PI*k);
+    case OscWave_Square:   return (k&1) ? 4.0 / (M_PI*k) : 0.0;
+    case OscWave_Triangle: return (k&1) ? (((k>>1)&1) ? -8.0 : 8.0) / (M_PI*M_PI*k*k) : 0.0;
+    default:               return 0.0;
+    }
+}
+
+static float levelTop(int level){ return kLevel0Max * (float)(1 << level); }
+
+OscBank::OscBank(double sampleRate)
+    : sr_(sampleRate),
+      fadeStep_((float)(1.0 / (0.005 * sampleRate))),   // 5 ms full-scale attack/release
+      tables_((size_t)OscWave_COUNT * kLevels * (kTableSize+1)) {
+    // Build top level first, then add harmonics going down so each partial
+    // is summed once per wave. Level l keeps partials below Nyquist for
+    // fundamentals up to levelTop(l).
+    std::vector<double> acc(kTableSize);
+    const double nyq = 0.5 * sampleRate;
+    for (int w=0; w<OscWave_COUNT; ++w) {
+        std::fill(acc.begin(), acc.end(), 0.0);
+        int have = 0;
+        for (int l=kLevels-1; l>=0; --l) {
+            const int want = std::clamp((int)(nyq / levelTop(l)), 1, kTableSize/2 - 1);
+            for (int k=have+1; k<=want; ++k) {
+                const double a = harmonic((OscWave)w, k);
+                if (a == 0.0) continue;
+                // rotate a phasor instead of calling sin per sample
+                const double dc = std::cos(2*M_PI*k/kTableSize), ds = std::sin(2*M_PI*k/kTableSize);
+                double c = 1.0, s = 0.0;
+                for (int i=0;i<kTableSize;++i) {
+                    acc[i] += a * s;
+                    const double nc = c*dc - s*ds; s = s*dc + c*ds; c = nc;
+                }
+            }
+            have = std::max(have, want);
+
+            double peak = 1e-9;
+            for (double v : acc) peak = std::max(peak, std::fabs(v));
+            float* t = &tables_[((size_t)w*kLevels + l) * (kTableSize+1)];
+            for (int i=0;i<kTableSize;++i) t[i] = (float)(acc[i] / peak);
+            t[kTableSize] = t[0];
+        }
+    }
+
+    for (int v=0; v<kMaxVoices; ++v) {
+        phase_[v]=inc_[v]=0; gain_[v]=target_[v]=0.0f; tab_[v]=nullptr;
+        id_[v]=-1; age_[v]=0; state_[v]=Free; pos_[v]=-1;
+        free_[v] = kMaxVoices-1-v;
+    }
+    nFree_ = kMaxVoices;
+}
+
+const float* OscBank::table(OscWave wave, float freq) const {
+    int l = 0;
+    while (l < kLevels-1 && freq > levelTop(l)) ++l;
+    return &tables_[((size_t)std::min<int>(wave, OscWave_COUNT-1)*kLevels + l) * (kTableSize+1)];
+}
+
+/*──────────────────── Voices ───────────────────*/
+int OscBank::allocVoice(){
+    if (nFree_ > 0) {
+        const int slot = free_[--nFree_];
+        pos_[slot] = nActive_; active_[nActive_++] = slot;
+        return slot;
+    }
+    // steal: quietest releasing voice, else the oldest
+    int best=-1; float bestGain=2.0f;
+    for (int i=0;i<nActive_;++i) {
+        const int s = active_[i];
+        if (state_[s]==Releasing && gain_[s] < bestGain) { best=s; bestGain=gain_[s]; }
+    }
+    if (best < 0) {
+        uint32_t oldest = 0;
+        for (int i=0;i<nActive_;++i) {
+            const int s = active_[i];
+            const uint32_t a = clock_ - age_[s];
+            if (best < 0 || a > oldest) { best=s; oldest=a; }
+        }
+    }
+    return best;
+}
+
+void OscBank::freeVoice(int slot){
+    const int p = pos_[slot], last = active_[--nActive_];
+    active_[p] = last; pos_[last] = p;
+    pos_[slot] = -1; state_[slot] = Free; id_[slot] = -1; gain_[slot] = 0.0f;
+    free_[nFree_++] = slot;
+}
+
+void OscBank::noteOn(int32_t id, float freq, float amp, OscWave wave){
+    freq = std::clamp(freq, 0.0f, (float)(0.5*sr_));
+    int slot = -1;
+    for (int i=0;i<nActive_;++i) if (id_[active_[i]]==id) { slot=active_[i]; break; }
+    if (slot < 0) {
+        slot = allocVoice();
+        if (slot < 0) return;
+        if (state_[slot]==Free) { phase_[slot]=0; gain_[slot]=0.0f; }  // stolen voices glide from their current gain
+    }
+    inc_[slot]    = (uint32_t)std::llround((double)freq / sr_ * 4294967296.0);
+    tab_[slot]    = table(wave, freq);
+    target_[slot] = std::clamp(amp, 0.0f, 1.0f);
+    id_[slot]     = id;
+    age_[slot]    = clock_++;
+    state_[slot]  = On;
+}
+
+void OscBank::noteOff(int32_t id){
+    for (int i=0;i<nActive_;++i) {
+        const int s = active_[i];
+        if (id_[s]==id && state_[s]==On) { target_[s]=0.0f; state_[s]=Releasing; }
+    }
+}
+
+void OscBank::allOff(){
+    for (int i=0;i<nActive_;++i) { const int s=active_[i]; target_[s]=0.0f; state_[s]=Releasing; }
+}
+
+void OscBank::render(float* out, int frames){
+    if (frames <= 0) return;
+    const OscKernel k = gIsa->fn;
+    const float maxMove = fadeStep_ * (float)frames;
+    for (int i=0;i<nActive_;) {
+        const int s = active_[i];
+        const float g0 = gain_[s];
+        const float g1 = g0 + std::clamp(target_[s]-g0, -maxMove, maxMove);
+        if (g0 > 0.0f || g1 > 0.0f)
+            k(tab_[s], phase_[s], inc_[s], g0, (g1-g0)/(float)frames, out, frames);
+        phase_[s] += inc_[s] * (uint32_t)frames;
+        gain_[s] = g1;
+        if (state_[s]==Releasing && g1 <= 0.0f) { freeVoice(s); continue; }  // slot i now holds another voice
+        ++i;
+    }
+}
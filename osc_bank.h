@@ -0,0 +1,74 @@
+#pragma once
+// Polyphonic wavetable oscillator bank.
+// Voices live in structure-of-arrays form; each voice reads a band-limited,
+// per-octave mip-mapped wavetable through a 32-bit phase accumulator.
+// The inner loop (phase, lookup, interpolation, gain ramp) runs 8/4 samples
+// at a time with AVX2, SSE2 or NEON, picked at runtime; a scalar kernel is
+// always available as fallback.
+//
+// All methods run on the audio thread except the static ISA helpers.
+
+#include <cstdint>
+#include <vector>
+
+enum OscWave : uint8_t {
+    OscWave_Sine,
+    OscWave_Saw,
+    OscWave_Square,
+    OscWave_Triangle,
+    OscWave_COUNT
+};
+
+class OscBank {
+public:
+    static constexpr int kMaxVoices = 512;
+    static constexpr int kTableBits = 11;
+    static constexpr int kTableSize = 1 << kTableBits;
+    static constexpr int kLevels    = 10;     // octaves, 40 Hz .. 20.48 kHz
+
+    explicit OscBank(double sampleRate);
+
+    // (re)start voice `id`; steals the quietest/oldest voice when full
+    void noteOn (int32_t id, float freq, float amp, OscWave wave);
+    void noteOff(int32_t id);
+    void allOff();
+
+    // mix all active voices into out[0..frames)
+    void render(float* out, int frames);
+
+    int activeVoices() const { return nActive_; }
+
+    // Band-limited table for (wave, freq); guard sample at [kTableSize].
+    const float* table(OscWave wave, float freq) const;
+
+    // Kernel selection. `name` is one of "avx2", "sse2", "neon", "scalar";
+    // returns false if unsupported on this CPU. Not thread-safe against render().
+    static bool        setIsa(const char* name);
+    static const char* isa();
+
+private:
+    enum : uint8_t { Free, On, Releasing };
+
+    int  allocVoice();
+    void freeVoice(int slot);
+
+    double sr_;
+    float  fadeStep_;       // max gain change per sample (attack/release slope)
+    std::vector<float> tables_;   // [wave][level][kTableSize+1]
+
+    // per-voice state, structure-of-arrays
+    uint32_t     phase_ [kMaxVoices];
+    uint32_t     inc_   [kMaxVoices];
+    float        gain_  [kMaxVoices];
+    float        target_[kMaxVoices];
+    const float* tab_   [kMaxVoices];
+    int32_t      id_    [kMaxVoices];
+    uint32_t     age_   [kMaxVoices];
+    uint8_t      state_ [kMaxVoices];
+
+    int      active_[kMaxVoices];   // dense list of non-free slots
+    int      pos_   [kMaxVoices];   // slot -> index in active_
+    int      free_  [kMaxVoices];   // stack of free slots
+    int      nActive_ = 0, nFree_ = 0;
+    uint32_t clock_ = 0;            // monotonic note-on counter for stealing
+};
@@ -0,0 +1,251 @@
+#ifndef IMGUI_DEFINE_MATH_OPERATORS
+#define IMGUI_DEFINE_MATH_OPERATORS
+#endif
+#include "profiler.h"
+
+#if SINE_PROFILER
+#include "imgui.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+constexpr int kHistory  = 120;    // frames kept
+constexpr int kMaxZones = 128;    // CPU zones per frame
+constexpr int kMaxDepth = 32;
+constexpr int kMaxGpu   = 8;      // GPU passes per frame
+constexpr int kGpuLag   = 4;      // frames a query may stay in flight
+
+struct Zone    { char name[28]; int depth; int64_t begin, end; };
+struct GpuZone { char name[28]; int64_t ns; };          // -1: pending, -2: dropped
+
+struct Frame {
+    uint64_t index = 0;
+    int64_t  begin = 0, end = 0;
+    int      zones = 0, gpus = 0;
+    Zone     zone[kMaxZones];
+    GpuZone  gpu[kMaxGpu];
+};
+
+struct GpuSlot { GLuint query[kMaxGpu] = {}; int used = 0; uint64_t frame = 0; };
+
+Frame    gFrames[kHistory];
+uint64_t gIndex = 0;              // frame being recorded (0 = none yet)
+bool     gOpen = false, gPaused = false, gPauseReq = false;
+int      gStack[kMaxDepth], gDepth = 0;
+GpuSlot  gGpu[kGpuLag];
+bool     gGpuActive = false;
+uint64_t gGpuDropped = 0;
+
+int64_t nowNs(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+Frame& cur(){ return gFrames[gIndex % kHistory]; }
+void copyName(char (&dst)[28], const char* s){
+    std::strncpy(dst, s ? s : "?", sizeof(dst) - 1); dst[sizeof(dst) - 1] = 0;
+}
+
+// Reads every finished query; never blocks.
+void harvestGpu(){
+    for (GpuSlot& s : gGpu) {
+        if (!s.used) continue;
+        Frame& f = gFrames[s.frame % kHistory];
+        int done = 0;
+        for (int i=0;i<s.used;++i) {
+            if (f.index == s.frame && f.gpu[i].ns >= 0) { ++done; continue; }
+            GLint avail = 0;
+            glGetQueryObjectiv(s.query[i], GL_QUERY_RESULT_AVAILABLE, &avail);
+            if (!avail) continue;
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(s.query[i], GL_QUERY_RESULT, &ns);
+            if (f.index == s.frame) f.gpu[i].ns = (int64_t)ns;
+            ++done;
+        }
+        if (done == s.used) s.used = 0;
+    }
+}
+
+} // namespace
+
+void profSetPaused(bool p){ gPauseReq = p; }
+
+void profFrameBegin(){
+    gPaused = gPauseReq;
+    if (gPaused) return;
+    ++gIndex;
+    Frame& f = cur();
+    f.index = gIndex; f.begin = nowNs(); f.end = 0; f.zones = 0; f.gpus = 0;
+    gDepth = 0; gOpen = true;
+
+    GpuSlot& s = gGpu[gIndex % kGpuLag];
+    if (s.used) {                                                   // still in flight after kGpuLag frames
+        Frame& old = gFrames[s.frame % kHistory];
+        for (int i=0;i<s.used;++i) if (old.index == s.frame && old.gpu[i].ns == -1) { old.gpu[i].ns = -2; ++gGpuDropped; }
+        s.used = 0;
+    }
+    s.frame = gIndex;
+    if (!s.query[0]) glGenQueries(kMaxGpu, s.query);
+}
+
+void profFrameEnd(){
+    if (!gOpen) return;
+    const int64_t t = nowNs();
+    Frame& f = cur();
+    while (gDepth > 0)                                               // unbalanced Lua zones
+        if (--gDepth < kMaxDepth && gStack[gDepth] >= 0) f.zone[gStack[gDepth]].end = t;
+    if (gGpuActive) { glEndQuery(GL_TIME_ELAPSED); gGpuActive = false; }
+    f.end = t;
+    gOpen = false;
+    harvestGpu();
+}
+
+void profBegin(const char* name){
+    if (!gOpen) return;
+    if (gDepth >= kMaxDepth) { ++gDepth; return; }                  // tracked for balance only
+    Frame& f = cur();
+    int idx = -1;
+    if (f.zones < kMaxZones) {
+        Zone& z = f.zone[f.zones];
+        copyName(z.name, name);
+        z.depth = gDepth; z.begin = nowNs(); z.end = 0;
+        idx = f.zones++;
+    }
+    gStack[gDepth++] = idx;
+}
+
+void profEnd(){
+    if (!gOpen || gDepth == 0) return;
+    if (--gDepth >= kMaxDepth) return;
+    const int idx = gStack[gDepth];
+    if (idx >= 0) cur().zone[idx].end = nowNs();
+}
+
+void profGpuBegin(const char* name){
+    if (!gOpen || gGpuActive) return;
+    GpuSlot& s = gGpu[gIndex % kGpuLag];
+    Frame& f = cur();
+    if (s.used >= kMaxGpu) return;
+    copyName(f.gpu[f.gpus].name, name);
+    f.gpu[f.gpus].ns = -1;
+    glBeginQuery(GL_TIME_ELAPSED, s.query[s.used]);
+    ++s.used; ++f.gpus;
+    gGpuActive = true;
+}
+
+void profGpuEnd(){
+    if (!gGpuActive) return;
+    glEndQuery(GL_TIME_ELAPSED);
+    gGpuActive = false;
+}
+
+/*──────────────────── Window ───────────────────*/
+static ImU32 zoneColor(const char* s){
+    uint32_t h = 2166136261u;
+    for (; *s; ++s) { h ^= (unsigned char)*s; h *= 16777619u; }
+    return ImColor::HSV((float)(h % 360) / 360.0f, 0.55f, 0.75f);
+}
+
+void profilerWindow(){
+    ImGui::SetNextWindowSize(ImVec2(560, 420), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Profiler")) { ImGui::End(); return; }
+
+    static int back = 0;
+    bool paused = gPauseReq;
+    if (ImGui::Checkbox("Pause", &paused)) profSetPaused(paused);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(160);
+    ImGui::SliderInt("frames back", &back, 0, kHistory - 2);
+    ImGui::SameLine();
+    ImGui::Text("gpu dropped %llu", (unsigned long long)gGpuDropped);
+
+    // frame-time graph, oldest .. newest completed frame
+    const uint64_t last = gOpen ? gIndex - 1 : gIndex;
+    float ms[kHistory]; int n = 0; float peak = 1.0f;
+    for (int i=kHistory-1; i>=0; --i) {
+        if (last < (uint64_t)i + 1) continue;
+        const Frame& f = gFrames[(last - (uint64_t)i) % kHistory];
+        if (f.index != last - (uint64_t)i || !f.end) continue;
+        ms[n] = (float)(f.end - f.begin) * 1e-6f; peak = std::max(peak, ms[n]); ++n;
+    }
+    if (n == 0 || last <= (uint64_t)back) { ImGui::TextUnformatted("(no frames yet)"); ImGui::End(); return; }
+    char over[32]; std::snprintf(over, sizeof(over), "%.2f ms", n ? ms[n-1] : 0.0f);
+    ImGui::PlotHistogram("##frames", ms, n, 0, over, 0.0f, peak, ImVec2(-1, 60));
+
+    const Frame& f = gFrames[(last - (uint64_t)back) % kHistory];
+    if (f.index != last - (uint64_t)back || !f.end) { ImGui::End(); return; }
+    const double frameNs = (double)std::max<int64_t>(1, f.end - f.begin);
+    ImGui::Text("frame %llu: %.3f ms CPU", (unsigned long long)f.index, frameNs * 1e-6);
+
+    // timeline: one row per depth, bars scaled to the frame
+    int maxDepth = 0;
+    for (int i=0;i<f.zones;++i) maxDepth = std::max(maxDepth, f.zone[i].depth);
+    const float rowH = ImGui::GetTextLineHeight() + 4.0f;
+    const ImVec2 p0 = ImGui::GetCursorScreenPos();
+    const float  W  = std::max(8.0f, ImGui::GetContentRegionAvail().x);
+    const ImVec2 size(W, rowH * (float)(maxDepth + 1));
+    ImGui::InvisibleButton("##timeline", size);
+    ImDrawList* dl = ImGui::GetWindowDrawList();
+    dl->AddRectFilled(p0, p0 + size, ImGui::GetColorU32(ImGuiCol_FrameBg));
+    const ImVec2 mouse = ImGui::GetIO().MousePos;
+    for (int i=0;i<f.zones;++i) {
+        const Zone& z = f.zone[i];
+        const int64_t e = z.end ? z.end : f.end;
+        const float x0 = p0.x + (float)((double)(z.begin - f.begin) / frameNs) * W;
+        const float x1 = std::max(x0 + 1.0f, p0.x + (float)((double)(e - f.begin) / frameNs) * W);
+        const float y0 = p0.y + rowH * (float)z.depth, y1 = y0 + rowH - 1.0f;
+        dl->AddRectFilled(ImVec2(x0, y0), ImVec2(x1, y1), zoneColor(z.name));
+        if (x1 - x0 > 24.0f) {
+            dl->PushClipRect(ImVec2(x0, y0), ImVec2(x1, y1), true);
+            dl->AddText(ImVec2(x0 + 2.0f, y0 + 2.0f), IM_COL32(0,0,0,255), z.name);
+            dl->PopClipRect();
+        }
+        if (ImGui::IsItemHovered() && mouse.x >= x0 && mouse.x < x1 && mouse.y >= y0 && mouse.y < y1)
+            ImGui::SetTooltip("%s\n%.3f ms", z.name, (double)(e - z.begin) * 1e-6);
+    }
+
+    // GPU passes of the same frame
+    for (int i=0;i<f.gpus;++i) {
+        if (f.gpu[i].ns >= 0) ImGui::Text("GPU %-20s %8.3f ms", f.gpu[i].name, (double)f.gpu[i].ns * 1e-6);
+        else                  ImGui::Text("GPU %-20s %10s", f.gpu[i].name, f.gpu[i].ns == -1 ? "pending" : "dropped");
+    }
+
+    // per-zone totals over the whole history; ms/frame counts every frame, so
+    // zones entered several times per frame (or only in some) weigh what they cost
+    struct Agg { const char* name; double sum, peak; int calls; };
+    static Agg agg[64]; int na = 0, frames = 0;
+    for (int h=0; h<kHistory; ++h) {
+        const Frame& g = gFrames[h];
+        if (!g.end || g.index == 0) continue;
+        ++frames;
+        for (int i=0;i<g.zones;++i) {
+            const Zone& z = g.zone[i];
+            const double zms = (double)((z.end ? z.end : g.end) - z.begin) * 1e-6;
+            int k = 0;
+            while (k < na && std::strcmp(agg[k].name, z.name)) ++k;
+            if (k == na) { if (na == 64) continue; agg[na++] = Agg{ z.name, 0.0, 0.0, 0 }; }
+            agg[k].sum += zms; agg[k].peak = std::max(agg[k].peak, zms); ++agg[k].calls;
+        }
+    }
+    if (na && ImGui::BeginTable("##zones", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp)) {
+        ImGui::TableSetupColumn("zone"); ImGui::TableSetupColumn("ms/frame"); ImGui::TableSetupColumn("ms/call");
+        ImGui::TableSetupColumn("max ms"); ImGui::TableSetupColumn("calls");
+        ImGui::TableHeadersRow();
+        for (int k=0;k<na;++k) {
+            ImGui::TableNextColumn(); ImGui::TextUnformatted(agg[k].name);
+            ImGui::TableNextColumn(); ImGui::Text("%.3f", agg[k].sum / frames);
+            ImGui::TableNextColumn(); ImGui::Text("%.3f", agg[k].sum / agg[k].calls);
+            ImGui::TableNextColumn(); ImGui::Text("%.3f", agg[k].peak);
+            ImGui::TableNextColumn(); ImGui::Text("%d", agg[k].calls);
+        }
+        ImGui::EndTable();
+    }
+    ImGui::End();
+}
+
+#endif // SINE_PROFILER
@@ -0,0 +1,55 @@
+#pragma once
+// Lightweight hierarchical frame profiler for the UI/render thread.
+//
+// CPU zones nest (PROF_SCOPE, or prof_begin/prof_end from Lua) and are kept
+// for the last kHistory frames. GPU passes are timed with GL_TIME_ELAPSED
+// queries from a ring kGpuLag frames deep; results are collected once they
+// are available and dropped if they are not by the time the ring wraps, so
+// the CPU never waits on the GPU. GL timer queries cannot nest: a GPU scope
+// opened inside another is ignored.
+//
+// Build with SINE_PROFILER=0 (CMake: -DSINE_DEMO_PROFILER=OFF, the default
+// for Release) and every call below becomes an empty inline.
+//
+// All functions must be called on the thread that owns the GL context.
+
+#include <cstdint>
+
+#ifndef SINE_PROFILER
+#define SINE_PROFILER 1
+#endif
+
+#if SINE_PROFILER
+
+void profFrameBegin();
+void profFrameEnd();
+void profBegin(const char* name);     // name is copied (truncated to 27 chars)
+void profEnd();
+void profGpuBegin(const char* name);
+void profGpuEnd();
+void profSetPaused(bool paused);
+void profilerWindow();                // ImGui window: frame graph, timeline, zone table
+
+struct ProfScope    { explicit ProfScope(const char* n){ profBegin(n); }    ~ProfScope(){ profEnd(); } };
+struct ProfGpuScope { explicit ProfGpuScope(const char* n){ profGpuBegin(n); } ~ProfGpuScope(){ profGpuEnd(); } };
+
+#define PROF_CAT2(a, b) a##b
+#define PROF_CAT(a, b)  PROF_CAT2(a, b)
+#define PROF_SCOPE(name)     ProfScope    PROF_CAT(prof_scope_, __LINE__)(name)
+#define PROF_GPU_SCOPE(name) ProfGpuScope PROF_CAT(prof_gpu_,   __LINE__)(name)
+
+#else
+
+inline void profFrameBegin() {}
+inline void profFrameEnd() {}
+inline void profBegin(const char*) {}
+inline void profEnd() {}
+inline void profGpuBegin(const char*) {}
+inline void profGpuEnd() {}
+inline void profSetPaused(bool) {}
+inline void profilerWindow() {}
+
+#define PROF_SCOPE(name)     ((void)0)
+#define PROF_GPU_SCOPE(name) ((void)0)
+
+#endif
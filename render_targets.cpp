@@ -0,0 +1,142 @@
+#include "render_targets.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+
+RenderTargetPool gRenderTargets;
+
+RenderTargetPool::~RenderTargetPool(){
+    // GL may already be gone at static destruction; callers clear() while the
+    // context is current. Just forget the names here.
+    entries_.clear();
+}
+
+int RenderTargetPool::sizeClass(int px){
+    if (px <= kMinClass) return kMinClass;
+    int p = kMinClass;
+    while (p < px) p *= 2;
+    return (p / 4 * 3 >= px) ? p / 4 * 3 : p;
+}
+
+RenderTargetPool::Entry* RenderTargetPool::find(uint32_t key){
+    for (auto& e : entries_) if (e->keyed && e->key == key) return e.get();
+    return nullptr;
+}
+
+void RenderTargetPool::create(RenderTarget& t, int w, int h){
+    t = RenderTarget{};
+    glGenTextures(1, &t.tex);
+    glBindTexture(GL_TEXTURE_2D, t.tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);   // sub-rects are sampled
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenFramebuffers(1, &t.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, t.fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, t.tex, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    t.w = w; t.h = h;
+    bytes_ += bytesOf(t); ++allocs_;
+}
+
+void RenderTargetPool::destroy(RenderTarget& t){
+    if (t.fbo) glDeleteFramebuffers(1, &t.fbo);
+    if (t.tex) glDeleteTextures(1, &t.tex);
+    bytes_ -= bytesOf(t);
+    t = RenderTarget{};
+}
+
+void RenderTargetPool::storage(Entry& e, int cw, int ch){
+    for (auto& s : entries_)
+        if (!s->keyed && s->rt.w == cw && s->rt.h == ch) { // exact spare: swap storage
+            std::swap(s->rt, e.rt);
+            s->lastUsed = frame_;
+            e.rt.stamp = 0;
+            return;
+        }
+    auto spare = std::make_unique<Entry>();                // old storage becomes a spare
+    spare->lastUsed = frame_; spare->rt = e.rt;
+    create(e.rt, cw, ch);
+    entries_.push_back(std::move(spare));
+}
+
+RenderTarget* RenderTargetPool::acquire(uint32_t key, int w, int h){
+    w = std::max(1, w); h = std::max(1, h);
+    const int cw = sizeClass(w), ch = sizeClass(h);
+
+    Entry* e = find(key);
+    while (e && e->lastUsed == frame_) {                 // same key twice this frame
+        key = key * 0x9E3779B1u + 1u;
+        e = find(key);
+    }
+
+    if (!e) {
+        // adopt the smallest spare that fits, else allocate
+        Entry* best = nullptr;
+        for (auto& s : entries_)
+            if (!s->keyed && s->rt.w >= cw && s->rt.h >= ch && (!best || bytesOf(s->rt) < bytesOf(best->rt))) best = s.get();
+        if (!best) {
+            entries_.push_back(std::make_unique<Entry>());
+            best = entries_.back().get();
+            create(best->rt, cw, ch);
+        }
+        best->keyed = true; best->key = key; best->oversized = 0; best->rt.stamp = 0;
+        e = best;
+    }
+    if (e->rt.w < cw || e->rt.h < ch) {
+        storage(*e, std::max(cw, e->rt.w), std::max(ch, e->rt.h));
+        e->oversized = 0;
+    } else if (e->rt.w > cw || e->rt.h > ch) {
+        if (++e->oversized > kShrinkFrames) {
+            storage(*e, cw, ch);
+            e->oversized = 0; ++shrinks_;
+        }
+    } else {
+        e->oversized = 0;
+    }
+    e->lastUsed = frame_;
+    e->rt.usedW = w; e->rt.usedH = h;
+    return &e->rt;
+}
+
+void RenderTargetPool::endFrame(){
+    auto drop = [&](size_t i){
+        destroy(entries_[i]->rt);
+        entries_[i] = std::move(entries_.back()); entries_.pop_back();
+        ++evictions_;
+    };
+    for (size_t i=0; i<entries_.size();)
+        if (frame_ - entries_[i]->lastUsed > kIdleFrames) drop(i); else ++i;
+
+    while (bytes_ > budget_) {
+        // least recently used, spares before keyed targets, never this frame's
+        size_t victim = entries_.size();
+        for (size_t i=0; i<entries_.size(); ++i) {
+            const Entry& c = *entries_[i];
+            if (c.lastUsed == frame_ && c.keyed) continue;
+            if (victim == entries_.size()) { victim = i; continue; }
+            const Entry& v = *entries_[victim];
+            if (c.keyed != v.keyed ? !c.keyed : c.lastUsed < v.lastUsed) victim = i;
+        }
+        if (victim == entries_.size()) break;
+        drop(victim);
+    }
+    ++frame_;
+}
+
+RenderTargetStats RenderTargetPool::stats() const {
+    RenderTargetStats s;
+    for (const auto& e : entries_) (e->keyed ? s.targets : s.spares)++;
+    s.bytes = bytes_; s.budget = budget_;
+    s.allocs = allocs_; s.evictions = evictions_; s.shrinks = shrinks_;
+    return s;
+}
+
+void RenderTargetPool::clear(){
+    for (auto& e : entries_) destroy(e->rt);
+    entries_.clear();
+}
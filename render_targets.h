@@ -0,0 +1,76 @@
+#pragma once
+// Pool of offscreen GL colour targets keyed by ImGui ID, so several GL views
+// (torus instances, future shaders) can coexist in one frame.
+//
+// Targets are allocated in size classes and recycled between keys. A key
+// whose target stays oversized for kShrinkFrames moves to a smaller one.
+// After each frame, targets not used that frame are evicted least recently
+// used first until the pool fits its VRAM budget; unkeyed spares go first.
+// Targets drawn this frame are never evicted, even over budget. Anything
+// unused for kIdleFrames is released regardless of the budget.
+//
+// UI/render thread only; requires a current GL 3.3 context.
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct RenderTarget {
+    unsigned fbo = 0, tex = 0;   // GL names
+    int      w = 0, h = 0;       // allocated size (a size class)
+    int      usedW = 0, usedH = 0;
+    uint64_t stamp = 0;          // owner's content key; reset to 0 when the storage changes
+};
+
+struct RenderTargetStats {
+    int      targets = 0, spares = 0;
+    size_t   bytes = 0, budget = 0;
+    uint64_t allocs = 0, evictions = 0, shrinks = 0;
+};
+
+class RenderTargetPool {
+public:
+    static constexpr int kMinClass     = 64;
+    static constexpr int kShrinkFrames = 120;   // ~2 s oversized before shrinking
+    static constexpr int kIdleFrames   = 600;   // ~10 s unused before release
+
+    explicit RenderTargetPool(size_t budgetBytes = 64u << 20) : budget_(budgetBytes) {}
+    ~RenderTargetPool();
+
+    // Target for `key` with at least w*h pixels. A key acquired twice in
+    // one frame gets a distinct target for the second call. Never null;
+    // valid until endFrame().
+    RenderTarget* acquire(uint32_t key, int w, int h);
+
+    // Call once per frame after the draw data has been rendered.
+    void endFrame();
+
+    void   setBudget(size_t bytes) { budget_ = bytes; }
+    size_t budget() const { return budget_; }
+    RenderTargetStats stats() const;
+    void   clear();                              // releases all GL objects
+
+    static int sizeClass(int px);                // 64, 96, 128, 192, 256, 384, ...
+
+private:
+    struct Entry {
+        uint32_t key = 0;
+        bool     keyed = false;
+        int      lastUsed = -1;
+        int      oversized = 0;                  // consecutive frames with a smaller class needed
+        RenderTarget rt;
+    };
+    static size_t bytesOf(const RenderTarget& t) { return (size_t)t.w * (size_t)t.h * 4; }
+    Entry* find(uint32_t key);
+    void   create(RenderTarget& t, int w, int h);
+    void   destroy(RenderTarget& t);
+    void   storage(Entry& e, int cw, int ch);    // swap e's storage for a cw*ch target
+
+    std::vector<std::unique_ptr<Entry>> entries_;   // boxed: acquired pointers stay valid
+    size_t   budget_, bytes_ = 0;
+    int      frame_ = 0;
+    uint64_t allocs_ = 0, evictions_ = 0, shrinks_ = 0;
+};
+
+extern RenderTargetPool gRenderTargets;
@@ -0,0 +1,107 @@
+#ifndef IMGUI_DEFINE_MATH_OPERATORS
+#define IMGUI_DEFINE_MATH_OPERATORS
+#endif
+#include "scope.h"
+#include "profiler.h"
+#include "imgui.h"
+
+#include <algorithm>
+
+/*──────────────────── Ring (writer) ───────────────────*/
+void ScopeRing::write(const float* x, unsigned long n){
+    const auto r = std::memory_order_relaxed;
+    uint64_t w = written_.load(r);
+    for (unsigned long i=0;i<n;++i,++w) {
+        const float v = x[i];
+        raw_[w & (kSize-1)].store(v, r);
+        lo1_ = std::min(lo1_, v); hi1_ = std::max(hi1_, v);
+        if (((w+1) & (kL1-1)) == 0) {
+            MinMax& m1 = l1_[(w / kL1) & (kSize/kL1 - 1)];
+            m1.lo.store(lo1_, r); m1.hi.store(hi1_, r);
+            lo2_ = std::min(lo2_, lo1_); hi2_ = std::max(hi2_, hi1_);
+            lo1_ = 1e30f; hi1_ = -1e30f;
+            if (((w+1) & (kL2-1)) == 0) {
+                MinMax& m2 = l2_[(w / kL2) & (kSize/kL2 - 1)];
+                m2.lo.store(lo2_, r); m2.hi.store(hi2_, r);
+                lo2_ = 1e30f; hi2_ = -1e30f;
+            }
+        }
+    }
+    written_.store(w, std::memory_order_release);
+}
+
+/*──────────────────── Ring (readers) ───────────────────*/
+void ScopeRing::minmax(uint64_t b, uint64_t e, float& lo, float& hi) const {
+    const auto r = std::memory_order_relaxed;
+    lo = 1e30f; hi = -1e30f;
+    for (uint64_t i=b; i<e;) {
+        if ((i & (kL2-1))==0 && i+kL2 <= e) {
+            const MinMax& m = l2_[(i / kL2) & (kSize/kL2 - 1)];
+            lo = std::min(lo, m.lo.load(r)); hi = std::max(hi, m.hi.load(r)); i += kL2;
+        } else if ((i & (kL1-1))==0 && i+kL1 <= e) {
+            const MinMax& m = l1_[(i / kL1) & (kSize/kL1 - 1)];
+            lo = std::min(lo, m.lo.load(r)); hi = std::max(hi, m.hi.load(r)); i += kL1;
+        } else {
+            const float v = at(i);
+            lo = std::min(lo, v); hi = std::max(hi, v); ++i;
+        }
+    }
+}
+
+uint64_t ScopeRing::trigger(uint64_t end, int maxBack, float level) const {
+    const uint64_t stop = std::max<uint64_t>(oldest() + 1, end > (uint64_t)maxBack ? end - (uint64_t)maxBack : 1);
+    for (uint64_t i=end; i>=stop; --i)
+        if (at(i-1) < level && at(i) >= level) return i;
+    return end;
+}
+
+/*──────────────────── Drawing ───────────────────*/
+int drawScope(const char* id, const ScopeRing& ring, const ScopeView& view){
+    PROF_SCOPE("scope");
+    const ImVec2 size(std::max(8.0f, ImGui::GetContentRegionAvail().x), std::max(8.0f, view.height));
+    const ImVec2 p0 = ImGui::GetCursorScreenPos(), p1 = p0 + size;
+    ImGui::InvisibleButton(id, size);
+
+    ImDrawList* dl = ImGui::GetWindowDrawList();
+    dl->AddRectFilled(p0, p1, ImGui::GetColorU32(ImGuiCol_FrameBg), ImGui::GetStyle().FrameRounding);
+
+    const float yspan = view.yMax - view.yMin;
+    auto ymap = [&](float v){
+        const float t = std::clamp((v - view.yMin) / (yspan != 0.0f ? yspan : 1.0f), 0.0f, 1.0f);
+        return p1.y - t * size.y;
+    };
+    dl->AddLine(ImVec2(p0.x, ymap(0.0f)), ImVec2(p1.x, ymap(0.0f)), ImGui::GetColorU32(ImGuiCol_Border));
+
+    const uint64_t head = ring.written(), first = ring.oldest();
+    const uint64_t avail = head - first;
+    uint64_t W = (uint64_t)std::clamp(view.window, 2, ScopeRing::kSize - ScopeRing::kGuard);
+    W = std::min(W, avail);
+    if (W < 2) return 0;
+
+    // Short windows start on the latest rising zero crossing that still
+    // leaves a full window of data; long windows simply roll.
+    uint64_t start = head - W;
+    if (view.trigger && W <= 16384 && start > first) {
+        const int back = (int)std::min<uint64_t>(std::max<uint64_t>(W, 2048), start - first);
+        start = ring.trigger(start, back);
+    }
+
+    const ImU32 col = ImGui::GetColorU32(ImGuiCol_PlotLines);
+    const int   P   = std::max(1, (int)size.x);
+    if (W <= (uint64_t)(2*P)) {
+        // few samples per pixel: plain polyline, read straight from the ring
+        const float dx = size.x / (float)(W - 1);
+        for (uint64_t i=0;i<W;++i) dl->PathLineTo(ImVec2(p0.x + dx*(float)i, ymap(ring.at(start+i))));
+        dl->PathStroke(col, 0, 1.0f);
+    } else {
+        // one min/max bar per pixel column, served from the LOD levels
+        for (int c=0;c<P;++c) {
+            const uint64_t b = start + W*(uint64_t)c/(uint64_t)P, e = start + W*(uint64_t)(c+1)/(uint64_t)P;
+            if (e <= b) continue;
+            float lo, hi; ring.minmax(b, e, lo, hi);
+            const float x = p0.x + (float)c;
+            dl->AddRectFilled(ImVec2(x, ymap(hi)), ImVec2(x + 1.0f, ymap(lo) + 1.0f), col);
+        }
+    }
+    return (int)W;
+}
@@ -0,0 +1,57 @@
+#pragma once
+// Oscilloscope capture: the audio thread appends its output to a lock-free
+// single-writer ring; the UI reads the ring in place (no copy).
+// Alongside the raw samples the writer keeps two min/max LOD levels
+// (per 32 and per 1024 samples), so a multi-second window is drawn in
+// O(pixels) instead of O(samples).
+
+#include <atomic>
+#include <cstdint>
+
+class ScopeRing {
+public:
+    static constexpr int kBits  = 18;                 // 262144 samples, ~5.4 s at 48 kHz
+    static constexpr int kSize  = 1 << kBits;
+    static constexpr int kL1    = 32;                 // samples per level-1 min/max entry
+    static constexpr int kL2    = 1024;               // samples per level-2 min/max entry
+    static constexpr int kGuard = 16384;              // never read this close to being overwritten
+
+    // audio thread (single writer)
+    void write(const float* x, unsigned long n);
+
+    // reader threads
+    uint64_t written() const { return written_.load(std::memory_order_acquire); }
+    float    at(uint64_t i) const { return raw_[i & (kSize-1)].load(std::memory_order_relaxed); }
+    // min/max over absolute sample range [b, e); e <= written()
+    void     minmax(uint64_t b, uint64_t e, float& lo, float& hi) const;
+    // Latest rising crossing of `level` in (end-maxBack, end]; returns end if none.
+    uint64_t trigger(uint64_t end, int maxBack, float level = 0.0f) const;
+    // oldest sample index that is safe to read now
+    uint64_t oldest() const {
+        const uint64_t w = written();
+        return w > (uint64_t)(kSize - kGuard) ? w - (uint64_t)(kSize - kGuard) : 0;
+    }
+
+private:
+    struct MinMax { std::atomic<float> lo{0}, hi{0}; };
+
+    std::atomic<float> raw_[kSize] = {};
+    MinMax l1_[kSize / kL1];
+    MinMax l2_[kSize / kL2];
+    std::atomic<uint64_t> written_{0};
+
+    // writer-only partial block accumulators
+    float lo1_ =  1e30f, hi1_ = -1e30f;
+    float lo2_ =  1e30f, hi2_ = -1e30f;
+};
+
+struct ScopeView {
+    int   window  = 1024;   // samples shown
+    float height  = 120.0f;
+    float yMin    = -1.0f, yMax = 1.0f;
+    bool  trigger = true;   // align short windows to a rising zero crossing
+};
+
+// Draws the newest `view.window` samples into the current ImGui window.
+// Returns the number of samples actually shown.
+int drawScope(const char* id, const ScopeRing& ring, const ScopeView& view);
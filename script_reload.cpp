@@ -0,0 +1,246 @@
+#include "script_reload.h"
+#include "frame_sched.h"
+#include "util.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+extern "C" {
+#include <lauxlib.h>
+}
+#if __has_include(<luajit.h>)
+extern "C" {
+#include <luajit.h>
+}
+#endif
+
+#if defined(__linux__)
+  #include <cerrno>
+  #include <poll.h>
+  #include <sys/inotify.h>
+  #include <unistd.h>
+#elif defined(_WIN32)
+  #include <direct.h>
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+void splitPath(const std::string& path, std::string& dir, std::string& base){
+    const size_t s = path.find_last_of("/\\");
+    dir  = s == std::string::npos ? "." : path.substr(0, s);
+    base = s == std::string::npos ? path : path.substr(s + 1);
+}
+
+// Bytecode is only valid for the VM that wrote it.
+#if defined(LUAJIT_VERSION)
+constexpr const char* kVmVersion = LUAJIT_VERSION;
+#else
+constexpr const char* kVmVersion = LUA_RELEASE;
+#endif
+
+uint64_t fnv64(uint64_t h, const void* p, size_t n){
+    const unsigned char* b = static_cast<const unsigned char*>(p);
+    for (size_t i=0;i<n;++i) { h ^= b[i]; h *= 1099511628211ull; }
+    return h;
+}
+uint64_t sourceKey(const std::string& src){
+    uint64_t h = fnv64(14695981039346656037ull, src.data(), src.size());
+    h = fnv64(h, kVmVersion, std::strlen(kVmVersion));
+    const uint32_t ptr = (uint32_t)sizeof(void*);
+    return fnv64(h, &ptr, sizeof(ptr));
+}
+
+struct CacheHeader { char magic[4]; uint32_t version; uint64_t key; };
+constexpr char     kMagic[4]     = { 'S', 'L', 'B', 'C' };
+constexpr uint32_t kCacheVersion = 1;
+
+int appendChunk(lua_State*, const void* p, size_t n, void* ud){
+    static_cast<std::string*>(ud)->append(static_cast<const char*>(p), n);
+    return 0;
+}
+
+// Writes the function on top of the stack; a failure only costs the next cold start.
+void writeCache(lua_State* L, const std::string& path, uint64_t key){
+    std::string out;
+    const CacheHeader h{ { kMagic[0], kMagic[1], kMagic[2], kMagic[3] }, kCacheVersion, key };
+    out.append(reinterpret_cast<const char*>(&h), sizeof(h));
+#if LUA_VERSION_NUM >= 503
+    if (lua_dump(L, appendChunk, &out, 0) != 0) return;
+#else
+    if (lua_dump(L, appendChunk, &out) != 0) return;
+#endif
+    std::string dir, base; splitPath(path, dir, base);
+#if defined(_WIN32)
+    _mkdir(dir.c_str());
+#else
+    mkdir(dir.c_str(), 0755);
+#endif
+    const std::string tmp = path + ".tmp";
+    FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) return;
+    const bool ok = std::fwrite(out.data(), 1, out.size(), f) == out.size();
+    if (std::fclose(f) != 0 || !ok) { std::remove(tmp.c_str()); return; }
+#if defined(_WIN32)
+    std::remove(path.c_str());
+#endif
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) std::remove(tmp.c_str());
+}
+
+} // namespace
+
+/*──────────────────── Loading ───────────────────*/
+std::string ScriptReloader::cachePath() const {
+    std::string dir, base; splitPath(path_, dir, base);
+    return dir + "/.luacache/" + base + ".bc";
+}
+
+// Leaves the compiled chunk on the stack, or the error message on failure.
+bool ScriptReloader::compile(lua_State* L, const std::string& src, ScriptLoadInfo& info){
+    const std::string chunk = "@" + path_;
+    const uint64_t key = sourceKey(src);
+    const Clock::time_point t0 = Clock::now();
+    if (cache_) {
+        std::string bc;
+        CacheHeader h{};
+        if (readFile(cachePath(), bc) && bc.size() > sizeof(h)) {
+            std::memcpy(&h, bc.data(), sizeof(h));
+            if (!std::memcmp(h.magic, kMagic, 4) && h.version == kCacheVersion && h.key == key) {
+                if (luaL_loadbuffer(L, bc.data() + sizeof(h), bc.size() - sizeof(h), chunk.c_str()) == LUA_OK) {
+                    info.cacheHit = true; info.compileMs = msSince(t0);
+                    return true;
+                }
+                lua_pop(L,1);                               // unreadable: fall back to the source
+            }
+        }
+    }
+    if (luaL_loadbuffer(L, src.data(), src.size(), chunk.c_str()) != LUA_OK) return false;
+    info.compileMs = msSince(t0);
+    if (cache_) writeCache(L, cachePath(), key);
+    return true;
+}
+
+bool ScriptReloader::load(lua_State* L){
+    dirty_.store(false, std::memory_order_relaxed);        // a write from now on triggers another reload
+    ScriptLoadInfo info;
+    const Clock::time_point t0 = Clock::now();
+    std::string src;
+    if (!readFile(path_, src)) {
+        std::fprintf(stderr, "[Lua] cannot read %s\n", path_.c_str());
+        last_ = info; return false;
+    }
+    info.sourceBytes = src.size();
+    info.readMs = msSince(t0);
+
+    const int top = lua_gettop(L);
+    if (!compile(L, src, info)) {
+        std::fprintf(stderr, "[Lua] %s (keeping the previous script)\n", lua_tostring(L,-1));
+        lua_settop(L, top); last_ = info; return false;
+    }
+    const int chunk = top + 1;
+
+    // the running script's entry points, restored if the new chunk fails
+    static const char* const kHooks[] = { "draw_ui", "save_state", "load_state" };
+    for (const char* h : kHooks) lua_getglobal(L, h);
+    const int saved = chunk + 1, state = chunk + 4;
+
+    lua_getglobal(L, "save_state");
+    if (lua_isfunction(L,-1)) {
+        if (lua_pcall(L,0,1,0) != LUA_OK) {
+            std::fprintf(stderr, "[Lua] save_state: %s\n", lua_tostring(L,-1));
+            lua_pop(L,1); lua_pushnil(L);
+        }
+    } else { lua_pop(L,1); lua_pushnil(L); }
+
+    const Clock::time_point t1 = Clock::now();
+    lua_pushvalue(L, chunk);
+    if (lua_pcall(L,0,0,0) != LUA_OK) {
+        std::fprintf(stderr, "[Lua] %s (keeping the previous script)\n", lua_tostring(L,-1));
+        for (int i=0;i<3;++i) { lua_pushvalue(L, saved + i); lua_setglobal(L, kHooks[i]); }
+        lua_settop(L, top); last_ = info; return false;
+    }
+    info.runMs = msSince(t1);
+
+    if (!lua_isnil(L, state)) {
+        lua_getglobal(L, "load_state");
+        if (lua_isfunction(L,-1)) {
+            lua_pushvalue(L, state);
+            if (lua_pcall(L,1,0,0) != LUA_OK) { std::fprintf(stderr, "[Lua] load_state: %s\n", lua_tostring(L,-1)); lua_pop(L,1); }
+        } else { lua_pop(L,1); }
+    }
+    lua_settop(L, top);
+    info.ok = true;
+    last_ = info;
+    return true;
+}
+
+/*──────────────────── Watcher ───────────────────*/
+void ScriptReloader::startWatching(){
+    if (th_.joinable()) return;
+    quit_ = false;
+#if defined(__linux__)
+    if (pipe(wakeFd_) != 0) wakeFd_[0] = wakeFd_[1] = -1;
+#endif
+    th_ = std::thread(&ScriptReloader::watch, this);
+}
+
+void ScriptReloader::stopWatching(){
+    if (!th_.joinable()) return;
+    { std::lock_guard<std::mutex> lk(m_); quit_ = true; }
+    cv_.notify_all();
+#if defined(__linux__)
+    if (wakeFd_[1] >= 0) { const char c = 0; (void)!write(wakeFd_[1], &c, 1); }
+#endif
+    th_.join();
+#if defined(__linux__)
+    for (int& fd : wakeFd_) if (fd >= 0) { close(fd); fd = -1; }
+#endif
+}
+
+void ScriptReloader::watch(){
+    auto changed = [this]{ dirty_.store(true, std::memory_order_relaxed); gFrameSched.request(1); };
+    std::string dir, base; splitPath(path_, dir, base);
+
+#if defined(__linux__)
+    // Editors either rewrite the file (IN_CLOSE_WRITE) or save a temp file and
+    // rename it over the original (IN_MOVED_TO), so watch the directory.
+    const int fd = wakeFd_[0] >= 0 ? inotify_init1(IN_NONBLOCK | IN_CLOEXEC) : -1;
+    if (fd >= 0 && inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) >= 0) {
+        alignas(inotify_event) char buf[4096];
+        for (;;) {
+            pollfd p[2] = { { fd, POLLIN, 0 }, { wakeFd_[0], POLLIN, 0 } };
+            if (poll(p, 2, -1) < 0) { if (errno == EINTR) continue; break; }
+            if (p[1].revents) break;
+            bool hit = false;
+            ssize_t n;
+            while ((n = read(fd, buf, sizeof(buf))) > 0) {
+                for (char* e = buf; e < buf + n; ) {
+                    const inotify_event* ev = reinterpret_cast<const inotify_event*>(e);
+                    if (ev->len && base == ev->name) hit = true;
+                    e += sizeof(inotify_event) + ev->len;
+                }
+            }
+            if (hit) changed();
+        }
+        close(fd);
+        return;
+    }
+    if (fd >= 0) close(fd);
+    std::fprintf(stderr, "[reload] inotify unavailable for %s, polling instead\n", dir.c_str());
+#endif
+
+    // portable fallback: stat() twice a second on this thread, never in the frame
+    auto stamp = [this]{
+        struct stat st{};
+        return stat(path_.c_str(), &st) == 0 ? (int64_t)st.st_mtime * 1000003 + (int64_t)st.st_size : (int64_t)-1;
+    };
+    int64_t last = stamp();
+    std::unique_lock<std::mutex> lk(m_);
+    while (!cv_.wait_for(lk, std::chrono::milliseconds(500), [this]{ return quit_; })) {
+        const int64_t now = stamp();
+        if (now != last) { last = now; changed(); }
+    }
+}
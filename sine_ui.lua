@@ -4,72 +4,345 @@
 local amp     = 1.0
 local freq    = 440.0
 local samples = 512
+local scope_ms = 2000.0
+local chord   = false
+local chord_ratios = { 1.0, 1.25, 1.5, 2.0 }   -- major triad + octave, voice ids 1..4
+local chord_freq   = nil                        -- root the playing chord was sent with
+local stats  = {}   -- refilled in place by audio_stats/alloc_stats: no per-frame garbage
+local allocs = {}
+local loop   = {}
+local uit    = {}
 
 -- torus state
 local yaw, pitch = 0.0, 0.0
 local R, r       = 0.75, 0.25
 local rainbow    = 0.25  -- speed
+local budget_ms  = 0.0   -- adaptive torus quality: torus render-cost budget, 0 = off
+local rt         = {}    -- render-target pool stats, refilled in place
+local tcpu       = {}    -- CPU raymarcher stats, refilled in place
+local views      = { { id = "front", dyaw = 0.0,     dpitch = 0.0 },
+                     { id = "side",  dyaw = math.pi/2, dpitch = 0.0 },
+                     { id = "top",   dyaw = 0.0,     dpitch = math.pi/2 } }
 local knob_size  = 56.0
 local variants   = { "Tick","Dot","Wiper","WiperOnly","WiperDot","Stepped","Space" }
 local vindex     = 1
 local function vname() return variants[vindex] end
+local function vid()   return KnobVariant[variants[vindex]] end   -- int: no string matching per call
+
+----------------------------------------------------------------
+-- Widget API. With LuaJIT, the hot widgets go straight to the C ABI
+-- (demo_api.h) through the FFI so draw_ui can be trace-compiled; anything
+-- not listed falls through to the classic `demo` table. SINE_NO_FFI=1
+-- forces the table API.
+----------------------------------------------------------------
+local ui = demo
+do
+  local ok, ffi = pcall(require, "ffi")
+  if ok and demo.ffi_cdef and not os.getenv("SINE_NO_FFI") then
+    pcall(ffi.cdef, demo.ffi_cdef)            -- errors harmlessly if already declared (reload)
+    local C = ffi.C
+    if pcall(function() return C.demo_knob_float end) then
+      local TAU = 2 * math.pi
+      ui = setmetatable({
+        Begin             = function(name) return C.demo_begin(name) ~= 0 end,
+        End               = C.demo_end,
+        SetNextWindowSize = function(w, h, cond) C.demo_set_next_window_size(w, h, cond or 4) end,  -- FirstUseEver
+        Separator         = C.demo_separator,
+        Spacing           = C.demo_spacing,
+        SameLine          = C.demo_same_line,
+        Text              = C.demo_text,
+        BeginTable        = function(id, n) return C.demo_begin_table(id, n) ~= 0 end,
+        TableNextColumn   = C.demo_table_next_column,
+        EndTable          = C.demo_end_table,
+        Button            = function(label) return C.demo_button(label) ~= 0 end,
+        knob_float_full   = function(label, v, vmin, vmax, speed, fmt, variant, size, flags, steps, amin, amax)
+          if type(variant) == "string" then return demo.knob_float_full(label, v, vmin, vmax, speed, fmt, variant, size, flags, steps, amin, amax) end
+          return C.demo_knob_float(label, v, vmin, vmax, speed or 0.01, fmt or "%.3f", variant or 0,
+                                   size or 0, flags or 0, steps or 0, amin or 0, amax or TAU)
+        end,
+        plot_sine         = function(a, f, n) C.demo_plot_sine(a, f, n or 512) end,
+        scope             = function(ms, h, trig, yr)
+          return C.demo_scope(ms or 20, h or 120, (trig == false) and 0 or 1, yr or 1)
+        end,
+        gl_torus          = function(side, yaw_, pitch_, R_, r_, id)
+          C.demo_gl_torus(side or -1, yaw_ or 0, pitch_ or 0, R_ or 0.75, r_ or 0.25, id)
+        end,
+        gl_torus_rainbow_speed = C.demo_gl_torus_rainbow_speed,
+        audio_set_freq    = C.demo_audio_set_freq,
+        audio_set_amp     = C.demo_audio_set_amp,
+        voice_on          = function(id, f, a, w)
+          if type(w) == "string" then return demo.voice_on(id, f, a, w) end  -- interned name lookup in C
+          return C.demo_voice_on(id, f, a or 0.1, w or 0) ~= 0
+        end,
+        voice_off         = function(id) return C.demo_voice_off(id) ~= 0 end,
+      }, { __index = demo })
+    end
+  end
+end
+
+----------------------------------------------------------------
+-- DSP graph: saw -> lowpass -> ADSR -> output. Rebuilt on every (re)load;
+-- node ids come out the same, so a reload keeps the oscillator phase and
+-- the envelope where they were.
+----------------------------------------------------------------
+local gate, cutoff = false, 800.0
+local gstats = {}
+ui.graph_clear()
+local g_osc = ui.graph_add("osc")
+local g_lpf = ui.graph_add("filter")
+local g_env = ui.graph_add("env")
+local g_out = ui.graph_add("output")
+ui.graph_connect(g_osc, g_lpf); ui.graph_connect(g_lpf, g_env); ui.graph_connect(g_env, g_out)
+ui.graph_set(g_osc, "wave", "saw"); ui.graph_set(g_osc, "freq", 110)
+ui.graph_set(g_lpf, "cutoff", cutoff); ui.graph_set(g_lpf, "q", 4)
+ui.graph_commit()
+
+----------------------------------------------------------------
+-- MIDI: notes play bank voices; controllers follow this table. Open a
+-- source with --midi-port / --midi-virtual / --midi-file, or from here
+-- with ui.midi_open(name) / ui.midi_play(path).
+----------------------------------------------------------------
+local midi_map = {
+  [74] = { g_lpf, "cutoff", 50, 8000 },   -- brightness
+  [71] = { g_lpf, "q", 0.5, 12 },         -- resonance
+  [7]  = { "amp" },                        -- volume, 0..1
+}
+local mstats = {}
+local unpack = table.unpack or unpack
+ui.midi_unmap()
+for cc, target in pairs(midi_map) do ui.midi_map(cc, unpack(target)) end
+ui.midi_voice("saw", 0.25)
+
+----------------------------------------------------------------
+-- LLM: the model runs on its own thread (--llm-model PATH or ui.llm_load);
+-- draw_ui only submits, cancels and appends whatever llm_poll returns.
+----------------------------------------------------------------
+local llm_prompts = { "Write a haiku about a sine wave.", "Explain what a low-pass filter does, in two sentences." }
+local llm_next    = 1
+local llm_id, llm_text, llm_reason = nil, "", ""
+local lstats = {}
+
+----------------------------------------------------------------
+-- Hot reload: the previous script's save_state() result is handed to the
+-- new script's load_state(), so knob positions survive a save.
+----------------------------------------------------------------
+function save_state()
+  return { amp = amp, freq = freq, samples = samples, scope_ms = scope_ms, chord = chord,
+           yaw = yaw, pitch = pitch, R = R, r = r, rainbow = rainbow, budget_ms = budget_ms,
+           knob_size = knob_size, variant = variants[vindex], gate = gate, cutoff = cutoff,
+           llm_id = llm_id, llm_text = llm_text, llm_reason = llm_reason }
+end
+
+function load_state(s)
+  amp, freq, samples, scope_ms = s.amp or amp, s.freq or freq, s.samples or samples, s.scope_ms or scope_ms
+  if s.chord ~= nil then chord = s.chord end
+  yaw, pitch, R, r = s.yaw or yaw, s.pitch or pitch, s.R or R, s.r or r
+  rainbow, budget_ms, knob_size = s.rainbow or rainbow, s.budget_ms or budget_ms, s.knob_size or knob_size
+  for i, v in ipairs(variants) do if v == s.variant then vindex = i end end   -- by name: the list may change
+  if s.gate ~= nil then gate = s.gate end
+  cutoff = s.cutoff or cutoff
+  llm_id, llm_text, llm_reason = s.llm_id, s.llm_text or llm_text, s.llm_reason or llm_reason   -- a running answer keeps streaming
+  ui.graph_set(g_env, "gate", gate); ui.graph_set(g_lpf, "cutoff", cutoff)
+end
 
 function draw_ui()
   ----------------------------------------------------------------
   -- AUDIO & SINE
   ----------------------------------------------------------------
-  demo.SetNextWindowSize(420, 320)
-  demo.Begin("Audio & Sine")
+  ui.SetNextWindowSize(420, 460)
+  ui.prof_begin("audio window")
+  ui.Begin("Audio & Sine")
     -- frequency knob (50..2000 Hz)
-    freq = demo.knob_float_full("Freq (Hz)", freq, 50.0, 2000.0, 1.0, "%.0f", vname(), knob_size)
-    demo.audio_set_freq(freq)
+    freq = ui.knob_float_full("Freq (Hz)", freq, 50.0, 2000.0, 1.0, "%.0f", vid(), knob_size)
+    ui.audio_set_freq(freq)
 
     -- amplitude knob (0..5)
-    amp  = demo.knob_float_full("Amplitude", amp, 0.0, 5.0, 0.01, "%.2f", vname(), knob_size)
+    amp  = ui.knob_float_full("Amplitude", amp, 0.0, 5.0, 0.01, "%.2f", vid(), knob_size)
+    ui.audio_set_amp(amp / 5.0)   -- knob 0..5 -> output gain 0..1
 
     -- samples (keep as knob too)
-    local raw = demo.knob_float_full("Samples", samples, 16, 2048, 16, "%.0f", vname(), knob_size)
+    local raw = ui.knob_float_full("Samples", samples, 16, 2048, 16, "%.0f", vid(), knob_size)
     samples = math.floor(raw + 0.5)
 
-    demo.Separator()
-    demo.plot_sine(amp, freq, samples)
-  demo.End()
+    -- polyphonic voices on top of the main tone
+    if ui.Button(chord and "Chord off" or "Chord on") then
+      chord = not chord
+      if not chord then ui.voice_all_off(); chord_freq = nil end
+    end
+    -- (re)send the chord only when it starts or its root moves; a full queue retries next frame
+    if chord and freq ~= chord_freq then
+      chord_freq = freq
+      for i, k in ipairs(chord_ratios) do
+        if not ui.voice_on(i, freq * k, 0.05, OscWave.Saw) then chord_freq = nil end
+      end
+    end
+    ui.SameLine()
+    ui.Textf("voices: %d", ui.audio_voices())
+
+    ui.Separator()
+    ui.plot_sine(amp, freq, samples)      -- triggered, last `samples` samples
+    scope_ms = ui.knob_float_full("Scope (ms)", scope_ms, 10, 5000, 10, "%.0f", vid(), knob_size)
+    ui.scope(scope_ms, 80, false)         -- long rolling window, min/max decimated
+  ui.End()
+  ui.prof_end()
+
+  ----------------------------------------------------------------
+  -- AUDIO CALLBACK STATS
+  ----------------------------------------------------------------
+  ui.SetNextWindowSize(420, 260)
+  ui.prof_begin("stats window")
+  ui.Begin("Audio Callback")
+    local st = ui.audio_stats(stats)
+    ui.Textf("load %.1f%%  avg %.1f%%  peak %.1f%%", st.load*100, st.load_avg*100, st.load_peak*100)
+    ui.Textf("block %.0f us   p50 %.0f  p99 %.0f  p999 %.0f  max %.0f us",
+             st.deadline_us, st.p50_us, st.p99_us, st.p999_us, st.max_us)
+    ui.Textf("callbacks %d   late %d   xruns %d (out under %d)",
+             st.callbacks, st.late, st.xruns, st.output_underflows)
+    local al = ui.alloc_stats(allocs)
+    ui.Textf("allocs/frame: lua %d (malloc %d)  imgui %d   lua heap %.0f KB",
+             al.lua_allocs, al.lua_heap, al.imgui_allocs, al.lua_kb)
+    local lp = ui.loop_stats(loop)
+    ui.Textf("loop %.1f fps  cpu %.1f ms/s  idle %.0f%%", lp.fps, lp.cpu_ms_per_s, lp.idle_fraction * 100)
+    local ut = ui.ui_thread_stats(uit)
+    if ut.enabled then
+        ui.Textf("lua thread %.2f ms  replay %.2f ms  %d cmds (%.1f KB)", ut.lua_ms, ut.replay_ms, ut.cmds, ut.kb)
+    end
+    ui.plot_audio_load(80)
+    if ui.Button("Reset stats") then ui.audio_stats_reset() end
+  ui.End()
+  ui.prof_end()
 
   ----------------------------------------------------------------
   -- TORUS
   ----------------------------------------------------------------
-  demo.SetNextWindowSize(520, 560)
-  demo.Begin("Torus (Knobs + Rainbow)")
+  ui.SetNextWindowSize(520, 560)
+  ui.prof_begin("torus window")
+  ui.Begin("Torus (Knobs + Rainbow)")
 
     -- Variant chooser row
-    if demo.BeginTable("vrow", 3) then
-      demo.TableNextColumn(); if demo.Button("◀ Variant") then vindex = (vindex-2)%#variants + 1 end
-      demo.TableNextColumn(); demo.Button(vname()) -- inert label-like
-      demo.TableNextColumn(); if demo.Button("Variant ▶") then vindex = (vindex)%#variants + 1 end
-      demo.EndTable()
+    if ui.BeginTable("vrow", 3) then
+      ui.TableNextColumn(); if ui.Button("◀ Variant") then vindex = (vindex-2)%#variants + 1 end
+      ui.TableNextColumn(); ui.Button(vname()) -- inert label-like
+      ui.TableNextColumn(); if ui.Button("Variant ▶") then vindex = (vindex)%#variants + 1 end
+      ui.EndTable()
     end
-    demo.Spacing()
+    ui.Spacing()
 
     -- 2x2 grid of shape/angle knobs
-    if demo.BeginTable("grid", 2) then
-      demo.TableNextColumn()
-      yaw   = demo.knob_float_full("Yaw",   yaw,   0.0, 2*math.pi, 0.01, "%.2f", vname(), knob_size)
-      demo.TableNextColumn()
-      pitch = demo.knob_float_full("Pitch", pitch, 0.0, 2*math.pi, 0.01, "%.2f", vname(), knob_size)
-
-      demo.TableNextColumn()
-      R = demo.knob_float_full("Major R", R, 0.2, 1.4, 0.001, "%.3f", vname(), knob_size)
-      demo.TableNextColumn()
-      r = demo.knob_float_full("Tube r",  r, 0.05, 0.6, 0.001, "%.3f", vname(), knob_size)
-      demo.EndTable()
+    if ui.BeginTable("grid", 2) then
+      ui.TableNextColumn()
+      yaw   = ui.knob_float_full("Yaw",   yaw,   0.0, 2*math.pi, 0.01, "%.2f", vid(), knob_size)
+      ui.TableNextColumn()
+      pitch = ui.knob_float_full("Pitch", pitch, 0.0, 2*math.pi, 0.01, "%.2f", vid(), knob_size)
+
+      ui.TableNextColumn()
+      R = ui.knob_float_full("Major R", R, 0.2, 1.4, 0.001, "%.3f", vid(), knob_size)
+      ui.TableNextColumn()
+      r = ui.knob_float_full("Tube r",  r, 0.05, 0.6, 0.001, "%.3f", vid(), knob_size)
+      ui.EndTable()
     end
 
-    demo.Separator()
-    rainbow = demo.knob_float_full("Rainbow Speed", rainbow, 0.0, 2.0, 0.01, "%.2f", vname(), knob_size)
-    demo.gl_torus_rainbow_speed(rainbow)
+    ui.Separator()
+    rainbow = ui.knob_float_full("Rainbow Speed", rainbow, 0.0, 2.0, 0.01, "%.2f", vid(), knob_size)
+    ui.gl_torus_rainbow_speed(rainbow)
+    ui.SameLine()
+    budget_ms = ui.knob_float_full("Budget (ms)", budget_ms, 0.0, 50.0, 0.1, "%.1f", vid(), knob_size)
+    ui.gl_torus_budget(budget_ms)
+    ui.SameLine()
+    ui.Textf("quality %d", ui.gl_torus_quality())
+
+    -- GPU fragment shader or the multithreaded CPU raymarcher
+    local cs = ui.gl_torus_cpu_stats(tcpu)
+    if ui.Button(cs.enabled and "Raymarch: CPU" or "Raymarch: GPU") then ui.gl_torus_cpu(not cs.enabled) end
+    if cs.enabled then
+      ui.SameLine()
+      ui.Textf("%.2f ms  %d threads  %s  %d tiles  %d steals", cs.ms, cs.threads, cs.isa, cs.tiles, cs.steals)
+    end
 
     -- Draw torus texture auto-fit into remaining area (side = -1)
-    demo.gl_torus(-1, yaw, pitch, R, r)
+    ui.gl_torus(-1, yaw, pitch, R, r)
+
+  ui.End()
+  ui.prof_end()
+
+  ----------------------------------------------------------------
+  -- TORUS VIEWS: independent pooled render targets
+  ----------------------------------------------------------------
+  ui.SetNextWindowSize(480, 260)
+  ui.prof_begin("views window")
+  ui.Begin("Torus Views")
+    if ui.BeginTable("views", #views) then
+      for _, v in ipairs(views) do
+        ui.TableNextColumn()
+        ui.gl_torus(140, yaw + v.dyaw, pitch + v.dpitch, R, r, v.id)
+      end
+      ui.EndTable()
+    end
+    local st = ui.rt_stats(rt)
+    ui.Textf("targets %d (+%d spare)  %.1f / %.0f MB  allocs %d  evictions %d  shrinks %d",
+             st.targets, st.spares, st.mb, st.budget_mb, st.allocs, st.evictions, st.shrinks)
+  ui.End()
+  ui.prof_end()
+
+  ----------------------------------------------------------------
+  -- DSP GRAPH
+  ----------------------------------------------------------------
+  ui.SetNextWindowSize(300, 240)
+  ui.prof_begin("graph window")
+  ui.Begin("Synth (graph)")
+    if ui.Button(gate and "Release" or "Trigger") then
+      gate = not gate
+      ui.graph_set(g_env, "gate", gate)
+    end
+    local c = ui.knob_float_full("Cutoff", cutoff, 50, 8000, 10, "%.0f", vid(), knob_size)
+    if c ~= cutoff then cutoff = c; ui.graph_set(g_lpf, "cutoff", cutoff) end
+    local gs = ui.graph_stats(gstats)
+    ui.Textf("graph: %d nodes -> %d ops, %d buffers", gs.nodes, gs.ops, gs.buffers)
+    local ms = ui.midi_stats(mstats)
+    if ms.source ~= "" then
+      ui.Textf("midi %s: %d events, %d notes, late %d", ms.source, ms.events, ms.notes, ms.late)
+      if ms.last_cc >= 0 then ui.SameLine(); ui.Textf("cc%d=%d", ms.last_cc, ms.last_value) end
+    end
+  ui.End()
+  ui.prof_end()
+  ui.graph_editor()
+
+  ----------------------------------------------------------------
+  -- LLM
+  ----------------------------------------------------------------
+  ui.SetNextWindowSize(360, 240)
+  ui.prof_begin("llm window")
+  ui.Begin("LLM")
+    local state, err = ui.llm_state()
+    local ls = ui.llm_stats(lstats)
+    if state == "off" then
+      ui.Text("no model: start with --llm-model PATH")
+    elseif state == "error" then
+      ui.Textf("error: %s", err)
+    elseif state == "loading" then
+      ui.Textf("loading %.0f%%", ls.progress * 100)
+    else
+      if ui.Button(llm_id and "Cancel" or "Ask") then
+        if llm_id then ui.llm_cancel(llm_id)
+        else
+          llm_id = ui.llm_submit(llm_prompts[llm_next], 128)
+          llm_next = llm_next % #llm_prompts + 1
+          llm_text, llm_reason = "", ""
+        end
+      end
+      ui.SameLine()
+      ui.Textf("%s  load %.0f ms  ttft %.0f ms  %.1f tok/s", state, ls.load_ms, ls.ttft_ms, ls.tok_s)
+    end
+    if llm_id then
+      local piece, done, reason = ui.llm_poll(llm_id)
+      if piece then llm_text = llm_text .. piece end   -- strings only on frames with new text
+      if done then llm_id, llm_reason = nil, reason end
+    end
+    ui.Separator()
+    ui.Text(llm_text)
+    if llm_reason ~= "" and llm_reason ~= "eos" then ui.Textf("[%s]", llm_reason) end
+  ui.End()
+  ui.prof_end()
 
-  demo.End()
+  ui.profiler_window()
 end
@@ -0,0 +1,58 @@
+#pragma once
+// Bounded single-producer / single-consumer queue.
+// Wait-free on both ends and allocation-free after construction, so the
+// consumer side may run inside the PortAudio callback.
+
+#include <atomic>
+#include <cstddef>
+
+template <typename T, size_t N>
+class SpscQueue {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue capacity must be a power of two");
+public:
+    // producer thread only; returns false when full (caller decides whether to drop)
+    bool push(const T& v){
+        const size_t h = head_.load(std::memory_order_relaxed);
+        if (h - tailCache_ == N) {
+            tailCache_ = tail_.load(std::memory_order_acquire);
+            if (h - tailCache_ == N) return false;
+        }
+        buf_[h & (N - 1)] = v;
+        head_.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer thread only
+    bool pop(T& out){
+        const size_t t = tail_.load(std::memory_order_relaxed);
+        if (t == headCache_) {
+            headCache_ = head_.load(std::memory_order_acquire);
+            if (t == headCache_) return false;
+        }
+        out = buf_[t & (N - 1)];
+        tail_.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer thread only: look at the next element without removing it
+    const T* peek(){
+        const size_t t = tail_.load(std::memory_order_relaxed);
+        if (t == headCache_) {
+            headCache_ = head_.load(std::memory_order_acquire);
+            if (t == headCache_) return nullptr;
+        }
+        return &buf_[t & (N - 1)];
+    }
+
+    static constexpr size_t capacity(){ return N; }
+
+private:
+    // producer side
+    alignas(64) std::atomic<size_t> head_{0};
+    size_t tailCache_ = 0;
+    // consumer side
+    alignas(64) std::atomic<size_t> tail_{0};
+    size_t headCache_ = 0;
+
+    alignas(64) T buf_[N];
+};
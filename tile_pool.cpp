@@ -0,0 +1,121 @@
+#include "tile_pool.h"
+
+#include <algorithm>
+
+static uint64_t packRange(uint32_t b, uint32_t e){ return (uint64_t)b << 32 | e; }
+
+TilePool::TilePool(int threads){ start(threads); }
+TilePool::~TilePool(){ stop(); }
+
+void TilePool::setThreads(int n){
+    if (n <= 0) n = (int)std::max(1u, std::thread::hardware_concurrency());
+    if (n == threads()) return;
+    stop();
+    start(n);
+}
+
+void TilePool::start(int n){
+    if (n <= 0) n = (int)std::max(1u, std::thread::hardware_concurrency());
+    slots_.clear();
+    for (int w=0; w<n; ++w) {
+        slots_.push_back(std::make_unique<Slot>());
+        slots_.back()->rng = 0x9E3779B9u * (uint32_t)(w + 1);
+    }
+    // the generation is passed in, not read by the thread: a job posted before
+    // the thread first locks m_ must not be mistaken for one already seen
+    for (int w=1; w<n; ++w) threads_.emplace_back(&TilePool::worker, this, w, gen_);
+}
+
+void TilePool::stop(){
+    { std::lock_guard<std::mutex> lk(m_); quit_ = true; }
+    cv_.notify_all();
+    for (std::thread& t : threads_) t.join();
+    threads_.clear();
+    quit_ = false;
+}
+
+void TilePool::run(int items, TileFn fn, void* ctx){
+    if (items <= 0) return;
+    const int n = threads();
+    if (n == 1 || items == 1) {
+        for (int i=0; i<items; ++i) fn(ctx, i, 0);
+        return;
+    }
+    for (int w=0; w<n; ++w) {
+        const uint32_t b = (uint32_t)((int64_t)items * w / n), e = (uint32_t)((int64_t)items * (w + 1) / n);
+        slots_[w]->range.store(packRange(b, e), std::memory_order_relaxed);
+    }
+    {
+        std::lock_guard<std::mutex> lk(m_);      // publishes the ranges with the job
+        fn_ = fn; ctx_ = ctx;
+        busy_ = n - 1;
+        ++gen_;
+    }
+    cv_.notify_all();
+    drain(0);
+    // every item is done once all workers have left: a worker only leaves
+    // when no block has anything left to steal, and it finishes its own item first
+    std::unique_lock<std::mutex> lk(m_);
+    doneCv_.wait(lk, [&]{ return busy_ == 0; });
+}
+
+void TilePool::worker(int w, uint64_t seen){
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lk(m_);
+            cv_.wait(lk, [&]{ return quit_ || gen_ != seen; });
+            if (quit_) return;
+            seen = gen_;
+        }
+        drain(w);
+        std::lock_guard<std::mutex> lk(m_);
+        if (--busy_ == 0) doneCv_.notify_one();
+    }
+}
+
+void TilePool::drain(int w){
+    Slot& own = *slots_[w];
+    uint32_t item;
+    while (pop(own, item) || steal(w, item)) fn_(ctx_, (int)item, w);
+}
+
+bool TilePool::pop(Slot& s, uint32_t& item){
+    uint64_t r = s.range.load(std::memory_order_acquire);
+    for (;;) {
+        const uint32_t b = (uint32_t)(r >> 32), e = (uint32_t)r;
+        if (b >= e) return false;
+        if (s.range.compare_exchange_weak(r, packRange(b + 1, e), std::memory_order_acq_rel, std::memory_order_acquire)) {
+            item = b;
+            return true;
+        }
+    }
+}
+
+// Takes the back half of a random victim's block: runs its first item and
+// publishes the rest in our own (empty) slot for others to steal in turn.
+// A CAS that succeeds on a stale word is harmless: the word is the whole
+// state of the block, so an equal word means an equal block.
+bool TilePool::steal(int w, uint32_t& item){
+    const int n = threads();
+    Slot& own = *slots_[w];
+    own.rng ^= own.rng << 13; own.rng ^= own.rng >> 17; own.rng ^= own.rng << 5;   // xorshift32
+    const int first = (int)(own.rng % (uint32_t)n);
+    for (int k=0; k<n; ++k) {
+        const int v = (first + k) % n;
+        if (v == w) continue;
+        Slot& s = *slots_[v];
+        uint64_t r = s.range.load(std::memory_order_acquire);
+        for (;;) {
+            const uint32_t b = (uint32_t)(r >> 32), e = (uint32_t)r;
+            if (b >= e) break;
+            const uint32_t mid = e - (e - b + 1) / 2;
+            if (s.range.compare_exchange_weak(r, packRange(b, mid), std::memory_order_acq_rel, std::memory_order_acquire)) {
+                item = mid;
+                if (mid + 1 < e) own.range.store(packRange(mid + 1, e), std::memory_order_release);
+                steals_.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,62 @@
+#pragma once
+// Work-stealing pool for data-parallel jobs made of independent items (the
+// tiles of an image). run() gives every thread a contiguous block of items;
+// the caller takes part as worker 0. A thread pops items from the front of
+// its own block and, once that is empty, steals the back half of another
+// thread's block, so uneven tiles (a torus in the middle of a mostly empty
+// frame) still finish together.
+//
+// Each block is one packed 64-bit [begin, end) word changed only by CAS, so
+// neither popping nor stealing takes a lock. Threads sleep on a condition
+// variable between jobs; run() does not allocate.
+//
+// run() and setThreads() are called from one thread at a time.
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TilePool {
+public:
+    using TileFn = void (*)(void* ctx, int item, int worker);
+
+    explicit TilePool(int threads = 0);   // total threads, caller included; 0 => hardware threads
+    ~TilePool();
+
+    void setThreads(int n);               // restarts the workers; 0 => hardware threads
+    int  threads() const { return (int)slots_.size(); }
+
+    // Calls fn(ctx, item, worker) once for every item in [0, items) and
+    // returns when all calls have returned. worker is in [0, threads()).
+    void run(int items, TileFn fn, void* ctx);
+
+    uint64_t steals() const { return steals_.load(std::memory_order_relaxed); }   // total so far
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> range{0};   // begin << 32 | end
+        uint32_t rng = 1;                 // victim choice, touched only by the owner
+    };
+
+    void start(int n);
+    void stop();
+    void worker(int w, uint64_t seen);
+    void drain(int w);
+    bool pop(Slot& s, uint32_t& item);
+    bool steal(int w, uint32_t& item);
+
+    std::vector<std::unique_ptr<Slot>> slots_;
+    std::vector<std::thread> threads_;
+    std::mutex m_;
+    std::condition_variable cv_, doneCv_;
+    uint64_t gen_ = 0;                    // job generation, guarded by m_
+    int      busy_ = 0;                   // workers still inside the current job
+    bool     quit_ = false;
+    TileFn   fn_ = nullptr;
+    void*    ctx_ = nullptr;
+    std::atomic<uint64_t> steals_{0};
+};
@@ -0,0 +1,320 @@
+#ifndef IMGUI_DEFINE_MATH_OPERATORS
+#define IMGUI_DEFINE_MATH_OPERATORS
+#endif
+#include "torus.h"
+#include "frame_sched.h"
+#include "profiler.h"
+#include "render_targets.h"
+#include "imgui.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+static GLuint  gTorusProg=0, gTorusVAO=0;
+static float   gRainbowSpeed = 0.25f;
+
+void torusSetRainbowSpeed(float s){ gRainbowSpeed = s; }
+
+/*──────────────────── CPU path ───────────────────*/
+static bool gCpu = false;
+static std::unique_ptr<TorusCpu> gCpuRenderer;   // threads start on first CPU frame
+
+void torusSetCpu(bool on){ gCpu = on; }
+
+TorusCpuStats torusCpuStats(){
+    TorusCpuStats s;
+    if (gCpuRenderer) s = gCpuRenderer->stats();
+    else s.isa = TorusCpu::isa();
+    s.enabled = gCpu;
+    if (frameClockFixed()) { s.ms = 0.0; s.steals = 0; }   // replay: no wall-clock readouts in the frame
+    return s;
+}
+
+/*──────────────────── Adaptive quality ───────────────────*/
+// Level 0 is full quality; higher levels march fewer pixels (bilinearly
+// upsampled on display) and fewer steps. The level drops when the torus's
+// own render cost runs over the budget and recovers once it is comfortably
+// under it. Frame time is no use here: it includes the vsync/idle wait.
+struct TorusLevel { float scale; int steps; };
+static const TorusLevel kLevels[] = { {1.0f,96}, {0.75f,64}, {0.5f,48}, {0.35f,32} };
+static constexpr int kLevelCount = (int)(sizeof(kLevels)/sizeof(kLevels[0]));
+
+static float gBudgetMs = 0.0f;          // 0 => adaptive mode off
+static int   gLevel = 0, gOver = 0, gUnder = 0;
+
+void torusSetBudgetMs(float ms){
+    ms = std::max(0.0f, ms);
+    if (ms == gBudgetMs) return;           // set every frame from Lua: keep the hysteresis counters
+    gBudgetMs = ms;
+    if (gBudgetMs == 0.0f) gLevel = 0;
+    gOver = gUnder = 0;
+}
+int torusQualityLevel(){ return gLevel; }
+
+static void adaptQuality(float costMs){
+    static int lastFrame = -1;                  // several views per frame adapt once
+    if (gBudgetMs <= 0.0f || ImGui::GetFrameCount() == lastFrame) return;
+    lastFrame = ImGui::GetFrameCount();
+    if (costMs > gBudgetMs) { gUnder = 0; if (++gOver >= 2 && gLevel < kLevelCount-1) { ++gLevel; gOver = 0; } }
+    else if (costMs < 0.7f*gBudgetMs) { gOver = 0; if (++gUnder >= 30 && gLevel > 0) { --gLevel; gUnder = 0; } }
+    else gOver = gUnder = 0;
+}
+
+/*──────────────────── Render cost ───────────────────*/
+// CPU time of the renders issued in a frame plus their GPU time, from a
+// GL_TIMESTAMP pair per frame (timestamps, unlike GL_TIME_ELAPSED, may
+// overlap the profiler's GPU scopes). Results are read kGpuLag frames late at
+// most and never waited for; an unfinished pair is dropped when its slot
+// comes round again.
+static constexpr int kGpuLag = 4;
+static struct {
+    struct Slot { GLuint q[2] = {0, 0}; bool begun = false, pending = false; } slot[kGpuLag];
+    int   cur = 0, frame = -1;
+    float cpuMs = 0.0f, lastCpuMs = 0.0f;       // this frame / the previous one
+    bool  rendered = false, lastRendered = false;
+    float gpuMs = 0.0f;                          // newest finished pair
+} gCost;
+
+// Once per frame: closes the previous frame's CPU sum and harvests finished
+// GPU pairs. Returns the previous frame's cost, or -1 if it rendered nothing
+// (a cached view costs nothing and says nothing about the budget).
+static float torusCostMs(){
+    const int f = ImGui::GetFrameCount();
+    if (f != gCost.frame) {
+        gCost.frame = f;
+        gCost.lastCpuMs = gCost.cpuMs; gCost.cpuMs = 0.0f;
+        gCost.lastRendered = gCost.rendered; gCost.rendered = false;
+        gCost.cur = (gCost.cur + 1) % kGpuLag;
+        for (int k=0; k<kGpuLag; ++k) {                     // oldest first: the newest result wins
+            auto& s = gCost.slot[(gCost.cur + k) % kGpuLag];
+            if (!s.pending) continue;
+            GLint avail = 0;
+            glGetQueryObjectiv(s.q[1], GL_QUERY_RESULT_AVAILABLE, &avail);
+            if (avail) {
+                GLuint64 t0 = 0, t1 = 0;
+                glGetQueryObjectui64v(s.q[0], GL_QUERY_RESULT, &t0);
+                glGetQueryObjectui64v(s.q[1], GL_QUERY_RESULT, &t1);
+                gCost.gpuMs = (float)((double)(t1 - t0) * 1e-6);
+                s.pending = false;
+            } else if (k == 0) s.pending = false;           // this frame reuses it
+        }
+        gCost.slot[gCost.cur].begun = false;
+    }
+    return gCost.lastRendered ? gCost.lastCpuMs + gCost.gpuMs : -1.0f;
+}
+
+struct TorusCostScope {
+    std::chrono::steady_clock::time_point t0;
+    TorusCostScope(){
+        auto& s = gCost.slot[gCost.cur];
+        if (!s.q[0]) glGenQueries(2, s.q);
+        if (!s.begun) { glQueryCounter(s.q[0], GL_TIMESTAMP); s.begun = true; }
+        t0 = std::chrono::steady_clock::now();
+    }
+    ~TorusCostScope(){
+        gCost.cpuMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        auto& s = gCost.slot[gCost.cur];
+        glQueryCounter(s.q[1], GL_TIMESTAMP);                // re-issued after every view this frame
+        s.pending = true;
+        gCost.rendered = true;
+    }
+};
+
+/*──────────────────── Dirty tracking ───────────────────*/
+// With rainbowSpeed == 0 the image depends only on these, so a target whose
+// stamp matches still holds the right picture.
+static uint64_t torusStamp(int px, int steps, float yaw, float pitch, float R, float r, bool cpu){
+    const float v[7] = { (float)px, (float)steps, yaw, pitch, R, r, cpu ? 1.0f : 0.0f };
+    const unsigned char* b = reinterpret_cast<const unsigned char*>(v);
+    uint64_t h = 1469598103934665603ull;                 // FNV-1a
+    for (size_t i=0; i<sizeof(v); ++i) { h ^= b[i]; h *= 1099511628211ull; }
+    return h | 1;                                        // 0 means "no content"
+}
+
+/*──────────────────── Torus shader (raymarch rainbow) ───────────────────*/
+static const char* kTorusVS = R"(
+#version 330
+const vec2 V[3]=vec2[3](vec2(-1,-1),vec2(3,-1),vec2(-1,3));
+out vec2 uv; void main(){ vec2 p=V[gl_VertexID]; gl_Position=vec4(p,0,1); uv=p*0.5+0.5; }
+)";
+
+static const char* kTorusFS = R"(
+#version 330
+in vec2 uv; out vec4 color;
+uniform float yaw, pitch, R, r;
+uniform float time, rainbowSpeed;
+uniform int   maxSteps;
+
+float sdTorus(vec3 p, vec2 t){ vec2 q=vec2(length(p.xz)-t.x, p.y); return length(q)-t.y; }
+mat3 rotY(float a){ float c=cos(a),s=sin(a); return mat3(c,0,s, 0,1,0, -s,0,c); }
+mat3 rotX(float a){ float c=cos(a),s=sin(a); return mat3(1,0,0, 0,c,-s, 0,s,c); }
+
+vec3 nrm(vec3 p, vec2 T){
+  float e=.001;
+  vec3 n=vec3(
+    sdTorus(p+vec3(e,0,0),T)-sdTorus(p-vec3(e,0,0),T),
+    sdTorus(p+vec3(0,e,0),T)-sdTorus(p-vec3(0,e,0),T),
+    sdTorus(p+vec3(0,0,e),T)-sdTorus(p-vec3(0,0,e),T)
+  );
+  return normalize(n);
+}
+
+vec3 hsv2rgb(vec3 c){
+  vec3 p = abs(fract(c.xxx + vec3(0., 2./3., 1./3.)) * 6. - 3.);
+  return c.z * mix(vec3(1.), clamp(p - 1., 0., 1.), c.y);
+}
+
+void main(){
+  vec2 p = uv*2.0 - 1.0;
+  vec3 ro = vec3(0,0,3), rd = normalize(vec3(p,-1.5));
+  mat3 RY = rotY(yaw), RX = rotX(pitch);
+
+  float t=0.0; bool hit=false; vec2 T=vec2(R,r);
+  for(int i=0;i<96;i++){
+    if (i >= maxSteps) break;
+    vec3 pos = RX*(RY*(ro + rd*t));
+    float d = sdTorus(pos, T);
+    if (d < 0.001){ hit = true; break; }
+    t += d * 0.9;
+    if (t > 20.0) break;
+  }
+
+  vec3 col=vec3(0.10,0.12,0.16); // bg
+  if (hit){
+    vec3 pos = RX*(RY*(ro + rd*t));
+    float theta = atan(pos.z, pos.x) / (2.0*3.14159265); // ring angle
+    vec2  q = vec2(length(pos.xz) - R, pos.y);
+    float phi = atan(q.y, q.x) / (2.0*3.14159265);       // tube angle
+    float H = fract(theta + phi + time*rainbowSpeed);
+    vec3 base = hsv2rgb(vec3(H, 1.0, 1.0));
+    vec3 N = nrm(pos, T);
+    vec3 L = normalize(vec3(0.5,0.8,0.3));
+    float diff = max(dot(N,L),0.0);
+    float spec = pow(max(dot(reflect(-L,N), -normalize(RX*(RY*rd))),0.0), 32.0);
+    col = base * (0.25 + 0.75*diff) + 0.25*spec;
+  }
+  color = vec4(col,1.0);
+}
+)";
+
+static GLuint compile(GLenum t, const char* src){
+    GLuint id=glCreateShader(t);
+    glShaderSource(id,1,&src,nullptr); glCompileShader(id);
+    GLint ok; glGetShaderiv(id,GL_COMPILE_STATUS,&ok);
+    if(!ok){ char log[1024]; glGetShaderInfoLog(id,1024,nullptr,log); std::fprintf(stderr,"%s\n",log); }
+    return id;
+}
+
+static struct { GLint yaw, pitch, R, r, time, rainbowSpeed, maxSteps; } gLoc;
+
+static void ensureTorusProgram(){
+    if (gTorusProg) return;
+    GLuint vs=compile(GL_VERTEX_SHADER,kTorusVS);
+    GLuint fs=compile(GL_FRAGMENT_SHADER,kTorusFS);
+    gTorusProg=glCreateProgram();
+    glAttachShader(gTorusProg,vs); glAttachShader(gTorusProg,fs);
+    glLinkProgram(gTorusProg);
+    glDeleteShader(vs); glDeleteShader(fs);
+    glGenVertexArrays(1,&gTorusVAO);
+    gLoc.yaw          = glGetUniformLocation(gTorusProg,"yaw");
+    gLoc.pitch        = glGetUniformLocation(gTorusProg,"pitch");
+    gLoc.R            = glGetUniformLocation(gTorusProg,"R");
+    gLoc.r            = glGetUniformLocation(gTorusProg,"r");
+    gLoc.time         = glGetUniformLocation(gTorusProg,"time");
+    gLoc.rainbowSpeed = glGetUniformLocation(gTorusProg,"rainbowSpeed");
+    gLoc.maxSteps     = glGetUniformLocation(gTorusProg,"maxSteps");
+}
+
+// Renders into the bottom-left px*px corner of the target.
+static void renderTorusInto(const RenderTarget& rt,int px,int steps,float yaw,float pitch,float R,float r){
+    PROF_SCOPE("renderTorusInto");
+    PROF_GPU_SCOPE("torus raymarch");
+    ensureTorusProgram();
+    glBindFramebuffer(GL_FRAMEBUFFER,rt.fbo);
+    glViewport(0,0,px,px);
+    glDisable(GL_DEPTH_TEST);
+    glClearColor(0.10f, 0.12f, 0.16f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glUseProgram(gTorusProg);
+    glUniform1f(gLoc.yaw,   yaw);
+    glUniform1f(gLoc.pitch, pitch);
+    glUniform1f(gLoc.R,     R);
+    glUniform1f(gLoc.r,     r);
+    glUniform1f(gLoc.time,  (float)frameClock());
+    glUniform1f(gLoc.rainbowSpeed, gRainbowSpeed);
+    glUniform1i(gLoc.maxSteps, steps);
+
+    glBindVertexArray(gTorusVAO);
+    glDrawArrays(GL_TRIANGLES,0,3);
+
+    glBindFramebuffer(GL_FRAMEBUFFER,0);
+}
+
+// Same picture as renderTorusInto, marched by TorusCpu and uploaded.
+static void renderTorusCpu(const RenderTarget& rt,int px,int steps,float yaw,float pitch,float R,float r){
+    PROF_SCOPE("renderTorusCpu");
+    if (!gCpuRenderer) gCpuRenderer = std::make_unique<TorusCpu>();
+    static std::vector<uint8_t> pixels;              // grows to the largest view, then stays
+    if (pixels.size() < (size_t)px * px * 4) pixels.resize((size_t)px * px * 4);
+
+    TorusParams p;
+    p.yaw = yaw; p.pitch = pitch; p.R = R; p.r = r;
+    p.time = (float)frameClock(); p.rainbowSpeed = gRainbowSpeed;
+    p.steps = steps;
+    gCpuRenderer->render(pixels.data(), px, px, p);
+
+    // clear the whole target so filtering at the corner's edge sees background
+    glBindFramebuffer(GL_FRAMEBUFFER,rt.fbo);
+    glClearColor(0.10f, 0.12f, 0.16f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glBindFramebuffer(GL_FRAMEBUFFER,0);
+    glBindTexture(GL_TEXTURE_2D, rt.tex);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, px, px, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// draw torus into a pooled target and show it centered; side<0 => auto-fit (clamped 96..512)
+void torusWidget(int side, float yaw, float pitch, float R, float r, const char* id){
+    PROF_SCOPE("gl_torus");
+    ImVec2 avail = ImGui::GetContentRegionAvail();
+    const bool autoFit = side < 0;
+    if (autoFit) side = (int)std::floor(std::max(1.0f, std::min(avail.x, avail.y)));
+    side = std::max(96, std::min(side, 512));
+
+    const float costMs = torusCostMs();
+    if (costMs >= 0.0f && !frameClockFixed()) adaptQuality(costMs);       // replay: wall-clock cost must not change the picture
+    const TorusLevel& q = kLevels[gLevel];
+    const int px = std::max(16, (int)std::lround((float)side * q.scale));
+    RenderTarget* rt = gRenderTargets.acquire(ImGui::GetID(id && *id ? id : "##gl_torus"), px, px);
+    const uint64_t stamp = torusStamp(px, q.steps, yaw, pitch, R, r, gCpu);
+    if (gRainbowSpeed != 0.0f) gFrameSched.request(1);   // animating: keep frames coming
+    if (gRainbowSpeed != 0.0f || rt->stamp != stamp) {
+        TorusCostScope cost;
+        if (gCpu) renderTorusCpu(*rt, px, q.steps, yaw, pitch, R, r);
+        else      renderTorusInto(*rt, px, q.steps, yaw, pitch, R, r);
+        rt->stamp = (gRainbowSpeed == 0.0f) ? stamp : 0;
+    }
+
+    // auto-fit centres in the whole region; an explicit side only spans its own row
+    if (!autoFit) avail.y = std::min(avail.y, (float)side);
+    ImVec2 start = ImGui::GetCursorPos();
+    float offX = std::max(0.0f, (avail.x - (float)side) * 0.5f);
+    float offY = std::max(0.0f, (avail.y - (float)side) * 0.5f);
+    ImGui::SetCursorPos(ImVec2(start.x + offX, start.y + offY));
+    // the target is a size class: sample only the corner that was drawn
+    const float u = (float)px / (float)rt->w, v = (float)px / (float)rt->h;
+    ImGui::Image((ImTextureID)(intptr_t)rt->tex,
+                 ImVec2((float)side,(float)side),
+                 ImVec2(0,v), ImVec2(u,0));
+    ImGui::SetCursorPos(start);
+    ImGui::Dummy(avail);
+}
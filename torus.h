@@ -0,0 +1,25 @@
+#pragma once
+// Raymarched rainbow torus, rendered with GL into a pooled offscreen target
+// (render_targets.h) and shown as an ImGui image. Requires a current GL 3.3
+// context.
+
+#include "torus_cpu.h"
+
+void torusSetRainbowSpeed(float s);
+
+// Render budget for adaptive quality: when the torus's own cost (CPU time of
+// its renders plus their GPU time from timer queries) runs over it, the torus
+// is marched at reduced resolution/step count and upsampled. 0 disables.
+void torusSetBudgetMs(float ms);
+int  torusQualityLevel();    // 0 = full quality
+
+// March the scene on the CPU (torus_cpu.h, all cores) and upload the pixels
+// into the same pooled texture, for software-GL machines. Off by default.
+void torusSetCpu(bool on);
+TorusCpuStats torusCpuStats();
+
+// Renders and places the torus in the current ImGui window. Each `id`
+// (scoped by the ImGui ID stack; null => "##gl_torus") owns its own target,
+// re-rendered only when the view changed or the rainbow is animating.
+// side < 0 => auto-fit to the available region (clamped 96..512).
+void torusWidget(int side, float yaw, float pitch, float R, float r, const char* id = nullptr);
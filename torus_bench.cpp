@@ -0,0 +1,214 @@
+// torus_bench.cpp — CPU torus raymarcher (torus_cpu.h) without a GL context.
+// Renders the scene of kTorusFS for every size x thread count x ISA and
+// reports ms/frame, megapixels/s and the speedup over the first thread
+// count (1 unless --threads says otherwise).
+//
+// Usage:
+//   ./torus_bench [--sizes 128,256,512,1024] [--threads 1,2,4,8] [--frames 20]
+//                 [--isa all|avx2|sse2|neon|scalar] [--steps 96]
+//                 [--yaw 0.6] [--pitch 0.4] [--time 0] [--rainbow 0]
+//                 [--out torus.ppm] [--json]
+//   ./torus_bench --check [--sizes 256] [--threads 1,2,4,8]
+//
+// --out writes the first configuration's image as a binary PPM, a reference
+// for pixel tests; every result also carries an FNV-1a checksum of its RGBA.
+// --check renders each size with every ISA at every --threads count (default
+// 1, 2, 4 and max(cores, 4), so work stealing runs even on a 1-core box):
+// each ISA must give the same image at every thread count, and the same
+// image as scalar on x86 (elsewhere, e.g. NEON with fused multiply-adds, it
+// may differ from scalar in at most 0.1% of pixels).
+
+#include "torus_cpu.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+static std::vector<int> parse_list(const char* s){
+    std::vector<int> v;
+    while (s && *s) {
+        char* end=nullptr; long x = std::strtol(s, &end, 10);
+        if (end==s) break;
+        v.push_back((int)x);
+        s = (*end==',') ? end+1 : end;
+    }
+    return v;
+}
+
+static uint64_t fnv1a(const std::vector<uint8_t>& b){
+    uint64_t h = 1469598103934665603ull;
+    for (uint8_t c : b) { h ^= c; h *= 1099511628211ull; }
+    return h;
+}
+
+// RGBA rows bottom-up (GL order) -> top-down RGB
+static bool write_ppm(const char* path, const std::vector<uint8_t>& rgba, int w, int h){
+    FILE* f = std::fopen(path, "wb");
+    if (!f) return false;
+    std::fprintf(f, "P6\n%d %d\n255\n", w, h);
+    std::vector<uint8_t> row((size_t)w * 3);
+    for (int y=h-1; y>=0; --y) {
+        const uint8_t* src = rgba.data() + (size_t)y * w * 4;
+        for (int x=0; x<w; ++x) { row[(size_t)x*3] = src[x*4]; row[(size_t)x*3+1] = src[x*4+1]; row[(size_t)x*3+2] = src[x*4+2]; }
+        std::fwrite(row.data(), 1, row.size(), f);
+    }
+    return std::fclose(f)==0;
+}
+
+struct Result { const char* isa; int size, threads; double ms, ms_min, mpix_s, steals, speedup; uint64_t checksum; };
+
+static Result run(TorusCpu& cpu, int size, int frames, const TorusParams& p, std::vector<uint8_t>& img){
+    img.assign((size_t)size * size * 4, 0);
+    cpu.render(img.data(), size, size, p);                 // warm-up: threads awake, pages touched
+    double total = 0.0, best = 1e30, steals = 0.0;
+    for (int f=0; f<frames; ++f) {
+        cpu.render(img.data(), size, size, p);
+        const TorusCpuStats s = cpu.stats();
+        total += s.ms; best = std::min(best, s.ms); steals += (double)s.steals;
+    }
+    const double ms = total / frames;
+    return Result{ TorusCpu::isa(), size, cpu.threads(), ms, best, (double)size * size / (ms * 1e3),
+                   steals / frames, 1.0, fnv1a(img) };
+}
+
+static int check(const std::vector<int>& sizes, const std::vector<int>& threads, const TorusParams& p){
+    int failures = 0;
+    for (int size : sizes) {
+        std::vector<uint8_t> ref, img;
+        TorusCpu cpu(1);
+        TorusCpu::setIsa("scalar");
+        run(cpu, size, 1, p, ref);
+        for (const char* n : { "avx2", "sse2", "neon", "scalar" }) {
+            if (!TorusCpu::setIsa(n)) continue;
+            uint64_t sum0 = 0;
+            for (size_t i=0; i<threads.size(); ++i) {
+                cpu.setThreads(threads[i]);
+                const Result r = run(cpu, size, 1, p, img);
+                if (i == 0) sum0 = r.checksum;
+                else if (r.checksum != sum0) {
+                    std::fprintf(stderr, "check: %s %dpx: %d threads differ from %d\n", n, size, threads[i], threads[0]);
+                    ++failures;
+                }
+            }
+            int diff = 0, worst = 0;
+            for (size_t i=0; i<img.size(); i+=4) {
+                int d = 0;
+                for (int c=0; c<3; ++c) d = std::max(d, std::abs((int)img[i+c] - (int)ref[i+c]));
+                if (d) ++diff;
+                worst = std::max(worst, d);
+            }
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+            const bool ok = diff == 0;                       // torus_cpu.h: identical on x86
+#else
+            const bool ok = diff * 1000 <= size * size;
+#endif
+            if (!ok) ++failures;
+            std::string ts;
+            for (int t : threads) ts += (ts.empty() ? "" : "/") + std::to_string(t);
+            std::printf("check: %-6s %4dpx  %s threads  %d pixels differ from scalar (max %d)%s\n",
+                        n, size, ts.c_str(), diff, worst, ok ? "" : "  FAIL");
+        }
+    }
+    std::printf("torus check %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
+
+int main(int argc, char** argv){
+    const int hw = (int)std::max(1u, std::thread::hardware_concurrency());
+    std::vector<int> sizes   = { 128, 256, 512, 1024 };
+    std::vector<int> threads = { 1 };
+    for (int t=2; t<hw; t*=2) threads.push_back(t);
+    if (hw > 1) threads.push_back(hw);
+    int frames = 20;
+    TorusParams p; p.yaw = 0.6f; p.pitch = 0.4f;
+    std::string isaArg;
+    const char* out = nullptr;
+    bool json = false, doCheck = false, threadsGiven = false;
+
+    for (int i=1;i<argc;++i) {
+        const char* a = argv[i];
+        auto next = [&]{ if (i+1>=argc) { std::fprintf(stderr,"%s needs a value\n",a); std::exit(2); } return argv[++i]; };
+        if      (!std::strcmp(a,"--sizes"))   sizes   = parse_list(next());
+        else if (!std::strcmp(a,"--threads")) { threads = parse_list(next()); threadsGiven = true; }
+        else if (!std::strcmp(a,"--frames"))  frames  = std::atoi(next());
+        else if (!std::strcmp(a,"--isa"))     isaArg  = next();
+        else if (!std::strcmp(a,"--steps"))   p.steps = std::atoi(next());
+        else if (!std::strcmp(a,"--yaw"))     p.yaw   = (float)std::atof(next());
+        else if (!std::strcmp(a,"--pitch"))   p.pitch = (float)std::atof(next());
+        else if (!std::strcmp(a,"--time"))    p.time  = (float)std::atof(next());
+        else if (!std::strcmp(a,"--rainbow")) p.rainbowSpeed = (float)std::atof(next());
+        else if (!std::strcmp(a,"--out"))     out     = next();
+        else if (!std::strcmp(a,"--json"))    json    = true;
+        else if (!std::strcmp(a,"--check"))   doCheck = true;
+        else { std::fprintf(stderr,"unknown option %s\n",a); return 2; }
+    }
+    sizes.erase(std::remove_if(sizes.begin(), sizes.end(), [](int s){ return s <= 0; }), sizes.end());
+    threads.erase(std::remove_if(threads.begin(), threads.end(), [](int t){ return t <= 0; }), threads.end());
+    if (sizes.empty() || threads.empty() || frames <= 0) { std::fprintf(stderr,"nothing to run\n"); return 2; }
+    if (doCheck) {
+        if (!threadsGiven) threads = { 1, 2, 4, std::max(hw, 4) };
+        threads.erase(std::unique(threads.begin(), threads.end()), threads.end());
+        return check(sizes, threads, p);
+    }
+
+    std::vector<std::string> isas;
+    if (isaArg == "all") {
+        for (const char* n : { "avx2", "sse2", "neon", "scalar" }) if (TorusCpu::setIsa(n)) isas.push_back(n);
+    } else if (!isaArg.empty()) {
+        if (!TorusCpu::setIsa(isaArg.c_str())) { std::fprintf(stderr,"ISA %s not supported here\n",isaArg.c_str()); return 2; }
+        isas.push_back(isaArg);
+    } else {
+        isas.push_back(TorusCpu::isa());
+    }
+
+    std::vector<Result> results;
+    std::vector<uint8_t> img, capture;
+    int capSize = 0;
+    TorusCpu cpu(threads[0]);
+    for (const std::string& isa : isas) {
+        TorusCpu::setIsa(isa.c_str());
+        for (int s : sizes) {
+            double ms1 = 0.0;
+            for (int t : threads) {
+                cpu.setThreads(t);
+                Result r = run(cpu, s, frames, p, img);
+                if (t == threads[0]) ms1 = r.ms;
+                r.speedup = ms1 / r.ms;
+                // only the first configuration is captured to --out
+                if (out && results.empty()) { capture = img; capSize = s; }
+                results.push_back(r);
+            }
+        }
+    }
+
+    if (json) {
+        std::printf("{\"frames\":%d,\"steps\":%d,\"hw_threads\":%d,\"results\":[", frames, p.steps, hw);
+        for (size_t i=0;i<results.size();++i) {
+            const Result& r = results[i];
+            std::printf("%s{\"isa\":\"%s\",\"size\":%d,\"threads\":%d,\"ms\":%.3f,\"ms_min\":%.3f,\"mpix_s\":%.2f,"
+                        "\"speedup\":%.2f,\"steals\":%.1f,\"checksum\":\"%016llx\"}",
+                        i ? "," : "", r.isa, r.size, r.threads, r.ms, r.ms_min, r.mpix_s, r.speedup, r.steals,
+                        (unsigned long long)r.checksum);
+        }
+        std::printf("]}\n");
+    } else {
+        std::printf("%-7s %6s %7s %10s %10s %9s %8s %8s  %s\n",
+                    "isa", "size", "threads", "ms/frame", "min ms", "Mpix/s", "speedup", "steals", "checksum");
+        for (const Result& r : results)
+            std::printf("%-7s %6d %7d %10.3f %10.3f %9.2f %8.2f %8.1f  %016llx\n",
+                        r.isa, r.size, r.threads, r.ms, r.ms_min, r.mpix_s, r.speedup, r.steals,
+                        (unsigned long long)r.checksum);
+    }
+
+    if (out) {
+        if (!write_ppm(out, capture, capSize, capSize)) { std::fprintf(stderr,"failed to write %s\n",out); return 1; }
+        std::fprintf(stderr,"wrote %s (%s, %dx%d)\n", out, results[0].isa, capSize, capSize);
+    }
+    return 0;
+}
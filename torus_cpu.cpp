@@ -0,0 +1,302 @@
+#include "torus_cpu.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+  #define TORUS_X86 1
+  #include <immintrin.h>
+#elif defined(__aarch64__)
+  #define TORUS_NEON 1
+  #include <arm_neon.h>
+#endif
+
+// no "fma": the AVX2 march must round exactly like the SSE2 and scalar ones
+#if defined(TORUS_X86) && defined(__GNUC__)
+  #define TORUS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+  #define TORUS_TARGET_AVX2
+#endif
+
+// Constants of kTorusFS
+static constexpr int   kMaxSteps = 96;
+static constexpr float kHitEps   = 0.001f;
+static constexpr float kStepK    = 0.9f;
+static constexpr float kFar      = 20.0f;
+static constexpr float kCamZ     = 3.0f;
+static constexpr float kFocal    = 1.5f;
+static constexpr float kTwoPi    = 2.0f * 3.14159265f;
+
+/*──────────────────── March kernels ───────────────────*/
+// The shader marches pos = RX*RY*(ro + rd*t); rotation is linear, so that is
+// o + d*t with o = RX*RY*ro fixed per frame and d = RX*RY*rd per pixel.
+struct MarchIn { float ox, oy, oz, R, r; int steps; };
+
+// Marches the 8 rays (dx,dy,dz)[0..8) from o. Returns a bitmask of lanes
+// that hit, with the hit distance in t[lane].
+using MarchKernel = uint32_t (*)(const MarchIn& m, const float* dx, const float* dy, const float* dz, float* t);
+
+static uint32_t march_scalar(const MarchIn& m, const float* dx, const float* dy, const float* dz, float* tOut){
+    uint32_t hits = 0;
+    for (int l=0; l<8; ++l) {
+        float t = 0.0f;
+        for (int i=0; i<m.steps; ++i) {
+            const float px = m.ox + t*dx[l], py = m.oy + t*dy[l], pz = m.oz + t*dz[l];
+            const float q  = std::sqrt(px*px + pz*pz) - m.R;
+            const float d  = std::sqrt(q*q + py*py) - m.r;
+            if (d < kHitEps) { hits |= 1u << l; break; }
+            t = t + d*kStepK;
+            if (!(t <= kFar)) break;
+        }
+        tOut[l] = t;
+    }
+    return hits;
+}
+
+#if defined(TORUS_X86)
+// Two 4-lane halves; each stops as soon as its own lanes are done.
+static uint32_t march_sse2(const MarchIn& m, const float* dx, const float* dy, const float* dz, float* tOut){
+    const __m128 ox = _mm_set1_ps(m.ox), oy = _mm_set1_ps(m.oy), oz = _mm_set1_ps(m.oz);
+    const __m128 R = _mm_set1_ps(m.R), r = _mm_set1_ps(m.r);
+    const __m128 eps = _mm_set1_ps(kHitEps), k = _mm_set1_ps(kStepK), far = _mm_set1_ps(kFar);
+    uint32_t hits = 0;
+    for (int h=0; h<8; h+=4) {
+        const __m128 vx = _mm_loadu_ps(dx+h), vy = _mm_loadu_ps(dy+h), vz = _mm_loadu_ps(dz+h);
+        __m128 t = _mm_setzero_ps(), hit = _mm_setzero_ps();
+        __m128 live = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int i=0; i<m.steps; ++i) {
+            const __m128 px = _mm_add_ps(ox, _mm_mul_ps(t, vx));
+            const __m128 py = _mm_add_ps(oy, _mm_mul_ps(t, vy));
+            const __m128 pz = _mm_add_ps(oz, _mm_mul_ps(t, vz));
+            const __m128 q  = _mm_sub_ps(_mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(px, px), _mm_mul_ps(pz, pz))), R);
+            const __m128 d  = _mm_sub_ps(_mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(q, q), _mm_mul_ps(py, py))), r);
+            const __m128 now = _mm_and_ps(live, _mm_cmplt_ps(d, eps));
+            hit  = _mm_or_ps(hit, now);
+            live = _mm_andnot_ps(now, live);
+            t    = _mm_add_ps(t, _mm_and_ps(live, _mm_mul_ps(d, k)));
+            live = _mm_and_ps(live, _mm_cmple_ps(t, far));
+            if (!_mm_movemask_ps(live)) break;
+        }
+        _mm_storeu_ps(tOut+h, t);
+        hits |= (uint32_t)_mm_movemask_ps(hit) << h;
+    }
+    return hits;
+}
+
+TORUS_TARGET_AVX2
+static uint32_t march_avx2(const MarchIn& m, const float* dx, const float* dy, const float* dz, float* tOut){
+    const __m256 ox = _mm256_set1_ps(m.ox), oy = _mm256_set1_ps(m.oy), oz = _mm256_set1_ps(m.oz);
+    const __m256 R = _mm256_set1_ps(m.R), r = _mm256_set1_ps(m.r);
+    const __m256 eps = _mm256_set1_ps(kHitEps), k = _mm256_set1_ps(kStepK), far = _mm256_set1_ps(kFar);
+    const __m256 vx = _mm256_loadu_ps(dx), vy = _mm256_loadu_ps(dy), vz = _mm256_loadu_ps(dz);
+    __m256 t = _mm256_setzero_ps(), hit = _mm256_setzero_ps();
+    __m256 live = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (int i=0; i<m.steps; ++i) {
+        const __m256 px = _mm256_add_ps(ox, _mm256_mul_ps(t, vx));
+        const __m256 py = _mm256_add_ps(oy, _mm256_mul_ps(t, vy));
+        const __m256 pz = _mm256_add_ps(oz, _mm256_mul_ps(t, vz));
+        const __m256 q  = _mm256_sub_ps(_mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(px, px), _mm256_mul_ps(pz, pz))), R);
+        const __m256 d  = _mm256_sub_ps(_mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(q, q), _mm256_mul_ps(py, py))), r);
+        const __m256 now = _mm256_and_ps(live, _mm256_cmp_ps(d, eps, _CMP_LT_OQ));
+        hit  = _mm256_or_ps(hit, now);
+        live = _mm256_andnot_ps(now, live);
+        t    = _mm256_add_ps(t, _mm256_and_ps(live, _mm256_mul_ps(d, k)));
+        live = _mm256_and_ps(live, _mm256_cmp_ps(t, far, _CMP_LE_OQ));
+        if (!_mm256_movemask_ps(live)) break;
+    }
+    _mm256_storeu_ps(tOut, t);
+    return (uint32_t)_mm256_movemask_ps(hit);
+}
+#endif
+
+#if defined(TORUS_NEON)
+static uint32_t march_neon(const MarchIn& m, const float* dx, const float* dy, const float* dz, float* tOut){
+    const float32x4_t ox = vdupq_n_f32(m.ox), oy = vdupq_n_f32(m.oy), oz = vdupq_n_f32(m.oz);
+    const float32x4_t R = vdupq_n_f32(m.R), r = vdupq_n_f32(m.r);
+    const float32x4_t eps = vdupq_n_f32(kHitEps), k = vdupq_n_f32(kStepK), far = vdupq_n_f32(kFar);
+    uint32_t hits = 0;
+    for (int h=0; h<8; h+=4) {
+        const float32x4_t vx = vld1q_f32(dx+h), vy = vld1q_f32(dy+h), vz = vld1q_f32(dz+h);
+        float32x4_t t = vdupq_n_f32(0.0f);
+        uint32x4_t hit = vdupq_n_u32(0), live = vdupq_n_u32(~0u);
+        for (int i=0; i<m.steps; ++i) {
+            const float32x4_t px = vaddq_f32(ox, vmulq_f32(t, vx));
+            const float32x4_t py = vaddq_f32(oy, vmulq_f32(t, vy));
+            const float32x4_t pz = vaddq_f32(oz, vmulq_f32(t, vz));
+            const float32x4_t q  = vsubq_f32(vsqrtq_f32(vaddq_f32(vmulq_f32(px, px), vmulq_f32(pz, pz))), R);
+            const float32x4_t d  = vsubq_f32(vsqrtq_f32(vaddq_f32(vmulq_f32(q, q), vmulq_f32(py, py))), r);
+            const uint32x4_t now = vandq_u32(live, vcltq_f32(d, eps));
+            hit  = vorrq_u32(hit, now);
+            live = vbicq_u32(live, now);
+            t    = vaddq_f32(t, vreinterpretq_f32_u32(vandq_u32(live, vreinterpretq_u32_f32(vmulq_f32(d, k)))));
+            live = vandq_u32(live, vcleq_f32(t, far));
+            if (!vmaxvq_u32(live)) break;
+        }
+        vst1q_f32(tOut+h, t);
+        uint32_t lanes[4]; vst1q_u32(lanes, hit);
+        for (int l=0; l<4; ++l) if (lanes[l]) hits |= 1u << (h + l);
+    }
+    return hits;
+}
+#endif
+
+/*──────────────────── Runtime dispatch ───────────────────*/
+struct IsaEntry { const char* name; MarchKernel fn; bool (*supported)(); };
+
+static bool always(){ return true; }
+#if defined(TORUS_X86)
+static bool has_avx2(){
+  #if defined(__GNUC__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+  #else
+    return false;
+  #endif
+}
+#endif
+
+// best first
+static const IsaEntry kIsas[] = {
+#if defined(TORUS_X86)
+    { "avx2",   march_avx2,   has_avx2 },
+    { "sse2",   march_sse2,   always   },
+#endif
+#if defined(TORUS_NEON)
+    { "neon",   march_neon,   always   },
+#endif
+    { "scalar", march_scalar, always   },
+};
+
+static const IsaEntry* pickIsa(){
+    if (const char* env = std::getenv("SINE_TORUS_ISA"))
+        for (const IsaEntry& e : kIsas)
+            if (!std::strcmp(e.name, env) && e.supported()) return &e;
+    for (const IsaEntry& e : kIsas) if (e.supported()) return &e;
+    return &kIsas[sizeof(kIsas)/sizeof(kIsas[0]) - 1];
+}
+
+static const IsaEntry* gIsa = pickIsa();
+
+bool TorusCpu::setIsa(const char* name){
+    for (const IsaEntry& e : kIsas)
+        if (!std::strcmp(e.name, name)) {
+            if (!e.supported()) return false;
+            gIsa = &e; return true;
+        }
+    return false;
+}
+
+const char* TorusCpu::isa(){ return gIsa->name; }
+
+/*──────────────────── Shading (per hit pixel) ───────────────────*/
+struct Scene {
+    MarchIn m;
+    float   cy, sy, cp, sp;       // cos/sin of yaw and pitch
+    float   hue;                  // time * rainbowSpeed
+    float   lx, ly, lz;           // light direction
+};
+
+// RX(pitch) * RY(yaw) * v, with GLSL's column-major mat3 constructors
+static void rotate(const Scene& s, float x, float y, float z, float& ox, float& oy, float& oz){
+    const float ux = s.cy*x - s.sy*z, uz = s.sy*x + s.cy*z;
+    ox = ux;
+    oy = s.cp*y + s.sp*uz;
+    oz = s.cp*uz - s.sp*y;
+}
+
+static float sdTorus(const Scene& s, float x, float y, float z){
+    const float q = std::sqrt(x*x + z*z) - s.m.R;
+    return std::sqrt(q*q + y*y) - s.m.r;
+}
+
+static float fract(float x){ return x - std::floor(x); }
+static uint8_t unorm8(float x){ return (uint8_t)(std::min(std::max(x, 0.0f), 1.0f) * 255.0f + 0.5f); }
+
+static void shade(const Scene& s, float dx, float dy, float dz, float t, bool hit, uint8_t* px){
+    float col[3] = { 0.10f, 0.12f, 0.16f };
+    if (hit) {
+        const float x = s.m.ox + t*dx, y = s.m.oy + t*dy, z = s.m.oz + t*dz;
+        const float theta = std::atan2(z, x) / kTwoPi;
+        const float phi   = std::atan2(y, std::sqrt(x*x + z*z) - s.m.R) / kTwoPi;
+        const float H = fract(theta + phi + s.hue);
+
+        const float e = 0.001f;
+        float nx = sdTorus(s, x+e, y, z) - sdTorus(s, x-e, y, z);
+        float ny = sdTorus(s, x, y+e, z) - sdTorus(s, x, y-e, z);
+        float nz = sdTorus(s, x, y, z+e) - sdTorus(s, x, y, z-e);
+        const float nl = 1.0f / std::sqrt(nx*nx + ny*ny + nz*nz);
+        nx *= nl; ny *= nl; nz *= nl;
+
+        const float ndl  = nx*s.lx + ny*s.ly + nz*s.lz;
+        const float diff = std::max(ndl, 0.0f);
+        // reflect(-L, N) against the view vector -normalize(d)
+        const float vl = -1.0f / std::sqrt(dx*dx + dy*dy + dz*dz);
+        const float rx = 2.0f*ndl*nx - s.lx, ry = 2.0f*ndl*ny - s.ly, rz = 2.0f*ndl*nz - s.lz;
+        const float spec = std::pow(std::max((rx*dx + ry*dy + rz*dz) * vl, 0.0f), 32.0f);
+
+        const float hk[3] = { 0.0f, 2.0f/3.0f, 1.0f/3.0f };
+        for (int c=0; c<3; ++c) {
+            const float base = std::min(std::max(std::fabs(fract(H + hk[c]) * 6.0f - 3.0f) - 1.0f, 0.0f), 1.0f);
+            col[c] = base * (0.25f + 0.75f*diff) + 0.25f*spec;
+        }
+    }
+    px[0] = unorm8(col[0]); px[1] = unorm8(col[1]); px[2] = unorm8(col[2]); px[3] = 255;
+}
+
+/*──────────────────── Tiles ───────────────────*/
+struct TileJob {
+    uint8_t*     out;
+    int          w, h, tilesX;
+    const Scene* scene;
+    MarchKernel  march;
+};
+
+static void renderTile(void* ctx, int item, int){
+    const TileJob& j = *static_cast<const TileJob*>(ctx);
+    const Scene& s = *j.scene;
+    const int x0 = (item % j.tilesX) * TorusCpu::kTile, y0 = (item / j.tilesX) * TorusCpu::kTile;
+    const int x1 = std::min(x0 + TorusCpu::kTile, j.w), y1 = std::min(y0 + TorusCpu::kTile, j.h);
+    alignas(32) float dx[8], dy[8], dz[8], t[8];
+    for (int y=y0; y<y1; ++y) {
+        const float py = (float)(2*y + 1) / (float)j.h - 1.0f;    // uv*2-1 at the pixel centre
+        uint8_t* row = j.out + (size_t)y * j.w * 4;
+        for (int x=x0; x<x1; x+=8) {
+            const int n = std::min(8, x1 - x);
+            for (int l=0; l<8; ++l) {
+                const float px = (float)(2*std::min(x + l, x1 - 1) + 1) / (float)j.w - 1.0f;
+                const float il = 1.0f / std::sqrt(px*px + py*py + kFocal*kFocal);
+                rotate(s, px*il, py*il, -kFocal*il, dx[l], dy[l], dz[l]);
+            }
+            const uint32_t hits = j.march(s.m, dx, dy, dz, t);
+            for (int l=0; l<n; ++l) shade(s, dx[l], dy[l], dz[l], t[l], (hits >> l) & 1u, row + (size_t)(x + l) * 4);
+        }
+    }
+}
+
+void TorusCpu::render(uint8_t* rgba, int w, int h, const TorusParams& p){
+    if (w <= 0 || h <= 0) return;
+    const auto t0 = std::chrono::steady_clock::now();
+    Scene s;
+    s.cy = std::cos(p.yaw);   s.sy = std::sin(p.yaw);
+    s.cp = std::cos(p.pitch); s.sp = std::sin(p.pitch);
+    s.m.R = p.R; s.m.r = p.r;
+    s.m.steps = std::max(0, std::min(p.steps, kMaxSteps));
+    rotate(s, 0.0f, 0.0f, kCamZ, s.m.ox, s.m.oy, s.m.oz);
+    s.hue = p.time * p.rainbowSpeed;
+    const float ll = 1.0f / std::sqrt(0.5f*0.5f + 0.8f*0.8f + 0.3f*0.3f);
+    s.lx = 0.5f*ll; s.ly = 0.8f*ll; s.lz = 0.3f*ll;
+
+    const int tilesX = (w + kTile - 1) / kTile, tilesY = (h + kTile - 1) / kTile;
+    TileJob job{ rgba, w, h, tilesX, &s, gIsa->fn };
+    const uint64_t steals0 = pool_.steals();
+    pool_.run(tilesX * tilesY, renderTile, &job);
+
+    stats_.ms      = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    stats_.threads = pool_.threads();
+    stats_.tiles   = tilesX * tilesY;
+    stats_.steals  = pool_.steals() - steals0;
+    stats_.isa     = gIsa->name;
+}
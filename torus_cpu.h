@@ -0,0 +1,53 @@
+#pragma once
+// CPU raymarcher for the rainbow torus scene of torus.cpp's kTorusFS, for
+// software-GL machines where the fragment shader is slow. No GL here: the
+// caller uploads the pixels (torus.cpp) or writes them out (torus_bench).
+//
+// The image is cut into kTile*kTile tiles run on a TilePool (tile_pool.h).
+// Within a tile, rows are marched 8 pixels at a time in SIMD lanes (AVX2,
+// SSE2 as two 4-lane halves, NEON, or scalar, picked at runtime); the few
+// hit pixels are then shaded one by one. The march uses the same operation
+// order in every kernel, so all ISAs and thread counts give the same image
+// on x86.
+
+#include "tile_pool.h"
+
+#include <cstdint>
+
+struct TorusParams {
+    float yaw = 0.0f, pitch = 0.0f, R = 0.75f, r = 0.25f;
+    float time = 0.0f, rainbowSpeed = 0.0f;
+    int   steps = 96;                 // clamped to the shader's 96
+};
+
+struct TorusCpuStats {
+    bool        enabled = false;      // torus.cpp: CPU path selected
+    double      ms = 0.0;             // last render()
+    int         threads = 0, tiles = 0;
+    uint64_t    steals = 0;           // during the last render()
+    const char* isa = "";
+};
+
+class TorusCpu {
+public:
+    static constexpr int kTile = 32;  // pixels per tile side, a multiple of 8
+
+    explicit TorusCpu(int threads = 0) : pool_(threads) {}
+
+    // w*h RGBA8 pixels into rgba (stride w*4), row 0 at the bottom like a GL
+    // texture. Blocks until the image is complete.
+    void render(uint8_t* rgba, int w, int h, const TorusParams& p);
+
+    void setThreads(int n) { pool_.setThreads(n); }   // 0 => hardware threads
+    int  threads() const { return pool_.threads(); }
+    TorusCpuStats stats() const { return stats_; }
+
+    // Kernel selection, as OscBank: "avx2", "sse2", "neon" or "scalar";
+    // false if unsupported on this CPU. Not thread-safe against render().
+    static bool        setIsa(const char* name);
+    static const char* isa();
+
+private:
+    TilePool      pool_;
+    TorusCpuStats stats_;
+};
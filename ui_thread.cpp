@@ -0,0 +1,299 @@
+#include "ui_thread.h"
+#include "app_state.h"
+#include "demo_api.h"
+#include "dsp_editor.h"
+#include "profiler.h"
+#include "torus.h"
+#include "util.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+extern "C" {
+#include <lauxlib.h>
+}
+
+LuaUiWorker gLuaWorker;
+
+/*──────────────────── Buffers ───────────────────*/
+uint32_t UiFrame::str(const char* s){
+    if (!s) return kNoStr;
+    const uint32_t off = (uint32_t)text.size();
+    text.insert(text.end(), s, s + std::strlen(s) + 1);
+    return off;
+}
+
+void UiResults::clear(){
+    for (Slot& s : slot) s = Slot{ 0, 0.0f, 0.0f };
+}
+
+void UiResults::put(uint32_t key, float in, float out){
+    if (!key) return;
+    for (uint32_t i=0, h=key; i<(uint32_t)kSlots; ++i, ++h) {
+        Slot& s = slot[h & (kSlots-1)];
+        if (s.key == 0 || s.key == key) { s = Slot{ key, in, out }; return; }
+    }
+}
+
+const UiResults::Slot* UiResults::get(uint32_t key) const {
+    if (!key) return nullptr;
+    for (uint32_t i=0, h=key; i<(uint32_t)kSlots; ++i, ++h) {
+        const Slot& s = slot[h & (kSlots-1)];
+        if (s.key == key) return &s;
+        if (s.key == 0) return nullptr;
+    }
+    return nullptr;
+}
+
+/*──────────────────── Recorder (Lua thread) ───────────────────*/
+static thread_local UiRecorder* tRecorder = nullptr;
+
+UiRecorder* UiRecorder::current(){ return tRecorder; }
+
+void UiRecorder::bind(UiFrame* out, const UiResults* in){
+    out_ = out; in_ = in; depth_ = 0;
+    tRecorder = this;
+}
+void UiRecorder::unbind(){ tRecorder = nullptr; }
+
+// Widget identity for results: label hashed under the enclosing window/table,
+// like ImGui's ID stack.
+uint32_t UiRecorder::keyOf(const char* label, UiOp op) const {
+    uint32_t h = (depth_ ? ids_[depth_-1] : 2166136261u) ^ (uint32_t)op;
+    for (const char* p = label ? label : ""; *p; ++p) { h ^= (unsigned char)*p; h *= 16777619u; }
+    return h ? h : 1;
+}
+
+UiCmd& UiRecorder::push(UiOp op, uint32_t key){
+    out_->cmds.push_back(UiCmd{});
+    UiCmd& c = out_->cmds.back();
+    c.op = op; c.key = key; c.s0 = c.s1 = UiFrame::kNoStr;
+    return c;
+}
+
+int UiRecorder::begin(const char* name){
+    const int saved = depth_; depth_ = 0;             // windows are not scoped by their parent
+    const uint32_t key = keyOf(name, UiOp_Begin);
+    depth_ = saved;
+    push(UiOp_Begin, key).s0 = out_->str(name);
+    if (depth_ < 32) ids_[depth_] = key;
+    ++depth_;
+    const UiResults::Slot* r = in_->get(key);
+    return (!r || r->out != 0.0f) ? 1 : 0;
+}
+
+void UiRecorder::end(){ push(UiOp_End); if (depth_ > 0) --depth_; }
+
+void UiRecorder::setNextWindowSize(float w, float h, int cond){
+    UiCmd& c = push(UiOp_SetNextWindowSize);
+    c.f[0] = w; c.f[1] = h; c.i[0] = cond;
+}
+
+void UiRecorder::simple(UiOp op){ push(op); }
+
+void UiRecorder::text(const char* s){ push(UiOp_Text).s0 = out_->str(s); }
+
+int UiRecorder::beginTable(const char* id, int columns){
+    const uint32_t key = keyOf(id, UiOp_BeginTable);
+    UiCmd& c = push(UiOp_BeginTable, key);
+    c.s0 = out_->str(id); c.i[0] = columns;
+    const UiResults::Slot* r = in_->get(key);
+    if (r && r->out == 0.0f) { push(UiOp_EndTable); return 0; }   // Lua will skip the body and EndTable
+    if (depth_ < 32) ids_[depth_] = key;
+    ++depth_;
+    return 1;
+}
+
+void UiRecorder::endTable(){ push(UiOp_EndTable); if (depth_ > 0) --depth_; }
+
+int UiRecorder::button(const char* label){
+    const uint32_t key = keyOf(label, UiOp_Button);
+    push(UiOp_Button, key).s0 = out_->str(label);
+    const UiResults::Slot* r = in_->get(key);
+    return (r && r->out != 0.0f) ? 1 : 0;
+}
+
+float UiRecorder::knob(const char* label, float v, float vmin, float vmax, float speed, const char* fmt,
+                       int variant, float size, int flags, int steps, float amin, float amax){
+    const uint32_t key = keyOf(label, UiOp_Knob);
+    UiCmd& c = push(UiOp_Knob, key);
+    c.s0 = out_->str(label); c.s1 = out_->str(fmt);
+    c.f[0] = v; c.f[1] = vmin; c.f[2] = vmax; c.f[3] = speed; c.f[4] = size; c.f[5] = amin; c.f[6] = amax;
+    c.i[0] = variant; c.i[1] = flags; c.i[2] = steps;
+    // only an edit made by the user during the last replay overrides Lua's value
+    const UiResults::Slot* r = in_->get(key);
+    return (r && r->out != r->in) ? r->out : v;
+}
+
+void UiRecorder::plotSine(int samples){ push(UiOp_PlotSine).i[0] = samples; }
+
+int UiRecorder::scope(float ms, float height, int trigger, float yrange){
+    const uint32_t key = keyOf("##scope", UiOp_Scope);
+    UiCmd& c = push(UiOp_Scope, key);
+    c.f[0] = ms; c.f[1] = height; c.f[2] = yrange; c.i[0] = trigger;
+    const UiResults::Slot* r = in_->get(key);
+    return r ? (int)r->out : 0;
+}
+
+void UiRecorder::plotAudioLoad(float height){ push(UiOp_PlotAudioLoad).f[0] = height; }
+
+void UiRecorder::torus(int side, float yaw, float pitch, float R, float r, const char* id){
+    UiCmd& c = push(UiOp_Torus);
+    c.s0 = out_->str(id); c.i[0] = side;
+    c.f[0] = yaw; c.f[1] = pitch; c.f[2] = R; c.f[3] = r;
+}
+
+void UiRecorder::value(UiOp op, float v){ push(op).f[0] = v; }
+
+/*──────────────────── Replay (render thread) ───────────────────*/
+void uiReplay(const UiFrame& f, UiResults& res){
+    // Open windows/tables. `called`: the matching End/EndTable must be issued;
+    // `live`: contents run (false inside a collapsed window or hidden table).
+    struct Open { UiOp op; bool called, live; };
+    constexpr int kMaxOpen = 64;
+    Open stack[kMaxOpen]; int depth = 0;
+    auto live = [&]{ return depth == 0 || stack[depth-1].live; };
+    auto close = [&]{
+        const Open o = stack[--depth];
+        if (o.called) { if (o.op == UiOp_Begin) demo_end(); else demo_end_table(); }
+    };
+
+    for (const UiCmd& c : f.cmds) {
+        switch (c.op) {
+        case UiOp_Begin: {
+            if (depth == kMaxOpen) goto done;
+            const bool call = live(), vis = call && demo_begin(f.at(c.s0));
+            if (call) res.put(c.key, 1.0f, vis ? 1.0f : 0.0f);
+            stack[depth++] = Open{ c.op, call, vis };
+            break;
+        }
+        case UiOp_End:                                  // also closes tables Lua left open
+            while (depth && stack[depth-1].op != UiOp_Begin) close();
+            if (depth) close();
+            break;
+        case UiOp_BeginTable: {
+            if (depth == kMaxOpen) goto done;
+            const bool call = live(), vis = call && demo_begin_table(f.at(c.s0), c.i[0]);
+            if (call) res.put(c.key, 1.0f, vis ? 1.0f : 0.0f);
+            stack[depth++] = Open{ c.op, vis, vis };
+            break;
+        }
+        case UiOp_EndTable:
+            if (depth && stack[depth-1].op == UiOp_BeginTable) close();
+            break;
+
+        // settings apply even when their window is hidden
+        case UiOp_TorusRainbow: demo_gl_torus_rainbow_speed(c.f[0]); break;
+        case UiOp_TorusBudget:  torusSetBudgetMs(c.f[0]); break;
+        case UiOp_TorusCpu:     torusSetCpu(c.f[0] != 0.0f); break;
+        case UiOp_RtBudget:     gRenderTargets.setBudget((size_t)c.f[0]); break;
+        case UiOp_SetNextWindowSize: demo_set_next_window_size(c.f[0], c.f[1], c.i[0]); break;
+
+        default:
+            if (!live()) break;
+            switch (c.op) {
+            case UiOp_Separator:       demo_separator(); break;
+            case UiOp_Spacing:         demo_spacing(); break;
+            case UiOp_SameLine:        demo_same_line(); break;
+            case UiOp_TableNextColumn: demo_table_next_column(); break;
+            case UiOp_Text:            demo_text(f.at(c.s0)); break;
+            case UiOp_Button:          res.put(c.key, 0.0f, demo_button(f.at(c.s0)) ? 1.0f : 0.0f); break;
+            case UiOp_Knob:
+                res.put(c.key, c.f[0], demo_knob_float(f.at(c.s0), c.f[0], c.f[1], c.f[2], c.f[3], f.at(c.s1),
+                                                       c.i[0], c.f[4], c.i[1], c.i[2], c.f[5], c.f[6]));
+                break;
+            case UiOp_PlotSine:        demo_plot_sine(0.0f, 0.0f, c.i[0]); break;
+            case UiOp_Scope:           res.put(c.key, 0.0f, (float)demo_scope(c.f[0], c.f[1], c.i[0], c.f[2])); break;
+            case UiOp_PlotAudioLoad:   demo_plot_audio_load(c.f[0]); break;
+            case UiOp_Torus:           demo_gl_torus(c.i[0], c.f[0], c.f[1], c.f[2], c.f[3], f.at(c.s0)); break;
+            case UiOp_ProfilerWindow:  profilerWindow(); break;
+            case UiOp_GraphEditor:     dspGraphEditor(gDspGraph); break;
+            default: break;
+            }
+        }
+    }
+done:
+    while (depth) close();
+}
+
+/*──────────────────── Worker ───────────────────*/
+bool LuaUiWorker::start(lua_State* L){
+    if (running() || !L) return false;
+    L_ = L; quit_ = kick_ = busy_ = false;
+    // nothing from a previous script: the first frame() after a restart replays empty
+    for (int i=0;i<2;++i) { frames_[i].clear(); results_[i].clear(); }
+    rec_ = pub_ = 0;
+    th_ = std::thread(&LuaUiWorker::run, this);
+    return true;
+}
+
+void LuaUiWorker::stop(){
+    if (!running()) return;
+    { std::lock_guard<std::mutex> lk(m_); quit_ = true; }
+    cv_.notify_all();
+    th_.join();
+}
+
+void LuaUiWorker::run(){
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lk(m_);
+            cv_.wait(lk, [&]{ return kick_ || quit_; });
+            if (quit_) return;
+            kick_ = false;
+        }
+        UiFrame& f = frames_[rec_];
+        f.clear();
+        recorder_.bind(&f, &results_[pub_]);
+        const auto t0 = std::chrono::steady_clock::now();
+        lua_getglobal(L_, "draw_ui");
+        if (lua_isfunction(L_,-1)) {
+            if (lua_pcall(L_,0,0,0)!=LUA_OK){ std::fprintf(stderr,"[Lua] draw_ui: %s\n", lua_tostring(L_,-1)); lua_pop(L_,1); }
+        } else { lua_pop(L_,1); }
+        lua_gc(L_, LUA_GCSTEP, 0);
+        recorder_.unbind();
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            luaMs_ = msSince(t0);
+            busy_ = false;
+        }
+        cv_.notify_all();
+    }
+}
+
+void LuaUiWorker::frame(){
+    {
+        PROF_SCOPE("wait lua");
+        std::unique_lock<std::mutex> lk(m_);
+        cv_.wait(lk, [&]{ return !busy_; });
+    }
+    const auto t0 = std::chrono::steady_clock::now();
+    const UiFrame& f = frames_[rec_];
+    UiResults& out = results_[pub_ ^ 1];
+    out.clear();
+    {
+        PROF_SCOPE("replay");
+        uiReplay(f, out);
+    }
+    out.snap.rt = gRenderTargets.stats();
+    out.snap.loop = gFrameSched.stats();
+    out.snap.allocs = allocLastFrame();
+    out.snap.torusQuality = torusQualityLevel();
+    out.snap.torusCpu = torusCpuStats();
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        replayMs_ = msSince(t0);
+        cmds_ = (int)f.cmds.size(); bytes_ = f.cmds.size() * sizeof(UiCmd) + f.text.size();
+        pub_ ^= 1; rec_ ^= 1;
+        busy_ = kick_ = true;
+    }
+    cv_.notify_all();
+}
+
+UiThreadStats LuaUiWorker::stats() const {
+    std::lock_guard<std::mutex> lk(m_);
+    UiThreadStats s;
+    s.enabled = running(); s.luaMs = luaMs_; s.replayMs = replayMs_; s.cmds = cmds_; s.bytes = bytes_;
+    return s;
+}
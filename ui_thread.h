@@ -0,0 +1,146 @@
+#pragma once
+// Threaded Lua UI: draw_ui runs on a worker thread and records, instead of
+// executing, every ImGui-facing demo_* call into a command buffer. The render
+// thread replays the buffer against ImGui. Widget results (window/table
+// visibility, button presses, edited knob values, scope width) are written to
+// a results block during replay and handed to Lua for its next frame, so they
+// arrive one frame late.
+//
+// Frame handoff (render thread, LuaUiWorker::frame):
+//   wait for Lua to finish frame k -> replay buffer k -> publish results and
+//   swap buffers -> start Lua on frame k+1 -> return (Render/swap overlap Lua)
+//
+// Command buffers and strings live in vectors that are cleared, not freed,
+// every frame, so a steady frame does not allocate.
+
+#include "alloc_hooks.h"
+#include "frame_sched.h"
+#include "render_targets.h"
+#include "torus_cpu.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <lua.h>
+}
+
+enum UiOp : uint8_t {
+    UiOp_Begin, UiOp_End, UiOp_SetNextWindowSize, UiOp_Separator, UiOp_Spacing, UiOp_SameLine,
+    UiOp_Text, UiOp_BeginTable, UiOp_TableNextColumn, UiOp_EndTable, UiOp_Button, UiOp_Knob,
+    UiOp_PlotSine, UiOp_Scope, UiOp_PlotAudioLoad, UiOp_Torus, UiOp_TorusRainbow, UiOp_TorusBudget,
+    UiOp_TorusCpu, UiOp_RtBudget, UiOp_ProfilerWindow, UiOp_GraphEditor,
+};
+
+struct UiCmd {
+    UiOp     op;
+    uint32_t key;          // result slot (0 = none)
+    uint32_t s0, s1;       // offsets into UiFrame::text (kNoStr = null)
+    float    f[7];
+    int32_t  i[3];
+};
+
+struct UiFrame {
+    static constexpr uint32_t kNoStr = 0xFFFFFFFFu;
+    std::vector<UiCmd> cmds;
+    std::vector<char>  text;
+    UiFrame() { cmds.reserve(4096); text.reserve(64 * 1024); }
+    void clear() { cmds.clear(); text.clear(); }
+    uint32_t str(const char* s);
+    const char* at(uint32_t off) const { return off == kNoStr ? nullptr : text.data() + off; }
+};
+
+// What the render thread knows that Lua may ask for in threaded mode.
+struct UiSnapshot {
+    RenderTargetStats rt;
+    LoopStats         loop;
+    AllocCounters     allocs;
+    int               torusQuality = 0;
+    TorusCpuStats     torusCpu;
+};
+
+struct UiResults {
+    static constexpr int kSlots = 1024;   // power of two
+    struct Slot { uint32_t key; float in, out; };
+    Slot       slot[kSlots];
+    UiSnapshot snap;
+    UiResults() { clear(); }
+    void clear();
+    void put(uint32_t key, float in, float out);
+    const Slot* get(uint32_t key) const;
+};
+
+// Lua-thread side: records demo_* calls. demo_api.cpp checks current().
+class UiRecorder {
+public:
+    static UiRecorder* current();
+
+    void bind(UiFrame* out, const UiResults* in);
+    void unbind();
+
+    int   begin(const char* name);
+    void  end();
+    void  setNextWindowSize(float w, float h, int cond);
+    void  simple(UiOp op);
+    void  text(const char* s);
+    int   beginTable(const char* id, int columns);
+    void  endTable();
+    int   button(const char* label);
+    float knob(const char* label, float v, float vmin, float vmax, float speed, const char* fmt,
+               int variant, float size, int flags, int steps, float amin, float amax);
+    void  plotSine(int samples);
+    int   scope(float ms, float height, int trigger, float yrange);
+    void  plotAudioLoad(float height);
+    void  torus(int side, float yaw, float pitch, float R, float r, const char* id);
+    void  value(UiOp op, float v);           // TorusRainbow, TorusBudget, TorusCpu, RtBudget
+
+    const UiSnapshot& snapshot() const { return in_->snap; }
+
+private:
+    UiCmd& push(UiOp op, uint32_t key = 0);
+    uint32_t keyOf(const char* label, UiOp op) const;
+
+    UiFrame*         out_ = nullptr;
+    const UiResults* in_  = nullptr;
+    uint32_t         ids_[32] = {};
+    int              depth_ = 0;
+};
+
+// Replays `f` against ImGui on the calling (render) thread, balancing any
+// Begin/BeginTable that Lua left open, and fills `res`.
+void uiReplay(const UiFrame& f, UiResults& res);
+
+struct UiThreadStats { bool enabled = false; double luaMs = 0, replayMs = 0; int cmds = 0; size_t bytes = 0; };
+
+class LuaUiWorker {
+public:
+    ~LuaUiWorker() { stop(); }
+    bool start(lua_State* L);        // L must not be used by the caller until stop()
+    void stop();
+    bool running() const { return th_.joinable(); }
+
+    // Render thread, between ImGui::NewFrame and ImGui::Render.
+    void frame();
+    UiThreadStats stats() const;
+
+private:
+    void run();
+
+    lua_State*  L_ = nullptr;
+    std::thread th_;
+    mutable std::mutex m_;
+    std::condition_variable cv_;
+    bool kick_ = false, busy_ = false, quit_ = false;
+
+    UiFrame    frames_[2];   // Lua records into frames_[rec_]; the other is replayed
+    UiResults  results_[2];  // Lua reads results_[pub_]; replay writes the other
+    int        rec_ = 0, pub_ = 0;
+    UiRecorder recorder_;
+    double     luaMs_ = 0, replayMs_ = 0;
+    int        cmds_ = 0; size_t bytes_ = 0;
+};
+
+extern LuaUiWorker gLuaWorker;
@@ -0,0 +1,14 @@
+#include "util.h"
+
+#include <cstdio>
+
+bool readFile(const std::string& path, std::string& out){
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+    out.clear();
+    char buf[16384]; size_t n;
+    while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0) out.append(buf, n);
+    const bool ok = !std::ferror(f);
+    std::fclose(f);
+    return ok;
+}
@@ -0,0 +1,13 @@
+#pragma once
+// Small helpers shared by the sine_ui modules.
+
+#include <chrono>
+#include <string>
+
+// Milliseconds elapsed on the steady clock since t0.
+inline double msSince(std::chrono::steady_clock::time_point t0){
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// Whole file into `out` (binary). False if it cannot be opened or read.
+bool readFile(const std::string& path, std::string& out);
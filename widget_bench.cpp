@@ -0,0 +1,202 @@
+// widget_bench.cpp — widget calls per millisecond through the classic
+// lua_CFunction `demo` table vs the LuaJIT FFI fast path (demo_api.h).
+// Headless: an ImGui context with no backend, no window, no GL calls.
+//
+// --check-allocs instead runs a mixed frame (both paths, enum names as
+// strings, Textf, table-refilling stats) and exits non-zero if any frame
+// after warm-up allocates through Lua or ImGui. It also fails when the Lua
+// VM refused the counting allocator (64-bit LuaJIT without GC64): Lua
+// allocations would then read zero without being measured.
+//
+// Usage:
+//   ./widget_bench [--calls 2000] [--frames 200] [--no-jit] [--json] [--check-allocs]
+
+#include "imgui.h"
+#include "alloc_hooks.h"
+#include "lua_bindings.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+extern "C" {
+#include <lua.h>
+#include <lauxlib.h>
+#include <lualib.h>
+}
+
+static const char* kBenchLua = R"LUA(
+local ffi = require("ffi")
+pcall(ffi.cdef, demo.ffi_cdef)
+local C    = ffi.C
+local TICK = KnobVariant.Tick
+local TAU  = 2 * math.pi
+
+-- one label per call, built once, so no two widgets in a frame share an
+-- ImGui ID and the timed loops create no strings
+local label_sets = {}
+local function labels(prefix, n)
+  local t = label_sets[prefix]
+  if not t then t = {}; label_sets[prefix] = t end
+  for i = #t + 1, n do t[i] = prefix .. "##" .. i end
+  return t
+end
+
+local paths = {
+  table = {
+    knob   = function(n) local v, k = 0.5, labels("k", n)
+               for i = 1, n do v = demo.knob_float_full(k[i], v, 0, 1, 0.01, "%.2f", TICK, 32) end
+               return v end,
+    button = function(n) local c, b = 0, labels("b", n)
+               for i = 1, n do if demo.Button(b[i]) then c = c + 1 end end
+               return c end,
+    column = function(n)
+               if demo.BeginTable("t", 4) then for i = 1, n do demo.TableNextColumn() end demo.EndTable() end
+             end,
+  },
+  ffi = {
+    knob   = function(n) local v, k = 0.5, labels("k", n)
+               for i = 1, n do v = C.demo_knob_float(k[i], v, 0, 1, 0.01, "%.2f", TICK, 32, 0, 0, 0, TAU) end
+               return v end,
+    button = function(n) local c, b = 0, labels("b", n)
+               for i = 1, n do if C.demo_button(b[i]) ~= 0 then c = c + 1 end end
+               return c end,
+    column = function(n)
+               if C.demo_begin_table("t", 4) ~= 0 then for i = 1, n do C.demo_table_next_column() end C.demo_end_table() end
+             end,
+  },
+}
+
+function bench_run(path, widget, n) paths[path][widget](n) end
+
+local stats, allocs, v = {}, {}, 0.5
+local names  = { "Tick", "wiper_dot", "WiperOnly", "STEPPED" }
+local knobs, buttons = labels("n", #names), labels("c", 6)
+function alloc_frame(i)
+  for k = 1, #names do v = demo.knob_float_full(knobs[k], v, 0, 1, 0.01, "%.2f", names[k], 32) end
+  v = C.demo_knob_float("f", v, 0, 1, 0.01, "%.2f", TICK, 32, 0, 0, 0, TAU)
+  if demo.BeginTable("t", 3) then
+    for k = 1, 6 do demo.TableNextColumn(); C.demo_button(buttons[k]) end
+    demo.EndTable()
+  end
+  local st = demo.audio_stats(stats)
+  demo.Textf("frame %d  v %.3f  load %.1f%%  %s", i, v, st.load * 100, "ok")
+  demo.alloc_stats(allocs)
+end
+)LUA";
+
+// Runs `frames` mixed frames after a warm-up and counts allocations.
+static int check_allocs(lua_State* L, const LuaPool& pool, bool pooled, int frames, bool json){
+    ImGuiIO& io = ImGui::GetIO();
+    uint64_t luaAllocs = 0, luaHeap = 0, imguiAllocs = 0;
+    int dirty = 0;
+    for (int f=0; f<frames+30; ++f) {                  // 30 warm-up frames
+        const uint64_t a0 = pool.allocs(), h0 = pool.heap(), i0 = imguiAllocCount();
+        io.DeltaTime = 1.0f/60.0f;
+        ImGui::NewFrame();
+        ImGui::Begin("allocs");
+        lua_getglobal(L, "alloc_frame");
+        lua_pushinteger(L, f);
+        if (lua_pcall(L, 1, 0, 0) != LUA_OK) {
+            std::fprintf(stderr, "[Lua] %s\n", lua_tostring(L,-1));
+            return 1;
+        }
+        lua_gc(L, LUA_GCSTEP, 0);
+        ImGui::End();
+        ImGui::Render();
+        if (f < 30) continue;
+        const uint64_t a = pool.allocs() - a0, h = pool.heap() - h0, i = imguiAllocCount() - i0;
+        luaAllocs += a; luaHeap += h; imguiAllocs += i;
+        if (a || i) ++dirty;
+    }
+    const bool fail = dirty || !pooled;
+    char lua[64] = "\"not measured\"", heap[64] = "\"not measured\"";
+    if (pooled) {
+        std::snprintf(lua, sizeof(lua), "%llu", (unsigned long long)luaAllocs);
+        std::snprintf(heap, sizeof(heap), "%llu", (unsigned long long)luaHeap);
+    }
+    if (json) std::printf("{\"frames\":%d,\"dirty_frames\":%d,\"lua_allocs\":%s,\"lua_heap\":%s,\"imgui_allocs\":%llu}\n",
+                          frames, dirty, lua, heap, (unsigned long long)imguiAllocs);
+    else if (pooled)
+        std::printf("%d frames: %d allocating, lua %s (malloc %s), imgui %llu -> %s\n",
+                    frames, dirty, lua, heap, (unsigned long long)imguiAllocs, fail ? "FAIL" : "ok");
+    else
+        std::printf("%d frames: %d allocating, lua not measured (no pooled allocator), imgui %llu -> FAIL\n",
+                    frames, dirty, (unsigned long long)imguiAllocs);
+    return fail ? 1 : 0;
+}
+
+int main(int argc, char** argv){
+    int  calls = 2000, frames = 200;
+    bool jit = true, json = false, allocs = false;
+    for (int i=1;i<argc;++i) {
+        if      (!std::strcmp(argv[i],"--calls")  && i+1<argc) calls  = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i],"--frames") && i+1<argc) frames = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i],"--no-jit")) jit  = false;
+        else if (!std::strcmp(argv[i],"--json"))   json = true;
+        else if (!std::strcmp(argv[i],"--check-allocs")) allocs = true;
+        else { std::fprintf(stderr,"unknown option %s\n",argv[i]); return 2; }
+    }
+
+    installImGuiAllocHooks();
+    IMGUI_CHECKVERSION(); ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.DisplaySize = ImVec2(1920, 1080);
+    io.IniFilename = nullptr;
+    unsigned char* px; int tw, th;
+    io.Fonts->GetTexDataAsRGBA32(&px, &tw, &th);   // build the atlas; nothing is uploaded
+
+    LuaPool pool;
+    bool pooled = false;
+    lua_State* L = newPooledLuaState(&pool, &pooled);
+    registerAllLua(L);
+    if (!jit) luaL_dostring(L, "if jit then jit.off() end");
+    if (luaL_dostring(L, kBenchLua) != LUA_OK) {
+        std::fprintf(stderr, "[Lua] %s\n", lua_tostring(L,-1));
+        return 1;
+    }
+
+    if (allocs) {
+        const int rc = check_allocs(L, pool, pooled, frames, json);
+        lua_close(L);
+        ImGui::DestroyContext();
+        return rc;
+    }
+
+    const char* paths[]   = { "table", "ffi" };
+    const char* widgets[] = { "knob", "button", "column" };
+    if (json) std::printf("{\"calls\":%d,\"frames\":%d,\"jit\":%s,\"results\":[", calls, frames, jit ? "true" : "false");
+    else      std::printf("%-8s %-7s %14s\n", "widget", "path", "calls/ms");
+
+    bool first = true;
+    for (const char* w : widgets)
+        for (const char* p : paths) {
+            double ms = 0.0;
+            for (int f=0; f<frames+10; ++f) {          // first 10 frames warm up (and let traces form)
+                io.DeltaTime = 1.0f/60.0f;
+                ImGui::NewFrame();
+                ImGui::Begin("bench");
+                lua_getglobal(L, "bench_run");
+                lua_pushstring(L, p); lua_pushstring(L, w); lua_pushinteger(L, calls);
+                const auto t0 = std::chrono::steady_clock::now();
+                if (lua_pcall(L, 3, 0, 0) != LUA_OK) {
+                    std::fprintf(stderr, "[Lua] %s\n", lua_tostring(L,-1));
+                    return 1;
+                }
+                const auto t1 = std::chrono::steady_clock::now();
+                ImGui::End();
+                ImGui::EndFrame();
+                if (f >= 10) ms += std::chrono::duration<double, std::milli>(t1 - t0).count();
+            }
+            const double rate = (double)calls * frames / ms;
+            if (json) std::printf("%s{\"widget\":\"%s\",\"path\":\"%s\",\"calls_per_ms\":%.1f}", first ? "" : ",", w, p, rate);
+            else      std::printf("%-8s %-7s %14.1f\n", w, p, rate);
+            first = false;
+        }
+    if (json) std::printf("]}\n");
+
+    lua_close(L);
+    ImGui::DestroyContext();
+    return 0;
+}